@@ -0,0 +1,348 @@
+#include "cameraPath.h"
+#include "headless.h"
+#include "renderGraphStats.h"
+#include "rhi/vulkan/backend.h"
+#include "scene.h"
+#include "worldRenderer.h"
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Deterministic camera-path benchmark. Renders a scene headlessly while flying the camera along a fixed path, writes
+// frame time percentiles and per-pass GPU timings as JSON and optionally compares them against a stored baseline.
+//
+// engine_benchmark [--scene path.gltf] [--camera-path path.txt] [--frames N] [--warmup N] [--width W] [--height H]
+//                  [--output results.json] [--baseline baseline.json] [--tolerance 0.05] [--min-delta-ms 0.05]
+//
+// Exit code is 0 on success, 1 if the benchmark couldn't run and 2 if any metric regressed past the tolerance.
+
+using json = nlohmann::json;
+
+struct BenchmarkOptions
+{
+    std::string scenePath = "../assets/Sponza/Sponza.gltf";
+    // Sponza fly-through when empty, see loadCameraPath() for the format
+    std::string cameraPath;
+    u32 frameCount = 1000;
+    // Frames rendered along the path before measuring, lets caches and pipelines settle
+    u32 warmupFrames = 120;
+    std::string outputPath = "benchmark.json";
+    std::string baselinePath;
+    // Relative slowdown allowed before a metric counts as a regression
+    f64 tolerance = 0.05;
+    // Absolute slowdown ignored regardless of tolerance, keeps tiny passes from flagging on timer noise
+    f64 minDeltaMs = 0.05;
+};
+
+struct Distribution
+{
+    f64 mean = 0.0;
+    f64 p50 = 0.0;
+    f64 p95 = 0.0;
+    f64 p99 = 0.0;
+    f64 max = 0.0;
+};
+
+static auto distribution(std::vector<f64> values) -> Distribution
+{
+    if (values.empty())
+    {
+        return {};
+    }
+
+    std::sort(values.begin(), values.end());
+    // Nearest-rank percentile
+    auto percentile = [&](f64 p)
+    {
+        const size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+        return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+    };
+    return Distribution{
+        .mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size(),
+        .p50 = percentile(0.50),
+        .p95 = percentile(0.95),
+        .p99 = percentile(0.99),
+        .max = values.back(),
+    };
+}
+
+static auto toJson(const Distribution& distribution) -> json
+{
+    return json{
+        {"mean", distribution.mean},
+        {"p50", distribution.p50},
+        {"p95", distribution.p95},
+        {"p99", distribution.p99},
+        {"max", distribution.max},
+    };
+}
+
+struct PassTimings
+{
+    std::vector<f64> gpuMs;
+    std::vector<f64> cpuMs;
+    u64 drawCalls = 0;
+};
+
+static auto runBenchmark(VulkanBackend& backend, Scene& scene, const CameraPath& path, const BenchmarkOptions& options)
+    -> json
+{
+    WorldRenderer worldRenderer(backend);
+
+    renderCameraPath(worldRenderer, scene, path, options.warmupFrames, [](const HeadlessFrame&) {});
+
+    std::vector<f64> frameCpuMs;
+    std::vector<f64> frameGpuMs;
+    frameCpuMs.reserve(options.frameCount);
+    frameGpuMs.reserve(options.frameCount);
+    // Keyed by name, node indices aren't stable across graph changes
+    std::map<std::string, PassTimings> passes;
+
+    const u64 firstSampledFrame = backend.renderGraphStats.sampledFrames;
+    const u64 laggingFrames = VulkanBackend::MaxFramesInFlight;
+    renderCameraPath(worldRenderer, scene, path, options.frameCount, [&](const HeadlessFrame& frame)
+    {
+        frameCpuMs.push_back(frame.cpuMs);
+        // Stats lag behind, the first few frames of the run still report warm-up frames
+        if (backend.renderGraphStats.sampledFrames - firstSampledFrame <= laggingFrames)
+        {
+            return;
+        }
+
+        frameGpuMs.push_back(frame.gpuMs);
+        for (const auto& pass : backend.renderGraphStats.passes)
+        {
+            if (pass.count == 0)
+            {
+                continue;
+            }
+            const auto& sample = latestSample(pass);
+            auto& timings = passes[pass.name];
+            timings.gpuMs.push_back(sample.gpuMs);
+            timings.cpuMs.push_back(sample.cpuMs);
+            timings.drawCalls += sample.drawCalls;
+        }
+    });
+
+    json passResults = json::object();
+    for (auto& [name, timings] : passes)
+    {
+        passResults[name] = json{
+            {"gpuMs", toJson(distribution(timings.gpuMs))},
+            {"cpuMs", toJson(distribution(timings.cpuMs))},
+            {"drawCalls", static_cast<f64>(timings.drawCalls) / timings.gpuMs.size()},
+        };
+    }
+
+    return json{
+        {"scene", options.scenePath},
+        {"cameraPath", options.cameraPath.empty() ? "sponzaFlythrough" : options.cameraPath},
+        {"frames", options.frameCount},
+        {"warmupFrames", options.warmupFrames},
+        {"width", backend.backbufferImage.extent.width},
+        {"height", backend.backbufferImage.extent.height},
+        {"frame",
+            {
+                {"cpuMs", toJson(distribution(std::move(frameCpuMs)))},
+                {"gpuMs", toJson(distribution(std::move(frameGpuMs)))},
+            }},
+        {"passes", passResults},
+    };
+}
+
+// Compares percentiles present in both results, prints one line per metric. Returns the number of regressions.
+static auto compareAgainstBaseline(const json& results, const json& baseline, const BenchmarkOptions& options) -> u32
+{
+    u32 regressions = 0;
+    auto compare = [&](const std::string& metric, const json& current, const json& base)
+    {
+        for (const char* percentile : {"p50", "p95", "p99"})
+        {
+            if (!current.contains(percentile) || !base.contains(percentile))
+            {
+                continue;
+            }
+
+            const f64 now = current[percentile].get<f64>();
+            const f64 before = base[percentile].get<f64>();
+            const f64 delta = now - before;
+            const bool regressed = delta > before * options.tolerance && delta > options.minDeltaMs;
+            regressions += regressed;
+
+            std::println("{:<40} {:>4} {:>9.3f} -> {:>9.3f} ms ({:+6.1f}%){}", metric, percentile, before, now,
+                before > 0.0 ? delta / before * 100.0 : 0.0, regressed ? "  REGRESSION" : "");
+        }
+    };
+
+    compare("frame cpu", results["frame"]["cpuMs"], baseline["frame"]["cpuMs"]);
+    compare("frame gpu", results["frame"]["gpuMs"], baseline["frame"]["gpuMs"]);
+
+    const json& basePasses = baseline["passes"];
+    for (const auto& [name, pass] : results["passes"].items())
+    {
+        if (!basePasses.contains(name))
+        {
+            std::println("{:<40} new pass, no baseline", name);
+            continue;
+        }
+        compare(name + " gpu", pass["gpuMs"], basePasses[name]["gpuMs"]);
+    }
+    for (const auto& [name, pass] : basePasses.items())
+    {
+        if (!results["passes"].contains(name))
+        {
+            std::println("{:<40} missing, present in baseline", name);
+        }
+    }
+
+    return regressions;
+}
+
+static auto readJson(const std::string& path) -> std::optional<json>
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::println("Failed opening {}", path);
+        return std::nullopt;
+    }
+
+    json result = json::parse(file, nullptr, false);
+    if (result.is_discarded())
+    {
+        std::println("Failed parsing {}", path);
+        return std::nullopt;
+    }
+    return result;
+}
+
+i32 main(i32 argc, char** argv)
+{
+    BackendConfig config = {.headless = true, .hotReloadShaders = false};
+    BenchmarkOptions options;
+    for (i32 i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::println("Missing value for {}", arg);
+            return 1;
+        }
+
+        const char* value = argv[++i];
+        if (arg == "--scene")
+        {
+            options.scenePath = value;
+        }
+        else if (arg == "--camera-path")
+        {
+            options.cameraPath = value;
+        }
+        else if (arg == "--frames")
+        {
+            options.frameCount = std::stoul(value);
+        }
+        else if (arg == "--warmup")
+        {
+            options.warmupFrames = std::stoul(value);
+        }
+        else if (arg == "--width")
+        {
+            config.width = std::stoul(value);
+        }
+        else if (arg == "--height")
+        {
+            config.height = std::stoul(value);
+        }
+        else if (arg == "--output")
+        {
+            options.outputPath = value;
+        }
+        else if (arg == "--baseline")
+        {
+            options.baselinePath = value;
+        }
+        else if (arg == "--tolerance")
+        {
+            options.tolerance = std::stod(value);
+        }
+        else if (arg == "--min-delta-ms")
+        {
+            options.minDeltaMs = std::stod(value);
+        }
+        else
+        {
+            std::println("Unknown argument {}", arg);
+            return 1;
+        }
+    }
+
+    CameraPath path = sponzaFlythrough();
+    if (!options.cameraPath.empty())
+    {
+        auto loaded = loadCameraPath(options.cameraPath);
+        if (!loaded)
+        {
+            return 1;
+        }
+        path = std::move(*loaded);
+    }
+
+    std::optional<json> baseline;
+    if (!options.baselinePath.empty())
+    {
+        baseline = readJson(options.baselinePath);
+        if (!baseline)
+        {
+            return 1;
+        }
+    }
+
+    VulkanBackend* backend = initVulkanBackend(config).expect("Failed initialising Vulkan backend");
+
+    // Same lights every run, otherwise runs can't be compared
+    auto scene = loadScene(*backend, "Benchmark", options.scenePath, 4096 - 1, 1337);
+    if (!scene.has_value())
+    {
+        std::println("Failed loading scene {}", options.scenePath);
+        backend->deinit();
+        return 1;
+    }
+
+    const json results = runBenchmark(*backend, *scene, path, options);
+    backend->deinit();
+
+    std::ofstream output(options.outputPath);
+    if (!output)
+    {
+        std::println("Failed opening {}", options.outputPath);
+        return 1;
+    }
+    output << results.dump(4) << "\n";
+
+    const auto& frame = results["frame"];
+    std::println("{} frames, cpu p50/p95/p99 {:.3f}/{:.3f}/{:.3f} ms, gpu p50/p95/p99 {:.3f}/{:.3f}/{:.3f} ms",
+        options.frameCount, frame["cpuMs"]["p50"].get<f64>(), frame["cpuMs"]["p95"].get<f64>(),
+        frame["cpuMs"]["p99"].get<f64>(), frame["gpuMs"]["p50"].get<f64>(), frame["gpuMs"]["p95"].get<f64>(),
+        frame["gpuMs"]["p99"].get<f64>());
+
+    if (!baseline)
+    {
+        return 0;
+    }
+
+    const u32 regressions = compareAgainstBaseline(results, *baseline, options);
+    std::println("{} regression(s) against {} with {:.1f}% tolerance", regressions, options.baselinePath,
+        options.tolerance * 100.0);
+    return regressions > 0 ? 2 : 0;
+}
@@ -0,0 +1,306 @@
+#include "frustum.h"
+#include "imageProcessing/blockCompression.h"
+#include "imageProcessing/displacement.h"
+#include "jobs/threadPool.h"
+#include "mesh.h"
+#include "sceneGraph.h"
+#include "shadowCascades.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <functional>
+#include <print>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// CPU microbenchmarks of the engine's per-frame and load-time hot paths on synthetic data. Needs neither Vulkan nor
+// a window, only the pure CPU translation units are linked in.
+//
+// engine_microbench [--sizes 1000,10000,100000,1000000] [--repetitions N] [--filter substring]
+
+struct MicrobenchOptions
+{
+    std::vector<u32> sizes = {1'000, 10'000, 100'000, 1'000'000};
+    u32 repetitions = 10;
+    std::string filter;
+};
+
+// Keeps the compiler from discarding the computation producing value
+template <typename T>
+static auto doNotOptimize(const T& value) -> void
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Runs fn once to warm up and then `repetitions` times, reports the median
+static auto measure(const MicrobenchOptions& options, std::string_view name, u64 items,
+    const std::function<void()>& fn) -> void
+{
+    if (!options.filter.empty() && !name.contains(options.filter))
+    {
+        return;
+    }
+
+    fn();
+
+    std::vector<f64> timesMs;
+    timesMs.reserve(options.repetitions);
+    for (u32 i = 0; i < options.repetitions; i++)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        const std::chrono::duration<f64, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        timesMs.push_back(elapsed.count());
+    }
+    std::sort(timesMs.begin(), timesMs.end());
+
+    const f64 medianMs = timesMs[timesMs.size() / 2];
+    std::println("{:<32} {:>9} {:>12.4f} ms {:>10.2f} ns/item (min {:.4f} ms, max {:.4f} ms)", name, items, medianMs,
+        medianMs * 1e6 / std::max<u64>(items, 1), timesMs.front(), timesMs.back());
+}
+
+// Synthetic scene of `instanceCount` instances spread over a 200m cube, 16 instances per mesh
+struct SyntheticScene
+{
+    std::unordered_map<std::string, Mesh> meshes;
+    u32 instanceCount = 0;
+
+    std::vector<SceneGraph::Node> nodes;
+    SceneGraph sceneGraph;
+};
+
+static auto syntheticScene(u32 instanceCount, std::mt19937& rng) -> SyntheticScene
+{
+    std::uniform_real_distribution<f32> position(-100.f, 100.f);
+    std::uniform_real_distribution<f32> extent(0.1f, 5.f);
+
+    SyntheticScene scene;
+    scene.instanceCount = instanceCount;
+
+    constexpr u32 instancesPerMesh = 16;
+    for (u32 i = 0; i < instanceCount; i++)
+    {
+        auto& mesh = scene.meshes[std::format("mesh_{}", i / instancesPerMesh)];
+        const glm::vec3 center(position(rng), position(rng), position(rng));
+        const glm::vec3 halfExtent(extent(rng), extent(rng), extent(rng));
+        mesh.instances.push_back(Instance{
+            .modelTransform = glm::translate(glm::mat4(1.f), center),
+            .aabbMin = center - halfExtent,
+            .aabbMax = center + halfExtent,
+            .metallicRoughnessFactors = glm::vec4(0.f, 0.5f, 1.f, 1.f),
+            .selected = false,
+        });
+    }
+
+    // Random tree, every node hangs off one of the nodes created before it. Expected depth is logarithmic, roughly
+    // like a glTF hierarchy of grouped meshes.
+    scene.nodes.reserve(instanceCount + 1);
+    scene.nodes.push_back(SceneGraph::Node{
+        .name = "root",
+        .localTransform = glm::mat4(1.f),
+        .globalTransform = glm::mat4(1.f),
+    });
+    for (u32 i = 1; i <= instanceCount; i++)
+    {
+        const u32 parent = std::uniform_int_distribution<u32>(0, i - 1)(rng);
+        scene.nodes.push_back(SceneGraph::Node{
+            .localTransform = glm::translate(glm::mat4(1.f), glm::vec3(position(rng), 0.f, 0.f)),
+            .globalTransform = glm::mat4(1.f),
+            .parent = &scene.nodes[parent],
+        });
+        scene.nodes[parent].children.push_back(&scene.nodes.back());
+    }
+    scene.sceneGraph.root = &scene.nodes[0];
+
+    return scene;
+}
+
+// Interleaved glTF style attribute streams for `vertexCount` vertices
+struct SyntheticAttributes
+{
+    std::vector<f32> positions;
+    std::vector<f32> uvs;
+    std::vector<f32> normals;
+    std::vector<f32> tangents;
+    std::vector<u16> indices;
+};
+
+static auto syntheticAttributes(u32 vertexCount, std::mt19937& rng) -> SyntheticAttributes
+{
+    std::uniform_real_distribution<f32> value(-1.f, 1.f);
+    auto fill = [&](std::vector<f32>& stream, u32 componentCount)
+    {
+        stream.resize(vertexCount * componentCount);
+        std::generate(stream.begin(), stream.end(), [&]() { return value(rng); });
+    };
+
+    SyntheticAttributes attributes;
+    fill(attributes.positions, 3);
+    fill(attributes.uvs, 2);
+    fill(attributes.normals, 3);
+    fill(attributes.tangents, 4);
+
+    attributes.indices.resize(vertexCount * 3);
+    std::uniform_int_distribution<u32> index(0, std::min(vertexCount, 65536u) - 1);
+    std::generate(attributes.indices.begin(), attributes.indices.end(), [&]() { return index(rng); });
+
+    return attributes;
+}
+
+static auto parseSizes(std::string_view list) -> std::vector<u32>
+{
+    std::vector<u32> sizes;
+    std::istringstream stream{std::string(list)};
+    std::string size;
+    while (std::getline(stream, size, ','))
+    {
+        sizes.push_back(std::stoul(size));
+    }
+    return sizes;
+}
+
+i32 main(i32 argc, char** argv)
+{
+    MicrobenchOptions options;
+    for (i32 i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue)
+        {
+            options.sizes = parseSizes(argv[++i]);
+        }
+        else if (arg == "--repetitions" && hasValue)
+        {
+            options.repetitions = std::max<u32>(std::stoul(argv[++i]), 1);
+        }
+        else if (arg == "--filter" && hasValue)
+        {
+            options.filter = argv[++i];
+        }
+        else
+        {
+            std::println("Unknown argument {}", arg);
+            return 1;
+        }
+    }
+
+    // Fixed seed, runs are comparable across builds
+    std::mt19937 rng(1337);
+
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.f, 2.f, 0.f), glm::vec3(10.f, 2.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+    const glm::mat4 proj = glm::perspectiveFov<f32>(glm::radians(45.f), 1920.f, 1080.f, 0.1f, 200.f);
+
+    for (const u32 size : options.sizes)
+    {
+        SyntheticScene scene = syntheticScene(size, rng);
+
+        measure(options, "insideCameraFrustum", size, [&]()
+        {
+            const auto frustum = frustumPlanes(proj * view);
+            u32 visible = 0;
+            for (const auto& mesh : scene.meshes)
+            {
+                for (const auto& instance : mesh.second.instances)
+                {
+                    visible += insideCameraFrustum(instance.aabbMin, instance.aabbMax, frustum) ? 1 : 0;
+                }
+            }
+            doNotOptimize(visible);
+        });
+
+        measure(options, "gatherModelData", size, [&]()
+        {
+            const auto modelData = gatherModelData(scene.meshes, scene.instanceCount);
+            doNotOptimize(modelData.data());
+        });
+
+        measure(options, "updateSceneGraphTransforms", size, [&]()
+        {
+            updateSceneGraphTransforms(scene.sceneGraph);
+            doNotOptimize(scene.nodes.back().globalTransform);
+        });
+
+        const SyntheticAttributes attributes = syntheticAttributes(size, rng);
+        measure(options, "addMesh attribute copy", size, [&]()
+        {
+            std::vector<Vertex> vertices;
+            std::vector<u32> indices;
+            glm::vec3 aabbMin(0.f);
+            glm::vec3 aabbMax(0.f);
+
+            const i32 count = static_cast<i32>(size);
+            copyVertexAttribute(vertices, 0, 0, attributes.positions.data(), count, 3);
+            expandVertexBounds(vertices, 0, count, aabbMin, aabbMax);
+            copyVertexAttribute(vertices, 0, 4, attributes.uvs.data(), count, 2);
+            copyVertexAttribute(vertices, 0, 8, attributes.normals.data(), count, 3);
+            copyVertexAttribute(vertices, 0, 12, attributes.tangents.data(), count, 4);
+            appendIndices(indices, attributes.indices.data(), attributes.indices.size(), 0);
+
+            doNotOptimize(vertices.data());
+            doNotOptimize(indices.data());
+            doNotOptimize(aabbMin);
+        });
+    }
+
+    // Size independent, called once per frame
+    constexpr u32 cascadeCalls = 1000;
+    measure(options, "csmLightViewProjMats", cascadeCalls, [&]()
+    {
+        glm::mat4 viewProjMats[4];
+        glm::vec4 cascadeDistances[4];
+        for (u32 i = 0; i < cascadeCalls; i++)
+        {
+            csmLightViewProjMats(viewProjMats, cascadeDistances, 4, view, proj, glm::vec3(0.6, -1.0, 0.175), 0.1f,
+                200.f, 0.5f, 4096.f);
+            doNotOptimize(viewProjMats);
+        }
+    });
+
+    // Import time, a handful of V-cycles so cost scales with pixel count. Once on the calling thread like an import
+    // job runs it, once split across the worker pool.
+    for (const u32 dimension : {256, 1024})
+    {
+        std::vector<u8> normalMap(dimension * dimension * 4);
+        std::uniform_int_distribution<u32> channel(0, 255);
+        std::generate(normalMap.begin(), normalMap.end(), [&]() { return static_cast<u8>(channel(rng)); });
+
+        measure(options, std::format("tangentNormalMapToBumpMap {}px", dimension), dimension * dimension, [&]()
+        {
+            const auto bumpMap = tangentNormalMapToBumpMap(normalMap.data(), dimension, dimension);
+            doNotOptimize(bumpMap.data());
+        });
+        measure(options, std::format("tangentNormalMapToBumpMap pooled {}px", dimension), dimension * dimension, [&]()
+        {
+            const auto bumpMap = tangentNormalMapToBumpMap(normalMap.data(), dimension, dimension, &workerPool());
+            doNotOptimize(bumpMap.data());
+        });
+    }
+
+    // Import time, per texture on a single worker
+    for (const u32 dimension : {256, 1024})
+    {
+        std::vector<u8> image(dimension * dimension * 4);
+        std::uniform_int_distribution<u32> channel(0, 255);
+        std::generate(image.begin(), image.end(), [&]() { return static_cast<u8>(channel(rng)); });
+
+        for (const auto [name, format] : {std::pair{"BC4", BlockFormat::BC4}, std::pair{"BC5", BlockFormat::BC5},
+                 std::pair{"BC7", BlockFormat::BC7}})
+        {
+            measure(options, std::format("compressImage {} {}px", name, dimension), dimension * dimension, [&]()
+            {
+                const auto compressed = compressImage(image, dimension, dimension, format);
+                doNotOptimize(compressed.data());
+            });
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+#version 460
+#extension GL_EXT_buffer_reference : require
+layout (local_size_x = 128) in;
+
+#include "lights.glsl"
+#include "utils.glsl"
+#include "scene.glsl"
+
+layout(push_constant) uniform Constants
+{
+    Lights lights;
+    LightIds ids;
+    LightTileData clusters;
+    LightIdCount count;
+    LightBvhNodes bvh;
+    float nearPlane;
+    float farPlane;
+    // 0 when there's no tree, every light is tested
+    uint bvhLeafCount;
+    // In ids, even
+    uint lightIdCapacity;
+} constants;
+
+// Set by clusteredLightCullingPass(), grown when a cluster found more lights
+layout(constant_id = 0) const uint MAX_LIGHTS_PER_CLUSTER = 256;
+layout(constant_id = 1) const uint MAX_POINT_LIGHTS = 16384;
+
+shared uint localLightIdCount;
+shared uint localLightIds[MAX_LIGHTS_PER_CLUSTER];
+shared vec3 clusterMin;
+shared vec3 clusterMax;
+shared vec3 clusterMinWS;
+shared vec3 clusterMaxWS;
+shared uint lightIdStart;
+shared uint clusterLightCount;
+
+// Slice k of n starts at near * (far / near)^(k / n)
+float sliceDepth(uint slice)
+{
+    return constants.nearPlane * pow(constants.farPlane / constants.nearPlane, float(slice) / float(gl_NumWorkGroups.z));
+}
+
+void cullLight(uint lightId)
+{
+    PointLight light = constants.lights.pointLights[lightId];
+    vec3 lightPosVS = (scene.view * vec4(lightPos(light), 1.f)).xyz;
+
+    // Sphere-AABB
+    vec3 toClosest = clamp(lightPosVS, clusterMin, clusterMax) - lightPosVS;
+    if (dot(toClosest, toClosest) <= light.range * light.range)
+    {
+        uint slot = atomicAdd(localLightIdCount, 1);
+        if (slot < MAX_LIGHTS_PER_CLUSTER)
+        {
+            localLightIds[slot] = lightId;
+        }
+    }
+}
+
+void main()
+{
+    uvec3 cluster = gl_WorkGroupID;
+    uint clusterId = (cluster.z * gl_NumWorkGroups.y + cluster.y) * gl_NumWorkGroups.x + cluster.x;
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        localLightIdCount = 0;
+
+        // View space AABB around the tile's corner rays, cut at the slice's near and far depth
+        mat4 invProj = inverse(scene.proj);
+        vec2 tileSizeInUv = vec2(1.f, 1.f) / gl_NumWorkGroups.xy;
+        float sliceNear = sliceDepth(cluster.z);
+        float sliceFar = sliceDepth(cluster.z + 1);
+
+        mat4 invView = inverse(scene.view);
+        vec3 aabbMin = vec3(1e30f);
+        vec3 aabbMax = vec3(-1e30f);
+        vec3 aabbMinWS = vec3(1e30f);
+        vec3 aabbMaxWS = vec3(-1e30f);
+        for (uint corner = 0; corner < 4; corner++)
+        {
+            vec2 cornerUv = (cluster.xy + uvec2(corner & 1, corner >> 1)) * tileSizeInUv;
+            vec3 cornerVS = ndcToView(vec3(cornerUv * 2.f - 1.f, 1.f), invProj);
+            // Scaled to unit depth
+            vec3 ray = cornerVS / -cornerVS.z;
+
+            aabbMin = min(aabbMin, min(ray * sliceNear, ray * sliceFar));
+            aabbMax = max(aabbMax, max(ray * sliceNear, ray * sliceFar));
+
+            // Looser world space box for walking the light BVH
+            vec3 nearWS = (invView * vec4(ray * sliceNear, 1.f)).xyz;
+            vec3 farWS = (invView * vec4(ray * sliceFar, 1.f)).xyz;
+            aabbMinWS = min(aabbMinWS, min(nearWS, farWS));
+            aabbMaxWS = max(aabbMaxWS, max(nearWS, farWS));
+        }
+        clusterMin = aabbMin;
+        clusterMax = aabbMax;
+        clusterMinWS = aabbMinWS;
+        clusterMaxWS = aabbMaxWS;
+    }
+    barrier();
+
+    uint lightCount = min(constants.lights.pointLightCount, MAX_POINT_LIGHTS);
+    if (constants.bvhLeafCount == 0)
+    {
+        for (uint lightId = gl_LocalInvocationIndex; lightId < lightCount; lightId += gl_WorkGroupSize.x)
+        {
+            cullLight(lightId);
+        }
+    }
+    else
+    {
+        // Stackless walk. The whole workgroup visits the same nodes, the lights of an overlapped leaf are split
+        // among the threads.
+        uint firstLeaf = constants.bvhLeafCount - 1;
+        uint node = 0;
+        while (true)
+        {
+            LightBvhNode bvhNode = constants.bvh.nodes[node];
+            bool overlaps = all(lessThanEqual(bvhNode.aabbMin, clusterMaxWS)) &&
+                            all(greaterThanEqual(bvhNode.aabbMax, clusterMinWS));
+            if (overlaps && node < firstLeaf)
+            {
+                node = 2 * node + 1;
+                continue;
+            }
+
+            if (overlaps)
+            {
+                for (uint i = gl_LocalInvocationIndex; i < bvhNode.lightCount; i += gl_WorkGroupSize.x)
+                {
+                    uint lightId = bvhNode.firstLight + i;
+                    if (lightId < lightCount)
+                    {
+                        cullLight(lightId);
+                    }
+                }
+            }
+
+            // Climb out of right children, then over to the sibling
+            while (node > 0 && (node & 1) == 0)
+            {
+                node = (node - 1) / 2;
+            }
+            if (node == 0)
+            {
+                break;
+            }
+            node++;
+        }
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        atomicMax(constants.count.maxTileLightCount, localLightIdCount);
+        uint gathered = min(localLightIdCount, MAX_LIGHTS_PER_CLUSTER);
+        lightIdStart = atomicAdd(constants.count.lightIdCount, lightIdSlots(gathered));
+        // Past the end of a full list only what fits is kept, the CPU grows it for later frames
+        clusterLightCount = min(gathered, constants.lightIdCapacity - min(lightIdStart, constants.lightIdCapacity));
+        constants.clusters.tiles[clusterId].count = clusterLightCount;
+        constants.clusters.tiles[clusterId].offset = lightIdStart;
+    }
+    barrier();
+
+    for (uint pair = gl_LocalInvocationIndex; pair < lightIdSlots(clusterLightCount) / 2; pair += gl_WorkGroupSize.x)
+    {
+        uint second = 2 * pair + 1 < clusterLightCount ? localLightIds[2 * pair + 1] : 0;
+        constants.ids.packedIds[lightIdStart / 2 + pair] = localLightIds[2 * pair] | (second << 16);
+    }
+}
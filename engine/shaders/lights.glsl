@@ -9,25 +9,76 @@ layout (buffer_reference, std430) buffer LightTileData
     LightTile tiles[];
 };
 
+// Two 16 bit light ids per uint, low half first. Every tile's run of ids starts on an even index, so a workgroup
+// writes whole uints, see lightIdSlots().
 layout (buffer_reference, std430) buffer LightIds
 {
-    uint ids[];
+    uint packedIds[];
 };
 
+uint lightId(LightIds ids, uint index)
+{
+    return (ids.packedIds[index / 2] >> ((index & 1) * 16)) & 0xffff;
+}
+
+// Ids to reserve for a tile holding count lights
+uint lightIdSlots(uint count)
+{
+    return (count + 1) & ~1u;
+}
+
+// Matches LightCullingCounters, read back by the CPU to grow whatever overflowed
 layout (buffer_reference, std430) buffer LightIdCount
 {
+    // Ids the tiles asked for, may be more than the index list holds
     uint lightIdCount;
+    // Lights found in the fullest tile, may be more than the culling shader holds
+    uint maxTileLightCount;
 };
 
+// 24 bytes, matches PointLight in scene.h. Scalars only, so std430 doesn't pad it to 32.
 struct PointLight
 {
-    vec4 pos;
-    vec4 color;
-    vec4 range;
+    float posX, posY, posZ;
+    float range;
+    // Half floats
+    uint colorRG;
+    uint colorBAndStrength;
 };
 
+vec3 lightPos(PointLight light)
+{
+    return vec3(light.posX, light.posY, light.posZ);
+}
+
+vec3 lightColor(PointLight light)
+{
+    return vec3(unpackHalf2x16(light.colorRG), unpackHalf2x16(light.colorBAndStrength).x);
+}
+
+float lightStrength(PointLight light)
+{
+    return unpackHalf2x16(light.colorBAndStrength).y;
+}
+
 layout (buffer_reference, std430) buffer Lights
 {
     uint pointLightCount;
+    // Lights start 16 bytes in
+    uint padding[3];
     PointLight pointLights[];
-};
\ No newline at end of file
+};
+// Built on the CPU, see LightBvh. Children of node i are 2i + 1 and 2i + 2, leaves come last.
+struct LightBvhNode
+{
+    vec3 aabbMin;
+    uint firstLight;
+    vec3 aabbMax;
+    // 0 for inner nodes
+    uint lightCount;
+};
+
+layout (buffer_reference, std430) readonly buffer LightBvhNodes
+{
+    LightBvhNode nodes[];
+};
@@ -24,7 +24,6 @@ layout(buffer_reference, std430) readonly buffer ShadowPassData
 
 layout(push_constant) uniform Constants
 {
-	vec4 enabledFeatures; // normal mapping, parallax mapping
 	VertexBuffer vertexBuffer;
 	ModelDataBuffer modelData;
 	ShadowPassData shadowData;
@@ -33,6 +32,10 @@ layout(push_constant) uniform Constants
 	LightTileData lightTiles;
 	int shadowMapIndex;
 	int depthMapIndex;
+	uvec2 lightTileCount;
+	uint lightSliceCount;
+	float depthSliceScale;
+	float depthSliceBias;
 } constants;
 
 layout (location = 4) in vec2 vert_uv;
@@ -50,7 +53,10 @@ layout (location = 3) out vec4 outReflection;
 
 #include "parallax.glsl"
 
-#define PCF_TAPS_PER_AXIS 15
+// Set per pipeline permutation, see ForwardFeature
+layout(constant_id = 0) const bool NORMAL_MAPPING = true;
+layout(constant_id = 1) const bool PARALLAX_MAPPING = true;
+layout(constant_id = 2) const int PCF_TAPS_PER_AXIS = 15;
 
 float shadowIntensity(mat4 viewProj, uint cascadeIndex, float cascadeCount)
 {
@@ -84,12 +90,13 @@ void main()
 {
     const vec4 textureIndices = constants.modelData.data[index].textures;
 
-    const bool parallaxMappingEnabled = constants.enabledFeatures.y != 0.f;
-    vec2 uv = parallaxMappingEnabled ? parallaxOcclusionMapBinarySearch(vert_uv, int(textureIndices.z)) : vert_uv;
+    vec2 uv = PARALLAX_MAPPING ? parallaxOcclusionMapBinarySearch(vert_uv, int(textureIndices.z)) : vert_uv;
     //vec2 uv = vert_uv;
 
     vec3 albedo = texture(textures[int(textureIndices.x)], uv).rgb;
-    vec3 texNormal = texture(textures[int(textureIndices.y)], uv).rgb;
+    // BC5 only keeps the tangent space xy, z is reconstructed
+    vec2 texNormalXy = texture(textures[int(textureIndices.y)], uv).rg * vec2(2.f) - vec2(1.f);
+    vec3 texNormal = vec3(texNormalXy, sqrt(max(0.f, 1.f - dot(texNormalXy, texNormalXy))));
 
     vec2 metallicRoughnessFactors = constants.modelData.data[index].metallicRoughnessFactors.rg;
     vec2 metallicRoughness = texture(textures[int(textureIndices.w)], uv).bg;
@@ -107,36 +114,37 @@ void main()
 
 	float shadow = shadowIntensity(constants.shadowData.lightViewProj[cascadeIndex], cascadeIndex, float(constants.shadowData.cascadeCount));
 
-    const bool normalMappingEnabled = constants.enabledFeatures.x != 0.f;
-	vec3 n = normalMappingEnabled ? normalize(tbn * (texNormal * vec3(2.f) - vec3(1.f))) : tbn[2];
+	vec3 n = NORMAL_MAPPING ? normalize(tbn * texNormal) : tbn[2];
 	outNormal = vec4(n, 1.f);
 
     vec3 cameraDir = normalize(scene.cameraPos.xyz - pos);
 
-    // Look up light tile
-    vec2 fragmentPos = gl_FragCoord.xy / vec2(1920.f, 1080.f);
-    vec2 lightTileId = fragmentPos * vec2(96.f, 54.f);
-    int tileIndex = int(lightTileId.y) * 96 + int(lightTileId.x);
+    // Look up light cluster, depth slices are exponential and there's only one when culling per tile
+    vec2 fragmentPos = gl_FragCoord.xy / vec2(textureSize(textures[constants.depthMapIndex], 0));
+    uvec2 lightTileId = min(uvec2(fragmentPos * vec2(constants.lightTileCount)), constants.lightTileCount - 1);
+    float slice = log(max(-viewPos.z, 1e-4f)) * constants.depthSliceScale + constants.depthSliceBias;
+    uint lightSliceId = uint(clamp(slice, 0.f, float(constants.lightSliceCount - 1)));
+    uint tileIndex = (lightSliceId * constants.lightTileCount.y + lightTileId.y) * constants.lightTileCount.x + lightTileId.x;
     uint lightCount = constants.lightTiles.tiles[tileIndex].count;
     uint lightOffset = constants.lightTiles.tiles[tileIndex].offset;
 
     vec3 Lo = vec3(0.0);
     for (uint i = 0; i < lightCount; i++)
     {
-        uint lightIndex = constants.lightIds.ids[i + lightOffset];
+        uint lightIndex = lightId(constants.lightIds, i + lightOffset);
         PointLight light = constants.lights.pointLights[lightIndex];
-        vec3 lightDir = light.pos.xyz - pos;
+        vec3 lightDir = lightPos(light) - pos;
         vec3 normLightDir = normalize(lightDir);
         float dist = length(lightDir);
-        float radius = light.range.x;
+        float radius = light.range;
 
         float normalizedDist = (radius - dist) / radius;
         float attenuation = pow(max(normalizedDist, 0.f), 2.f);
-        float strength = light.range.y;
+        float strength = lightStrength(light);
 
         vec3 L = normLightDir;
         vec3 H = normalize(cameraDir + L);
-        vec3 radiance     = light.color.rgb * attenuation * strength;
+        vec3 radiance     = lightColor(light) * attenuation * strength;
 
         // cook-torrance brdf
         float NDF = trowbridgeReitzGgx(n, H, metallicRoughness.y);
@@ -21,12 +21,14 @@ layout(push_constant) uniform Constants
     Lights lights;
     LightIds ids;
     LightTileData lightTiles;
-    // TEMP:
     LightIdCount count;
+    // In ids, even
+    uint lightIdCapacity;
 } constants;
 
-#define MAX_LIGHTS_PER_TILE (64)
-#define MAX_POINT_LIGHTS (16384)
+// Set by tiledLightCullingPass(), grown when a tile found more lights
+layout(constant_id = 0) const uint MAX_LIGHTS_PER_TILE = 64;
+layout(constant_id = 1) const uint MAX_POINT_LIGHTS = 16384;
 
 shared uint localLightIdCount;
 shared uint localLightIds[MAX_LIGHTS_PER_TILE];
@@ -98,20 +100,24 @@ void main()
             break;
 
         PointLight light = constants.lights.pointLights[lightId];
-        vec4 lightPosVS = scene.view * vec4(light.pos.xyz, 1.f);
+        vec4 lightPosVS = scene.view * vec4(lightPos(light), 1.f);
 
         // Near-far testing first
-        bool overlapsFrustum = ((-lightPosVS.z - light.range.x) < maxDepthVS) &&
-                               ((-lightPosVS.z + light.range.x) > minDepthVS);
+        bool overlapsFrustum = ((-lightPosVS.z - light.range) < maxDepthVS) &&
+                               ((-lightPosVS.z + light.range) > minDepthVS);
         for (int j = 0; j < 4 && overlapsFrustum; j++)
         {
             float lightToPlane = dot(frustumPlanes[j].n, lightPosVS.xyz) - frustumPlanes[j].d;
-            overlapsFrustum = overlapsFrustum && (0 <= lightToPlane + light.range.x);
+            overlapsFrustum = overlapsFrustum && (0 <= lightToPlane + light.range);
         }
 
         if (overlapsFrustum)
         {
-            localLightIds[atomicAdd(localLightIdCount, 1)] = lightId;
+            uint slot = atomicAdd(localLightIdCount, 1);
+            if (slot < MAX_LIGHTS_PER_TILE)
+            {
+                localLightIds[slot] = lightId;
+            }
         }
     }
     barrier();
@@ -119,13 +125,18 @@ void main()
     // TODO: maybe allow all threads to write some values?
     if (gl_LocalInvocationIndex == 0)
     {
-        uint lightIdStart = atomicAdd(constants.count.lightIdCount, localLightIdCount);
-        constants.lightTiles.tiles[tileId].count = localLightIdCount;
+        atomicMax(constants.count.maxTileLightCount, localLightIdCount);
+        uint gathered = min(localLightIdCount, MAX_LIGHTS_PER_TILE);
+        uint lightIdStart = atomicAdd(constants.count.lightIdCount, lightIdSlots(gathered));
+        // Past the end of a full list only what fits is kept, the CPU grows it for later frames
+        uint tileLightCount = min(gathered, constants.lightIdCapacity - min(lightIdStart, constants.lightIdCapacity));
+        constants.lightTiles.tiles[tileId].count = tileLightCount;
         constants.lightTiles.tiles[tileId].offset = lightIdStart;
 
-        for (int i = 0; i < localLightIdCount; i++)
+        for (uint i = 0; i < tileLightCount; i += 2)
         {
-            constants.ids.ids[lightIdStart + i] = localLightIds[i];
+            uint second = i + 1 < tileLightCount ? localLightIds[i + 1] : 0;
+            constants.ids.packedIds[(lightIdStart + i) / 2] = localLightIds[i] | (second << 16);
         }
     }
 }
\ No newline at end of file
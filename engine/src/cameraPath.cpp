@@ -0,0 +1,115 @@
+#include "cameraPath.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <print>
+#include <sstream>
+
+static auto catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, f32 t)
+    -> glm::vec3
+{
+    const f32 t2 = t * t;
+    const f32 t3 = t2 * t;
+    return 0.5f * ((2.f * p1) + (-p0 + p2) * t + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 +
+        (-p0 + 3.f * p1 - 3.f * p2 + p3) * t3);
+}
+
+auto applyCameraPath(const CameraPath& path, Camera& camera, f32 t) -> void
+{
+    if (path.keyframes.empty())
+    {
+        return;
+    }
+
+    const i32 last = static_cast<i32>(path.keyframes.size()) - 1;
+    const f32 segment = std::clamp(t, 0.f, 1.f) * static_cast<f32>(last);
+    const i32 from = std::min(static_cast<i32>(segment), last);
+    const f32 alpha = segment - static_cast<f32>(from);
+
+    // Endpoints are duplicated, so the spline passes through the first and last keyframe
+    const auto& k0 = path.keyframes[std::max(from - 1, 0)];
+    const auto& k1 = path.keyframes[from];
+    const auto& k2 = path.keyframes[std::min(from + 1, last)];
+    const auto& k3 = path.keyframes[std::min(from + 2, last)];
+
+    const glm::vec3 position = catmullRom(k0.position, k1.position, k2.position, k3.position, alpha);
+    const glm::vec3 target = catmullRom(k0.target, k1.target, k2.target, k3.target, alpha);
+
+    camera.position = position;
+    // lookAt gives world->view, the camera stores the rotation of view->world
+    camera.rotation = glm::inverse(glm::lookAt(glm::vec3(0.f), target - position, glm::vec3(0.f, 1.f, 0.f)));
+}
+
+auto keyframeFromCamera(const Camera& camera) -> CameraPath::Keyframe
+{
+    const glm::vec3 forward = camera.rotation * glm::vec4(0.f, 0.f, -1.f, 0.f);
+    return CameraPath::Keyframe{
+        .position = camera.position,
+        .target = camera.position + forward,
+    };
+}
+
+auto loadCameraPath(const std::string& path) -> std::optional<CameraPath>
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::println("Failed opening camera path {}", path);
+        return std::nullopt;
+    }
+
+    CameraPath cameraPath;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream stream(line);
+        CameraPath::Keyframe keyframe;
+        stream >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.target.x >>
+            keyframe.target.y >> keyframe.target.z;
+        if (!stream)
+        {
+            std::println("Malformed camera path keyframe \"{}\" in {}", line, path);
+            return std::nullopt;
+        }
+        cameraPath.keyframes.push_back(keyframe);
+    }
+
+    return cameraPath;
+}
+
+auto saveCameraPath(const CameraPath& cameraPath, const std::string& path) -> bool
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::println("Failed opening camera path {}", path);
+        return false;
+    }
+
+    file << "# px py pz tx ty tz\n";
+    for (const auto& keyframe : cameraPath.keyframes)
+    {
+        file << std::format("{} {} {} {} {} {}\n", keyframe.position.x, keyframe.position.y, keyframe.position.z,
+            keyframe.target.x, keyframe.target.y, keyframe.target.z);
+    }
+    return static_cast<bool>(file);
+}
+
+auto sponzaFlythrough() -> CameraPath
+{
+    return CameraPath{
+        .keyframes = {
+            {.position = glm::vec3(-10.f, 2.f, -0.5f), .target = glm::vec3(0.f, 2.f, -0.5f)},
+            {.position = glm::vec3(0.f, 3.f, 0.f), .target = glm::vec3(10.f, 3.f, 1.f)},
+            {.position = glm::vec3(10.f, 5.f, 0.5f), .target = glm::vec3(0.f, 4.f, 0.f)},
+            {.position = glm::vec3(0.f, 8.f, 3.f), .target = glm::vec3(-10.f, 2.f, -1.f)},
+            {.position = glm::vec3(-10.f, 2.f, -0.5f), .target = glm::vec3(0.f, 2.f, -0.5f)},
+        },
+    };
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "camera.h"
+#include "engine.h"
+
+#include <glm/glm.hpp>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// Deterministic fly-through, used to make benchmark runs reproducible. Position and look-at target follow a
+// Catmull-Rom spline through evenly spaced keyframes.
+struct CameraPath
+{
+    struct Keyframe
+    {
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+    std::vector<Keyframe> keyframes;
+};
+
+// t in [0, 1] covers the whole path
+auto applyCameraPath(const CameraPath& path, Camera& camera, f32 t) -> void;
+// Keyframe looking where the camera currently looks, for recording paths by flying around
+auto keyframeFromCamera(const Camera& camera) -> CameraPath::Keyframe;
+
+// One keyframe per line: "px py pz tx ty tz"
+auto loadCameraPath(const std::string& path) -> std::optional<CameraPath>;
+auto saveCameraPath(const CameraPath& cameraPath, const std::string& path) -> bool;
+
+// Through the Sponza atrium and back
+auto sponzaFlythrough() -> CameraPath;
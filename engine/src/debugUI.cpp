@@ -13,11 +13,6 @@
 
 DebugUI debugUI;
 
-auto addDebugUI(DebugUI& debugUi, std::string parentId, std::function<void()> fn) -> void
-{
-    debugUi.fns[parentId].push_back(fn);
-}
-
 void drawDebugUI(DebugUI& debugUi, VulkanBackend& backend, Scene& scene, f64 dt)
 {
     constexpr f32 padding = 10.0f;
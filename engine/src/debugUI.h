@@ -1,9 +1,12 @@
 #pragma once
 
 #include "engine.h"
+#include "memory/linearArena.h"
+#include "rhi/renderpass.h"
 
-#include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class VulkanBackend;
 struct Scene;
@@ -22,12 +25,19 @@ constexpr const char* GRAPHICS_PASSES_CSTR = GRAPHICS_PASSES.c_str();
 
 struct DebugUI
 {
-    std::unordered_map<std::string, std::vector<std::function<void()>>> fns;
+    // Captures live in a frame arena, see addDebugUI(). The vectors are only cleared, so steady frames don't allocate.
+    std::unordered_map<std::string, std::vector<PassCallback<void()>>> fns;
     std::string selectedNode;
 };
 
 extern DebugUI debugUI;
 
-auto addDebugUI(DebugUI& debugUI, std::string parentId, std::function<void()> fn) -> void;
+// fn is drawn by the next drawDebugUI(). Its captures go into arena, which has to be the current frame's arena: UI
+// added while a frame is recorded is drawn the frame after, still before that arena is reset.
+template <typename F>
+auto addDebugUI(DebugUI& debugUI, LinearArena& arena, const std::string& parentId, F&& fn) -> void
+{
+    debugUI.fns[parentId].push_back(PassCallback<void()>::bind(arena, std::forward<F>(fn)));
+}
 
 auto drawDebugUI(DebugUI& debugUI, VulkanBackend& backend, Scene& scene, f64 dt) -> void;
@@ -0,0 +1,7 @@
+// Single translation unit for the header-only libraries, shared by the engine and the benchmark executables
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "tiny_gltf.h"
+#include "stb_image_write.h"
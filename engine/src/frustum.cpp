@@ -0,0 +1,36 @@
+#include "frustum.h"
+
+auto frustumPlanes(const glm::mat4& viewProj) -> FrustumPlanes
+{
+    const auto viewProjTranspose = glm::transpose(viewProj);
+    return FrustumPlanes{
+        (viewProjTranspose[3] + viewProjTranspose[0]),
+        (viewProjTranspose[3] - viewProjTranspose[0]),
+        (viewProjTranspose[3] + viewProjTranspose[1]),
+        (viewProjTranspose[3] - viewProjTranspose[1]),
+        (viewProjTranspose[3] + viewProjTranspose[2]),
+        (viewProjTranspose[3] - viewProjTranspose[2]),
+    };
+}
+
+auto insideCameraFrustum(const glm::vec3 aabbMin, const glm::vec3 aabbMax, const FrustumPlanes& frustumPlanes)
+    -> bool
+{
+    for (u8 i = 0; i < 6; ++i)
+    {
+        const glm::vec4& plane = frustumPlanes[i];
+        if ((glm::dot(plane, glm::vec4(aabbMin.x, aabbMin.y, aabbMin.z, 1.0f)) < 0.0) &&
+            (glm::dot(plane, glm::vec4(aabbMax.x, aabbMin.y, aabbMin.z, 1.0f)) < 0.0) &&
+            (glm::dot(plane, glm::vec4(aabbMin.x, aabbMax.y, aabbMin.z, 1.0f)) < 0.0) &&
+            (glm::dot(plane, glm::vec4(aabbMax.x, aabbMax.y, aabbMin.z, 1.0f)) < 0.0) &&
+            (glm::dot(plane, glm::vec4(aabbMin.x, aabbMin.y, aabbMax.z, 1.0f)) < 0.0) &&
+            (glm::dot(plane, glm::vec4(aabbMax.x, aabbMin.y, aabbMax.z, 1.0f)) < 0.0) &&
+            (glm::dot(plane, glm::vec4(aabbMin.x, aabbMax.y, aabbMax.z, 1.0f)) < 0.0) &&
+            (glm::dot(plane, glm::vec4(aabbMax.x, aabbMax.y, aabbMax.z, 1.0f)) < 0.0))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "engine.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+// Gribb-Hartmann extraction, planes point inwards and aren't normalized
+[[nodiscard]]
+auto frustumPlanes(const glm::mat4& viewProj) -> FrustumPlanes;
+
+[[nodiscard]]
+auto insideCameraFrustum(const glm::vec3 aabbMin, const glm::vec3 aabbMax, const FrustumPlanes& frustumPlanes)
+    -> bool;
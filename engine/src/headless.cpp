@@ -0,0 +1,43 @@
+#include "headless.h"
+
+#include "renderGraphStats.h"
+#include "rhi/vulkan/backend.h"
+#include "scene.h"
+#include "worldRenderer.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+auto renderCameraPath(WorldRenderer& worldRenderer, Scene& scene, const CameraPath& path, u32 frameCount,
+    const std::function<void(const HeadlessFrame&)>& onFrame) -> void
+{
+    ZoneScoped;
+
+    VulkanBackend& backend = worldRenderer.backend;
+
+    // Fixed timestep, so that animations don't depend on how fast the machine is
+    constexpr f64 dt = 1.0 / 60.0;
+    for (u32 i = 0; i < frameCount; i++)
+    {
+        applyCameraPath(path, scene.mainCamera, static_cast<f32>(i) / std::max(frameCount - 1, 1u));
+
+        Frame frame = backend.newFrame();
+        frame.stats.pastFrameDt = dt;
+
+        worldRenderer.render(frame, scene, dt);
+
+        const FrameStats stats = backend.endFrame(std::move(frame));
+        const std::chrono::duration<f64, std::milli> cpuTime = std::chrono::high_resolution_clock::now() -
+            stats.startTime;
+
+        f64 gpuMs = 0.0;
+        for (const auto& pass : backend.renderGraphStats.passes)
+        {
+            gpuMs += pass.count > 0 ? latestSample(pass).gpuMs : 0.0;
+        }
+
+        onFrame(HeadlessFrame{.index = i, .cpuMs = cpuTime.count(), .gpuMs = gpuMs});
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "cameraPath.h"
+#include "engine.h"
+
+#include <functional>
+
+struct Scene;
+class VulkanBackend;
+struct WorldRenderer;
+
+struct HeadlessFrame
+{
+    u32 index;
+    // Wall time of the whole frame
+    f64 cpuMs;
+    // Sum of all passes. Lags behind by MaxFramesInFlight frames, see RenderGraphStats.
+    f64 gpuMs;
+};
+
+// Renders frameCount frames with a fixed timestep while flying the main camera along the path. onFrame is called
+// after every frame, the backend's render graph stats are up to date at that point.
+auto renderCameraPath(WorldRenderer& worldRenderer, Scene& scene, const CameraPath& path, u32 frameCount,
+    const std::function<void(const HeadlessFrame&)>& onFrame) -> void;
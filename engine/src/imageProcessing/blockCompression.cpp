@@ -0,0 +1,466 @@
+#include "imageProcessing/blockCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+// Channel-major, so the per pixel loops below vectorize over the 16 pixels of a block
+struct Block
+{
+    std::array<std::array<i32, 16>, 4> channels;
+};
+
+static auto loadBlock(std::span<const u8> rgba, u32 width, u32 height, u32 blockX, u32 blockY) -> Block
+{
+    Block block;
+    for (u32 y = 0; y < 4; ++y)
+    {
+        const u32 row = std::min(blockY * 4 + y, height - 1);
+        for (u32 x = 0; x < 4; ++x)
+        {
+            const u32 column = std::min(blockX * 4 + x, width - 1);
+            const u8* pixel = &rgba[(row * width + column) * 4];
+            for (u32 c = 0; c < 4; ++c)
+            {
+                block.channels[c][y * 4 + x] = pixel[c];
+            }
+        }
+    }
+    return block;
+}
+
+// Always uses the 8 value mode: red_0 > red_1, six values interpolated in between
+static auto encodeBC4(const std::array<i32, 16>& values, u8* out) -> void
+{
+    const i32 low = *std::min_element(values.begin(), values.end());
+    const i32 high = *std::max_element(values.begin(), values.end());
+
+    std::memset(out, 0, 8);
+    out[0] = static_cast<u8>(high);
+    out[1] = static_cast<u8>(low);
+    if (high == low)
+    {
+        return;
+    }
+
+    // Step along high -> low, rounded to the nearest of the 8 palette entries. Palette order is high, low, then the
+    // interpolated ones starting next to high.
+    const i32 range = high - low;
+    std::array<u32, 16> indices;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const i32 step = ((high - values[i]) * 14 + range) / (2 * range);
+        indices[i] = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+    }
+
+    u64 bits = 0;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        bits |= static_cast<u64>(indices[i]) << (3 * i);
+    }
+    for (u32 i = 0; i < 6; ++i)
+    {
+        out[2 + i] = static_cast<u8>(bits >> (8 * i));
+    }
+}
+
+// BC7 is encoded in mode 6 only: a single subset with RGBA 7.7.7.7 endpoints, a p-bit each and 4 bit indices. It
+// is the mode that handles smooth gradients best and keeps the encoder simple, at the cost of blocks with two
+// distinct colour clusters.
+static constexpr std::array<i32, 16> bc7Weights = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Endpoints
+{
+    // The 8 bit endpoint is (q << 1) | p
+    std::array<i32, 4> q0;
+    std::array<i32, 4> q1;
+    i32 p0;
+    i32 p1;
+};
+
+using Endpoint = std::array<f32, 4>;
+
+static auto quantizeEndpoint(const Endpoint& endpoint, std::array<i32, 4>& q, i32& p) -> void
+{
+    f32 bestError = std::numeric_limits<f32>::max();
+    for (i32 bit = 0; bit < 2; ++bit)
+    {
+        std::array<i32, 4> candidate;
+        f32 error = 0.f;
+        for (u32 c = 0; c < 4; ++c)
+        {
+            candidate[c] = std::clamp(static_cast<i32>(std::lround((endpoint[c] - bit) / 2.f)), 0, 127);
+            const f32 difference = static_cast<f32>(candidate[c] * 2 + bit) - endpoint[c];
+            error += difference * difference;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            q = candidate;
+            p = bit;
+        }
+    }
+}
+
+static auto quantizeEndpoints(const Endpoint& low, const Endpoint& high) -> Bc7Endpoints
+{
+    Bc7Endpoints endpoints;
+    quantizeEndpoint(low, endpoints.q0, endpoints.p0);
+    quantizeEndpoint(high, endpoints.q1, endpoints.p1);
+    return endpoints;
+}
+
+// Squared RGBA error of the whole block
+static auto selectIndices(const Block& block, const Bc7Endpoints& endpoints, std::array<u8, 16>& indices) -> i64
+{
+    std::array<std::array<i32, 16>, 4> palette;
+    for (u32 c = 0; c < 4; ++c)
+    {
+        const i32 e0 = (endpoints.q0[c] << 1) | endpoints.p0;
+        const i32 e1 = (endpoints.q1[c] << 1) | endpoints.p1;
+        for (u32 w = 0; w < 16; ++w)
+        {
+            palette[c][w] = ((64 - bc7Weights[w]) * e0 + bc7Weights[w] * e1 + 32) >> 6;
+        }
+    }
+
+    i64 total = 0;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        std::array<i32, 16> errors = {};
+        for (u32 c = 0; c < 4; ++c)
+        {
+            const i32 value = block.channels[c][i];
+            for (u32 w = 0; w < 16; ++w)
+            {
+                const i32 difference = value - palette[c][w];
+                errors[w] += difference * difference;
+            }
+        }
+
+        u32 best = 0;
+        for (u32 w = 1; w < 16; ++w)
+        {
+            best = errors[w] < errors[best] ? w : best;
+        }
+        indices[i] = static_cast<u8>(best);
+        total += errors[best];
+    }
+    return total;
+}
+
+// Endpoints along the principal axis of the block's colours, spanning all of its pixels
+static auto principalEndpoints(const Block& block, Endpoint& low, Endpoint& high) -> void
+{
+    Endpoint mean = {};
+    Endpoint axis = {};
+    for (u32 c = 0; c < 4; ++c)
+    {
+        const auto& values = block.channels[c];
+        for (u32 i = 0; i < 16; ++i)
+        {
+            mean[c] += static_cast<f32>(values[i]);
+        }
+        mean[c] /= 16.f;
+        axis[c] = static_cast<f32>(*std::max_element(values.begin(), values.end()) -
+            *std::min_element(values.begin(), values.end()));
+    }
+
+    std::array<std::array<f32, 4>, 4> covariance = {};
+    for (u32 i = 0; i < 16; ++i)
+    {
+        Endpoint d;
+        for (u32 c = 0; c < 4; ++c)
+        {
+            d[c] = static_cast<f32>(block.channels[c][i]) - mean[c];
+        }
+        for (u32 a = 0; a < 4; ++a)
+        {
+            for (u32 b = 0; b < 4; ++b)
+            {
+                covariance[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    // Power iteration, starting from the bounding box diagonal converges in a handful of steps
+    for (u32 iteration = 0; iteration < 8; ++iteration)
+    {
+        Endpoint next = {};
+        for (u32 a = 0; a < 4; ++a)
+        {
+            for (u32 b = 0; b < 4; ++b)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+        }
+        const f32 length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if (length < 1e-6f)
+        {
+            break;
+        }
+        for (u32 c = 0; c < 4; ++c)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    f32 minProjection = 0.f;
+    f32 maxProjection = 0.f;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        f32 projection = 0.f;
+        for (u32 c = 0; c < 4; ++c)
+        {
+            projection += (static_cast<f32>(block.channels[c][i]) - mean[c]) * axis[c];
+        }
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    // A flat block has a zero axis, both endpoints end up at the mean
+    const f32 axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+    const f32 scale = axisLength > 0.f ? 1.f / axisLength : 0.f;
+    for (u32 c = 0; c < 4; ++c)
+    {
+        low[c] = std::clamp(mean[c] + axis[c] * minProjection * scale, 0.f, 255.f);
+        high[c] = std::clamp(mean[c] + axis[c] * maxProjection * scale, 0.f, 255.f);
+    }
+}
+
+// Least squares endpoints for fixed indices. False if the indices don't constrain both endpoints.
+static auto refineEndpoints(const Block& block, const std::array<u8, 16>& indices, Endpoint& low, Endpoint& high)
+    -> bool
+{
+    f32 aa = 0.f;
+    f32 ab = 0.f;
+    f32 bb = 0.f;
+    Endpoint ax = {};
+    Endpoint bx = {};
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const f32 b = static_cast<f32>(bc7Weights[indices[i]]) / 64.f;
+        const f32 a = 1.f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (u32 c = 0; c < 4; ++c)
+        {
+            ax[c] += a * static_cast<f32>(block.channels[c][i]);
+            bx[c] += b * static_cast<f32>(block.channels[c][i]);
+        }
+    }
+
+    const f32 determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+    {
+        return false;
+    }
+    for (u32 c = 0; c < 4; ++c)
+    {
+        low[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.f, 255.f);
+        high[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.f, 255.f);
+    }
+    return true;
+}
+
+struct BitWriter
+{
+    u8* out;
+    u32 offset = 0;
+
+    auto write(u32 value, u32 bitCount) -> void
+    {
+        for (u32 i = 0; i < bitCount; ++i, ++offset)
+        {
+            out[offset / 8] |= static_cast<u8>(((value >> i) & 1) << (offset % 8));
+        }
+    }
+};
+
+static auto encodeBC7(const Block& block, u8* out) -> void
+{
+    Endpoint low;
+    Endpoint high;
+    principalEndpoints(block, low, high);
+
+    Bc7Endpoints best = quantizeEndpoints(low, high);
+    std::array<u8, 16> bestIndices;
+    i64 bestError = selectIndices(block, best, bestIndices);
+    for (u32 iteration = 0; iteration < 2 && bestError > 0; ++iteration)
+    {
+        if (!refineEndpoints(block, bestIndices, low, high))
+        {
+            break;
+        }
+        const Bc7Endpoints candidate = quantizeEndpoints(low, high);
+        std::array<u8, 16> indices;
+        const i64 error = selectIndices(block, candidate, indices);
+        if (error >= bestError)
+        {
+            break;
+        }
+        best = candidate;
+        bestIndices = indices;
+        bestError = error;
+    }
+
+    // The first pixel is the anchor, its index MSB is implicitly 0
+    if (bestIndices[0] & 8)
+    {
+        std::swap(best.q0, best.q1);
+        std::swap(best.p0, best.p1);
+        for (auto& index : bestIndices)
+        {
+            index = 15 - index;
+        }
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter writer{.out = out};
+    writer.write(1 << 6, 7);
+    for (u32 c = 0; c < 4; ++c)
+    {
+        writer.write(best.q0[c], 7);
+        writer.write(best.q1[c], 7);
+    }
+    writer.write(best.p0, 1);
+    writer.write(best.p1, 1);
+    writer.write(bestIndices[0], 3);
+    for (u32 i = 1; i < 16; ++i)
+    {
+        writer.write(bestIndices[i], 4);
+    }
+}
+
+auto blockFormatFor(TextureKind kind) -> BlockFormat
+{
+    switch (kind)
+    {
+        case TextureKind::Normal:
+            return BlockFormat::BC5;
+        case TextureKind::Height:
+            return BlockFormat::BC4;
+        case TextureKind::Color:
+        default:
+            return BlockFormat::BC7;
+    }
+}
+
+auto blockBytes(BlockFormat format) -> u32
+{
+    return format == BlockFormat::BC4 ? 8 : 16;
+}
+
+auto compressedSize(BlockFormat format, u32 width, u32 height) -> size_t
+{
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+auto compressImage(std::span<const u8> rgba, u32 width, u32 height, BlockFormat format) -> std::vector<u8>
+{
+    const u32 blocksX = (width + 3) / 4;
+    const u32 blocksY = (height + 3) / 4;
+    const u32 bytesPerBlock = blockBytes(format);
+
+    std::vector<u8> compressed(compressedSize(format, width, height));
+    for (u32 blockY = 0; blockY < blocksY; ++blockY)
+    {
+        for (u32 blockX = 0; blockX < blocksX; ++blockX)
+        {
+            const Block block = loadBlock(rgba, width, height, blockX, blockY);
+            u8* out = &compressed[(blockY * blocksX + blockX) * bytesPerBlock];
+            switch (format)
+            {
+                case BlockFormat::BC4:
+                    encodeBC4(block.channels[0], out);
+                    break;
+                case BlockFormat::BC5:
+                    encodeBC4(block.channels[0], out);
+                    encodeBC4(block.channels[1], out + 8);
+                    break;
+                case BlockFormat::BC7:
+                    encodeBC7(block, out);
+                    break;
+            }
+        }
+    }
+    return compressed;
+}
+
+auto downsampleImage(std::span<const u8> rgba, u32 width, u32 height, TextureKind kind) -> std::vector<u8>
+{
+    const u32 mipWidth = std::max(width / 2, 1u);
+    const u32 mipHeight = std::max(height / 2, 1u);
+
+    std::vector<u8> mip(mipWidth * mipHeight * 4);
+    for (u32 y = 0; y < mipHeight; ++y)
+    {
+        const u32 y0 = std::min(y * 2, height - 1);
+        const u32 y1 = std::min(y * 2 + 1, height - 1);
+        for (u32 x = 0; x < mipWidth; ++x)
+        {
+            const u32 x0 = std::min(x * 2, width - 1);
+            const u32 x1 = std::min(x * 2 + 1, width - 1);
+
+            u8* out = &mip[(y * mipWidth + x) * 4];
+            for (u32 c = 0; c < 4; ++c)
+            {
+                const u32 sum = rgba[(y0 * width + x0) * 4 + c] + rgba[(y0 * width + x1) * 4 + c] +
+                    rgba[(y1 * width + x0) * 4 + c] + rgba[(y1 * width + x1) * 4 + c];
+                out[c] = static_cast<u8>((sum + 2) / 4);
+            }
+
+            if (kind == TextureKind::Normal)
+            {
+                f32 n[3];
+                for (u32 c = 0; c < 3; ++c)
+                {
+                    n[c] = static_cast<f32>(out[c]) / 255.f * 2.f - 1.f;
+                }
+                const f32 length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length > 1e-6f)
+                {
+                    for (u32 c = 0; c < 3; ++c)
+                    {
+                        out[c] = static_cast<u8>(std::lround((n[c] / length * 0.5f + 0.5f) * 255.f));
+                    }
+                }
+            }
+        }
+    }
+    return mip;
+}
+
+auto compressTexture(std::span<const u8> rgba, u32 width, u32 height, TextureKind kind) -> CompressedImage
+{
+    CompressedImage image = {
+        .format = blockFormatFor(kind),
+        .width = width,
+        .height = height,
+    };
+
+    const u32 mipCount = std::bit_width(std::min(width, height));
+    image.mips.reserve(mipCount);
+
+    std::vector<u8> downsampled;
+    std::span<const u8> level = rgba;
+    u32 levelWidth = width;
+    u32 levelHeight = height;
+    for (u32 mip = 0; mip < mipCount; ++mip)
+    {
+        image.mips.push_back(compressImage(level, levelWidth, levelHeight, image.format));
+        if (mip + 1 < mipCount)
+        {
+            downsampled = downsampleImage(level, levelWidth, levelHeight, kind);
+            level = downsampled;
+            levelWidth = std::max(levelWidth / 2, 1u);
+            levelHeight = std::max(levelHeight / 2, 1u);
+        }
+    }
+    return image;
+}
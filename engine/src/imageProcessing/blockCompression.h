@@ -0,0 +1,51 @@
+#pragma once
+
+#include "engine.h"
+
+#include <span>
+#include <vector>
+
+// Block compressed formats the import step produces. BC4 keeps R, BC5 keeps RG, BC7 keeps RGBA.
+enum class BlockFormat : u8
+{
+    BC4,
+    BC5,
+    BC7,
+};
+
+// What an image is used for, picks the format and how mips are filtered
+enum class TextureKind : u8
+{
+    Color,
+    Normal,
+    Height,
+};
+
+struct CompressedImage
+{
+    BlockFormat format;
+    u32 width;
+    u32 height;
+    // Mip 0 first, each one a tightly packed grid of 4x4 blocks
+    std::vector<std::vector<u8>> mips;
+};
+
+[[nodiscard]]
+auto blockFormatFor(TextureKind kind) -> BlockFormat;
+// 8 for BC4, 16 for the rest
+[[nodiscard]]
+auto blockBytes(BlockFormat format) -> u32;
+[[nodiscard]]
+auto compressedSize(BlockFormat format, u32 width, u32 height) -> size_t;
+
+// Encodes a single RGBA8 image. Partial blocks on the right and bottom edge repeat the last row/column.
+[[nodiscard]]
+auto compressImage(std::span<const u8> rgba, u32 width, u32 height, BlockFormat format) -> std::vector<u8>;
+
+// Halves the image with a box filter. Normals are renormalized after averaging, so lower mips don't flatten out.
+[[nodiscard]]
+auto downsampleImage(std::span<const u8> rgba, u32 width, u32 height, TextureKind kind) -> std::vector<u8>;
+
+// Full mip chain, down to 1px along the shorter side like the blit path in createTexture()
+[[nodiscard]]
+auto compressTexture(std::span<const u8> rgba, u32 width, u32 height, TextureKind kind) -> CompressedImage;
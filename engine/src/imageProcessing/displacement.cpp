@@ -0,0 +1,241 @@
+#include "imageProcessing/displacement.h"
+
+#include "jobs/threadPool.h"
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+static constexpr u32 kVCycles = 4;
+static constexpr u32 kSmoothingSweeps = 3;
+static constexpr u32 kCoarsestSweeps = 64;
+// Damping that smooths the high frequencies of the 5 point Laplacian the fastest
+static constexpr f32 kJacobiWeight = 0.8f;
+// Coarse levels aren't worth splitting into jobs
+static constexpr u32 kMinRowsPerJob = 32;
+
+// Every level solves 4u - (sum of the 4 neighbours) = rhs with wrapping neighbours. The grid spacing is folded into
+// rhs when restricting.
+struct PoissonLevel
+{
+    u32 width;
+    u32 height;
+    std::vector<f32> u;
+    std::vector<f32> rhs;
+    // Jacobi target, residual
+    std::vector<f32> scratch;
+};
+
+static auto wrapped(i64 i, u32 n) -> u32
+{
+    return static_cast<u32>((i % n + n) % n);
+}
+
+// rowsFn(firstRow, endRow) over all rows, the calling thread takes a share too
+template <typename F>
+static auto forRows(ThreadPool* pool, u32 height, const F& rowsFn) -> void
+{
+    const u32 jobCount = pool == nullptr ? 1 : std::min(pool->threadCount() + 1, height / kMinRowsPerJob);
+    if (jobCount <= 1)
+    {
+        rowsFn(0u, height);
+        return;
+    }
+
+    std::vector<std::future<void>> jobs;
+    jobs.reserve(jobCount - 1);
+    for (u32 job = 1; job < jobCount; ++job)
+    {
+        const u32 firstRow = height * job / jobCount;
+        const u32 endRow = height * (job + 1) / jobCount;
+        jobs.push_back(pool->submit([&rowsFn, firstRow, endRow]() { rowsFn(firstRow, endRow); }));
+    }
+    rowsFn(0u, height / jobCount);
+    for (auto& job : jobs)
+    {
+        job.get();
+    }
+}
+
+// Only the first and last texel of a row wrap, the rest is a plain loop the compiler vectorizes
+static auto relaxRows(const PoissonLevel& level, std::vector<f32>& out, u32 firstRow, u32 endRow) -> void
+{
+    const u32 w = level.width;
+    for (u32 y = firstRow; y < endRow; ++y)
+    {
+        const f32* up = &level.u[wrapped(static_cast<i64>(y) - 1, level.height) * w];
+        const f32* row = &level.u[y * w];
+        const f32* down = &level.u[wrapped(static_cast<i64>(y) + 1, level.height) * w];
+        const f32* rhs = &level.rhs[y * w];
+        f32* dst = &out[y * w];
+
+        for (u32 x = 1; x + 1 < w; ++x)
+        {
+            const f32 jacobi = (row[x - 1] + row[x + 1] + up[x] + down[x] + rhs[x]) * 0.25f;
+            dst[x] = row[x] + kJacobiWeight * (jacobi - row[x]);
+        }
+        for (const u32 x : {0u, w - 1})
+        {
+            const f32 jacobi = (row[wrapped(x - 1ll, w)] + row[wrapped(x + 1ll, w)] + up[x] + down[x] + rhs[x]) * 0.25f;
+            dst[x] = row[x] + kJacobiWeight * (jacobi - row[x]);
+        }
+    }
+}
+
+static auto residualRows(const PoissonLevel& level, std::vector<f32>& out, u32 firstRow, u32 endRow) -> void
+{
+    const u32 w = level.width;
+    for (u32 y = firstRow; y < endRow; ++y)
+    {
+        const f32* up = &level.u[wrapped(static_cast<i64>(y) - 1, level.height) * w];
+        const f32* row = &level.u[y * w];
+        const f32* down = &level.u[wrapped(static_cast<i64>(y) + 1, level.height) * w];
+        const f32* rhs = &level.rhs[y * w];
+        f32* dst = &out[y * w];
+
+        for (u32 x = 1; x + 1 < w; ++x)
+        {
+            dst[x] = rhs[x] - (4.f * row[x] - row[x - 1] - row[x + 1] - up[x] - down[x]);
+        }
+        for (const u32 x : {0u, w - 1})
+        {
+            dst[x] = rhs[x] - (4.f * row[x] - row[wrapped(x - 1ll, w)] - row[wrapped(x + 1ll, w)] - up[x] - down[x]);
+        }
+    }
+}
+
+static auto smooth(PoissonLevel& level, u32 sweeps, ThreadPool* pool) -> void
+{
+    for (u32 i = 0; i < sweeps; ++i)
+    {
+        forRows(pool, level.height,
+            [&](u32 firstRow, u32 endRow) { relaxRows(level, level.scratch, firstRow, endRow); });
+        std::swap(level.u, level.scratch);
+    }
+}
+
+// Coarse texels cover 2x2 fine ones. Twice the spacing means 4 times the rhs, so the average times 4.
+static auto restrictResidual(const PoissonLevel& fine, PoissonLevel& coarse, ThreadPool* pool) -> void
+{
+    forRows(pool, coarse.height, [&](u32 firstRow, u32 endRow)
+    {
+        for (u32 y = firstRow; y < endRow; ++y)
+        {
+            const f32* top = &fine.scratch[2 * y * fine.width];
+            const f32* bottom = top + fine.width;
+            for (u32 x = 0; x < coarse.width; ++x)
+            {
+                coarse.rhs[y * coarse.width + x] = top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1];
+            }
+        }
+    });
+    std::fill(coarse.u.begin(), coarse.u.end(), 0.f);
+}
+
+// Bilinear between the centers of the coarse texels
+static auto prolongCorrection(const PoissonLevel& coarse, PoissonLevel& fine, ThreadPool* pool) -> void
+{
+    forRows(pool, fine.height, [&](u32 firstRow, u32 endRow)
+    {
+        for (u32 y = firstRow; y < endRow; ++y)
+        {
+            const u32 nearY = y / 2;
+            const u32 farY = wrapped(static_cast<i64>(nearY) + ((y & 1) ? 1 : -1), coarse.height);
+            const f32* nearRow = &coarse.u[nearY * coarse.width];
+            const f32* farRow = &coarse.u[farY * coarse.width];
+            f32* dst = &fine.u[y * fine.width];
+            for (u32 x = 0; x < coarse.width; ++x)
+            {
+                const u32 left = x == 0 ? coarse.width - 1 : x - 1;
+                const u32 right = x + 1 == coarse.width ? 0 : x + 1;
+                const f32 center = 3.f * nearRow[x] + farRow[x];
+                dst[2 * x] += (3.f * center + 3.f * nearRow[left] + farRow[left]) * (1.f / 16.f);
+                dst[2 * x + 1] += (3.f * center + 3.f * nearRow[right] + farRow[right]) * (1.f / 16.f);
+            }
+        }
+    });
+}
+
+static auto vCycle(std::vector<PoissonLevel>& levels, u32 index, ThreadPool* pool) -> void
+{
+    PoissonLevel& level = levels[index];
+    if (index + 1 == levels.size())
+    {
+        smooth(level, kCoarsestSweeps, pool);
+        return;
+    }
+
+    smooth(level, kSmoothingSweeps, pool);
+    forRows(pool, level.height,
+        [&](u32 firstRow, u32 endRow) { residualRows(level, level.scratch, firstRow, endRow); });
+    restrictResidual(level, levels[index + 1], pool);
+    vCycle(levels, index + 1, pool);
+    prolongCorrection(levels[index + 1], level, pool);
+    smooth(level, kSmoothingSweeps, pool);
+}
+
+auto tangentNormalMapToBumpMap(const u8* normal, u32 width, u32 height, ThreadPool* pool) -> std::vector<u8>
+{
+    ZoneScoped;
+
+    // Halved while both sides stay even, the coarsest level is small enough for plain Jacobi
+    std::vector<PoissonLevel> levels;
+    for (u32 w = width, h = height;; w /= 2, h /= 2)
+    {
+        const size_t size = static_cast<size_t>(w) * h;
+        levels.push_back(PoissonLevel{
+            .width = w,
+            .height = h,
+            .u = std::vector<f32>(size, 0.f),
+            .rhs = std::vector<f32>(size),
+            .scratch = std::vector<f32>(size),
+        });
+        if (w % 2 != 0 || h % 2 != 0 || std::min(w, h) < 8)
+        {
+            break;
+        }
+    }
+
+    // Divergence of the normal's xy. The solution on a wrapping grid only exists for a zero mean rhs.
+    PoissonLevel& finest = levels.front();
+    f64 sum = 0.0;
+    for (u32 y = 0; y < height; ++y)
+    {
+        const u8* up = &normal[wrapped(static_cast<i64>(y) - 1, height) * width * 4];
+        const u8* row = &normal[y * width * 4];
+        const u8* down = &normal[wrapped(static_cast<i64>(y) + 1, height) * width * 4];
+        for (u32 x = 0; x < width; ++x)
+        {
+            const f32 ddx = static_cast<f32>(row[wrapped(x + 1ll, width) * 4]) - row[wrapped(x - 1ll, width) * 4];
+            const f32 ddy = static_cast<f32>(down[x * 4 + 1]) - up[x * 4 + 1];
+            finest.rhs[y * width + x] = (ddx + ddy) / (2.f * 255.f);
+            sum += finest.rhs[y * width + x];
+        }
+    }
+    const f32 mean = static_cast<f32>(sum / (static_cast<f64>(width) * height));
+    for (f32& rhs : finest.rhs)
+    {
+        rhs -= mean;
+    }
+
+    for (u32 i = 0; i < kVCycles; ++i)
+    {
+        vCycle(levels, 0, pool);
+    }
+
+    const auto [lo, hi] = std::minmax_element(finest.u.begin(), finest.u.end());
+    const f32 scale = *hi > *lo ? 1.f / (*hi - *lo) : 0.f;
+
+    // Assumes data is RGBA, 1B per channel. For the time being this also outputs RGBA
+    std::vector<u8> bumpMap(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < finest.u.size(); ++i)
+    {
+        const u8 value = static_cast<u8>((finest.u[i] - *lo) * scale * 255.f + 0.5f);
+        bumpMap[i * 4 + 0] = value;
+        bumpMap[i * 4 + 1] = value;
+        bumpMap[i * 4 + 2] = value;
+        bumpMap[i * 4 + 3] = 255;
+    }
+    return bumpMap;
+}
@@ -0,0 +1,325 @@
+#include "io/gltfLoader.h"
+
+#include "json.hpp"
+#include "tracy/Tracy.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <print>
+
+using json = nlohmann::json;
+
+static constexpr std::string_view emptyDataUri = "data:application/octet-stream;base64,";
+
+// "%20" and friends, glTF URIs are percent-encoded
+static auto decodeUri(const std::string& uri) -> std::string
+{
+    std::string decoded;
+    decoded.reserve(uri.size());
+    for (size_t i = 0; i < uri.size(); i++)
+    {
+        if (uri[i] == '%' && i + 2 < uri.size())
+        {
+            decoded.push_back(static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16)));
+            i += 2;
+        }
+        else
+        {
+            decoded.push_back(uri[i]);
+        }
+    }
+    return decoded;
+}
+
+// The document is only checked by tinygltf after the rewrite below, fields read before that are checked here so
+// that a malformed file is an error rather than a json exception. Missing fields are 0 or empty.
+static auto unsignedField(const json& object, const char* key) -> std::optional<size_t>
+{
+    const auto field = object.find(key);
+    if (field == object.end())
+    {
+        return 0;
+    }
+    if (!field->is_number_unsigned())
+    {
+        return std::nullopt;
+    }
+    return field->get<size_t>();
+}
+
+static auto stringField(const json& object, const char* key) -> std::optional<std::string>
+{
+    const auto field = object.find(key);
+    if (field == object.end())
+    {
+        return std::string();
+    }
+    if (!field->is_string())
+    {
+        return std::nullopt;
+    }
+    return field->get<std::string>();
+}
+
+struct GlbChunks
+{
+    std::span<const u8> json;
+    std::span<const u8> bin;
+};
+
+static auto parseGlb(std::span<const u8> file) -> std::optional<GlbChunks>
+{
+    constexpr u32 magic = 0x46546C67; // "glTF"
+    constexpr u32 jsonChunk = 0x4E4F534A;
+    constexpr u32 binChunk = 0x004E4942;
+
+    auto readU32 = [&](size_t offset)
+    {
+        u32 value;
+        memcpy(&value, file.data() + offset, sizeof(value));
+        return value;
+    };
+
+    if (file.size() < 20 || readU32(0) != magic || readU32(4) != 2)
+    {
+        return std::nullopt;
+    }
+
+    GlbChunks chunks;
+    size_t offset = 12;
+    while (offset + 8 <= file.size())
+    {
+        const u32 length = readU32(offset);
+        const u32 type = readU32(offset + 4);
+        offset += 8;
+        if (offset + length > file.size())
+        {
+            return std::nullopt;
+        }
+
+        if (type == jsonChunk && chunks.json.empty())
+        {
+            chunks.json = file.subspan(offset, length);
+        }
+        else if (type == binChunk && chunks.bin.empty())
+        {
+            chunks.bin = file.subspan(offset, length);
+        }
+        offset += length;
+    }
+
+    if (chunks.json.empty())
+    {
+        return std::nullopt;
+    }
+    return chunks;
+}
+
+// Only data URI images reach the image loader, the rest are not found on purpose (see loadGltf). Keeps the encoded
+// bytes around for decoding later.
+static auto keepEncodedImage(tinygltf::Image*, const i32 imageIndex, std::string*, std::string*, i32, i32,
+    const unsigned char* bytes, i32 size, void* userData) -> bool
+{
+    auto& asset = *static_cast<GltfAsset*>(userData);
+    auto& data = asset.ownedData.emplace_back(bytes, bytes + size);
+    asset.images.resize(std::max<size_t>(asset.images.size(), imageIndex + 1));
+    asset.images[imageIndex] = data;
+    return true;
+}
+
+auto loadGltf(const std::string& path) -> std::optional<GltfAsset>
+{
+    ZoneScoped;
+
+    GltfAsset asset;
+    const std::filesystem::path baseDir = std::filesystem::path(path).parent_path();
+
+    auto mainFile = mapFile(path);
+    if (!mainFile)
+    {
+        return std::nullopt;
+    }
+
+    std::span<const u8> jsonBytes = mainFile->bytes();
+    std::span<const u8> glbBin;
+    if (path.ends_with(".glb"))
+    {
+        const auto chunks = parseGlb(mainFile->bytes());
+        if (!chunks)
+        {
+            std::println("{} is not a valid GLB file", path);
+            return std::nullopt;
+        }
+        jsonBytes = chunks->json;
+        glbBin = chunks->bin;
+    }
+    asset.files.push_back(std::move(*mainFile));
+
+    json document = json::parse(jsonBytes.begin(), jsonBytes.end(), nullptr, false);
+    if (document.is_discarded())
+    {
+        std::println("Failed parsing {}", path);
+        return std::nullopt;
+    }
+
+    json noElements = json::array();
+    auto elements = [&](const char* key) -> json&
+    {
+        // Anything but an array is left for tinygltf to reject
+        return document.contains(key) && document[key].is_array() ? document[key] : noElements;
+    };
+
+    // Point tinygltf at empty buffers, the data is read straight from the mappings instead of being copied
+    for (auto& buffer : elements("buffers"))
+    {
+        const auto byteLength = buffer.is_object() ? unsignedField(buffer, "byteLength") : std::nullopt;
+        const auto uriField = buffer.is_object() ? stringField(buffer, "uri") : std::nullopt;
+        if (!byteLength || !uriField)
+        {
+            std::println("Malformed buffer in {}", path);
+            return std::nullopt;
+        }
+        const std::string& uri = *uriField;
+        if (uri.starts_with("data:"))
+        {
+            // Decoded by tinygltf, fixed up below
+            asset.buffers.emplace_back();
+            continue;
+        }
+
+        std::span<const u8> data = glbBin;
+        if (!uri.empty())
+        {
+            auto file = mapFile((baseDir / decodeUri(uri)).string());
+            if (!file)
+            {
+                return std::nullopt;
+            }
+            data = file->bytes();
+            asset.files.push_back(std::move(*file));
+        }
+
+        if (data.size() < *byteLength)
+        {
+            std::println("Buffer {} in {} is {} bytes, expected {}", uri, path, data.size(), *byteLength);
+            return std::nullopt;
+        }
+        asset.buffers.push_back(data.first(*byteLength));
+
+        buffer["uri"] = emptyDataUri;
+        buffer["byteLength"] = 0;
+    }
+
+    // Images are only located here, decoding is up to the caller so that it can happen in parallel and one image
+    // at a time can be freed after upload. Images in buffer views are resolved once the views have been checked
+    // against the buffers, and data URI buffers have been decoded.
+    struct ViewImage
+    {
+        size_t image;
+        size_t view;
+    };
+    std::vector<ViewImage> viewImages;
+    const size_t bufferViewCount = elements("bufferViews").size();
+    json& images = elements("images");
+    asset.images.resize(images.size());
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        auto& image = images[i];
+        const auto uriField = image.is_object() ? stringField(image, "uri") : std::nullopt;
+        if (!uriField)
+        {
+            std::println("Malformed image {} in {}", i, path);
+            return std::nullopt;
+        }
+        if (image.contains("bufferView"))
+        {
+            const auto view = unsignedField(image, "bufferView");
+            if (!view || *view >= bufferViewCount)
+            {
+                std::println("Image {} in {} has an invalid buffer view", i, path);
+                return std::nullopt;
+            }
+            viewImages.push_back(ViewImage{.image = i, .view = *view});
+
+            // Never resolves to a file, see fs.FileExists below
+            image.erase("bufferView");
+            image.erase("mimeType");
+            image["uri"] = std::format("{}#image{}", path, i);
+            continue;
+        }
+
+        const std::string& uri = *uriField;
+        if (uri.empty() || uri.starts_with("data:"))
+        {
+            continue;
+        }
+        if (auto file = mapFile((baseDir / decodeUri(uri)).string()))
+        {
+            asset.images[i] = file->bytes();
+            asset.files.push_back(std::move(*file));
+        }
+    }
+
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(keepEncodedImage, &asset);
+    // Nothing external is left for tinygltf to read but images, which were mapped above
+    tinygltf::FsCallbacks fs;
+    fs.FileExists = [](const std::string&, void*) { return false; };
+    fs.ExpandFilePath = tinygltf::ExpandFilePath;
+    fs.ReadWholeFile = tinygltf::ReadWholeFile;
+    fs.WriteWholeFile = tinygltf::WriteWholeFile;
+    fs.GetFileSizeInBytes = tinygltf::GetFileSizeInBytes;
+    loader.SetFsCallbacks(fs);
+
+    std::string err;
+    std::string warn;
+    const std::string rewritten = document.dump();
+    if (!loader.LoadASCIIFromString(&asset.model, &err, &warn, rewritten.c_str(), rewritten.size(), baseDir.string()))
+    {
+        std::println("{}", err);
+        return std::nullopt;
+    }
+
+    // Image URIs double as texture cache keys, don't keep a whole base64 payload around for that
+    for (size_t i = 0; i < asset.model.images.size(); i++)
+    {
+        if (asset.model.images[i].uri.starts_with("data:"))
+        {
+            asset.model.images[i].uri = std::format("{}#image{}", path, i);
+        }
+    }
+
+    for (size_t i = 0; i < asset.buffers.size(); i++)
+    {
+        if (asset.model.buffers[i].uri.starts_with("data:") && asset.model.buffers[i].uri != emptyDataUri)
+        {
+            asset.buffers[i] = asset.model.buffers[i].data;
+        }
+    }
+
+    // tinygltf can't validate views against the empty buffers it was given
+    for (const auto& view : asset.model.bufferViews)
+    {
+        if (view.buffer < 0 || static_cast<size_t>(view.buffer) >= asset.buffers.size() ||
+            view.byteOffset + view.byteLength > asset.buffers[view.buffer].size())
+        {
+            std::println("Buffer view out of range in {}", path);
+            return std::nullopt;
+        }
+    }
+
+    for (const ViewImage& viewImage : viewImages)
+    {
+        const auto& view = asset.model.bufferViews[viewImage.view];
+        asset.images[viewImage.image] = asset.buffers[view.buffer].subspan(view.byteOffset, view.byteLength);
+    }
+
+    return asset;
+}
+
+auto accessorData(const GltfAsset& asset, const tinygltf::Accessor& accessor) -> const u8*
+{
+    const auto& view = asset.model.bufferViews[accessor.bufferView];
+    return asset.buffers[view.buffer].data() + view.byteOffset + accessor.byteOffset;
+}
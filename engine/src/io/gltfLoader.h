@@ -0,0 +1,35 @@
+#pragma once
+
+#include "engine.h"
+#include "io/mappedFile.h"
+
+#include "tiny_gltf.h"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// glTF/GLB asset whose binary payload stays in memory mapped files. tinygltf only parses the JSON: model.buffers
+// are empty and model.images are not decoded, read through buffers/images instead. Image URIs are unique per
+// asset, embedded images get a generated "<path>#image<index>" one.
+struct GltfAsset
+{
+    tinygltf::Model model;
+
+    std::vector<MappedFile> files;
+    // Indexed like model.buffers
+    std::vector<std::span<const u8>> buffers;
+    // Still encoded (PNG, JPEG, ...), indexed like model.images. Empty if the image couldn't be found.
+    std::vector<std::span<const u8>> images;
+    // Backing storage for data URIs, those can't be mapped
+    std::vector<std::vector<u8>> ownedData;
+};
+
+// Handles .gltf with external or data URI buffers and .glb
+[[nodiscard]]
+auto loadGltf(const std::string& path) -> std::optional<GltfAsset>;
+
+// First element of the accessor within its mapped buffer
+[[nodiscard]]
+auto accessorData(const GltfAsset& asset, const tinygltf::Accessor& accessor) -> const u8*;
@@ -0,0 +1,65 @@
+#include "io/mappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <print>
+#include <utility>
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<u8*>(data), size);
+    }
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0))
+{
+}
+
+auto MappedFile::operator=(MappedFile&& other) noexcept -> MappedFile&
+{
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    return *this;
+}
+
+auto mapFile(const std::string& path) -> std::optional<MappedFile>
+{
+    const i32 fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::println("Failed opening {}", path);
+        return std::nullopt;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        std::println("Failed stat'ing {}", path);
+        close(fd);
+        return std::nullopt;
+    }
+
+    const size_t size = static_cast<size_t>(info.st_size);
+    if (size == 0)
+    {
+        close(fd);
+        return MappedFile();
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file referenced
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        std::println("Failed mapping {}", path);
+        return std::nullopt;
+    }
+
+    return MappedFile(static_cast<const u8*>(memory), size);
+}
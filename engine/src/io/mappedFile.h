@@ -0,0 +1,33 @@
+#pragma once
+
+#include "engine.h"
+
+#include <optional>
+#include <span>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are only read in when touched and can be dropped by the OS
+// under memory pressure, so large asset files don't count against the resident set the way a read copy does.
+struct MappedFile
+{
+    const u8* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const u8* data, size_t size) : data(data), size(size) {}
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    auto operator=(MappedFile&& other) noexcept -> MappedFile&;
+    MappedFile(const MappedFile&) = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+    [[nodiscard]]
+    auto bytes() const -> std::span<const u8>
+    {
+        return {data, size};
+    }
+};
+
+[[nodiscard]]
+auto mapFile(const std::string& path) -> std::optional<MappedFile>;
@@ -0,0 +1,149 @@
+#include "io/textureCache.h"
+
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <print>
+
+// Bump whenever the encoder output changes, stale entries are then simply never looked up again
+static constexpr u32 kEncoderVersion = 1;
+static constexpr const char* kCacheDirectory = "textureCache";
+
+static auto cachePath(u64 key) -> std::filesystem::path
+{
+    return std::filesystem::path(kCacheDirectory) / std::format("{:016x}.ktx2", key);
+}
+
+// Tells generated bump maps apart from images imported as they are, outside of TextureKind's range
+static constexpr u64 kGeneratedBumpMap = 0x100;
+
+// XXH64. The key stands in for the image both on disk and when deduplicating a model's images, a collision would
+// show one texture in place of another, so it has to be a well distributed 64-bit hash rather than a quick one.
+static auto contentHash(std::span<const u8> encoded, u64 tag) -> u64
+{
+    constexpr u64 prime1 = 0x9e3779b185ebca87ull;
+    constexpr u64 prime2 = 0xc2b2ae3d27d4eb4full;
+    constexpr u64 prime3 = 0x165667b19e3779f9ull;
+    constexpr u64 prime4 = 0x85ebca77c2b2ae63ull;
+    constexpr u64 prime5 = 0x27d4eb2f165667c5ull;
+
+    auto read64 = [&](size_t offset)
+    {
+        u64 value;
+        std::memcpy(&value, encoded.data() + offset, sizeof(value));
+        return value;
+    };
+    auto read32 = [&](size_t offset)
+    {
+        u32 value;
+        std::memcpy(&value, encoded.data() + offset, sizeof(value));
+        return value;
+    };
+    auto round = [](u64 accumulator, u64 input)
+    {
+        return std::rotl(accumulator + input * prime2, 31) * prime1;
+    };
+    auto mergeRound = [&](u64 hash, u64 accumulator)
+    {
+        return (hash ^ round(0, accumulator)) * prime1 + prime4;
+    };
+
+    const u64 seed = (static_cast<u64>(kEncoderVersion) << 32) ^ tag;
+    const size_t size = encoded.size();
+    size_t offset = 0;
+    u64 hash;
+    if (size >= 32)
+    {
+        u64 accumulators[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+        for (; offset + 32 <= size; offset += 32)
+        {
+            for (u32 lane = 0; lane < 4; lane++)
+            {
+                accumulators[lane] = round(accumulators[lane], read64(offset + lane * sizeof(u64)));
+            }
+        }
+        hash = std::rotl(accumulators[0], 1) + std::rotl(accumulators[1], 7) + std::rotl(accumulators[2], 12) +
+               std::rotl(accumulators[3], 18);
+        for (const u64 accumulator : accumulators)
+        {
+            hash = mergeRound(hash, accumulator);
+        }
+    }
+    else
+    {
+        hash = seed + prime5;
+    }
+    hash += size;
+
+    for (; offset + 8 <= size; offset += 8)
+    {
+        hash = std::rotl(hash ^ round(0, read64(offset)), 27) * prime1 + prime4;
+    }
+    if (offset + 4 <= size)
+    {
+        hash = std::rotl(hash ^ (read32(offset) * prime1), 23) * prime2 + prime3;
+        offset += 4;
+    }
+    for (; offset < size; offset++)
+    {
+        hash = std::rotl(hash ^ (encoded[offset] * prime5), 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+auto textureCacheKey(std::span<const u8> encoded, TextureKind kind) -> u64
+{
+    return contentHash(encoded, static_cast<u64>(kind));
+}
+
+auto bumpMapCacheKey(std::span<const u8> encodedNormalMap) -> u64
+{
+    return contentHash(encodedNormalMap, kGeneratedBumpMap);
+}
+
+auto loadCachedTexture(u64 key) -> std::optional<CachedTexture>
+{
+    const std::filesystem::path path = cachePath(key);
+    if (!std::filesystem::exists(path))
+    {
+        return std::nullopt;
+    }
+
+    auto file = mapFile(path.string());
+    if (!file)
+    {
+        return std::nullopt;
+    }
+    auto image = parseKtx2(file->bytes());
+    if (!image)
+    {
+        std::println("Ignoring malformed texture cache entry {}", path.string());
+        return std::nullopt;
+    }
+    return CachedTexture{.file = std::move(*file), .image = std::move(*image)};
+}
+
+auto storeCachedTexture(u64 key, const CompressedImage& image) -> bool
+{
+    std::error_code error;
+    std::filesystem::create_directories(kCacheDirectory, error);
+
+    // Written next to the entry and renamed, a crash or a concurrent reader never sees half a file
+    const std::filesystem::path path = cachePath(key);
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    if (!writeKtx2(temporaryPath.string(), ktx2Image(image)))
+    {
+        return false;
+    }
+
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "engine.h"
+
+#include "imageProcessing/blockCompression.h"
+#include "io/mappedFile.h"
+#include "rhi/vulkan/utils/ktx2.h"
+
+#include <optional>
+#include <span>
+
+// Block compressed mip chains on disk as KTX2, keyed by the content of the source image. Compressing is only paid
+// the first time an image is seen, afterwards the mapped mips are uploaded as they are.
+
+// Content hash of the encoded (PNG, JPEG...) file together with how it is going to be compressed
+[[nodiscard]]
+auto textureCacheKey(std::span<const u8> encoded, TextureKind kind) -> u64;
+// Key of the bump map integrated from an encoded normal map
+[[nodiscard]]
+auto bumpMapCacheKey(std::span<const u8> encodedNormalMap) -> u64;
+
+// Levels of `image` point into `file`
+struct CachedTexture
+{
+    MappedFile file;
+    Ktx2Image image;
+};
+
+[[nodiscard]]
+auto loadCachedTexture(u64 key) -> std::optional<CachedTexture>;
+auto storeCachedTexture(u64 key, const CompressedImage& image) -> bool;
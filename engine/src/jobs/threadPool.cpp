@@ -0,0 +1,50 @@
+#include "jobs/threadPool.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(u32 threadCount)
+{
+    workers.reserve(threadCount);
+    for (u32 i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back([this]()
+        {
+            while (true)
+            {
+                std::move_only_function<void()> job;
+                {
+                    std::unique_lock lock(mutex);
+                    jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                    if (jobs.empty())
+                    {
+                        return;
+                    }
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+
+                ZoneScopedN("Job");
+                job();
+            }
+        });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    // Queued jobs still run, jthreads join on destruction
+    workers.clear();
+}
+
+auto workerPool() -> ThreadPool&
+{
+    static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    return pool;
+}
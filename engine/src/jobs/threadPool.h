@@ -0,0 +1,53 @@
+#pragma once
+
+#include "engine.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs off a single FIFO queue. Meant for coarse CPU work (asset decoding,
+// pipeline compilation), jobs should not block on each other.
+struct ThreadPool
+{
+    std::vector<std::jthread> workers;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::deque<std::move_only_function<void()>> jobs;
+    bool stopping = false;
+
+    explicit ThreadPool(u32 threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+    template <typename F>
+    [[nodiscard]]
+    auto submit(F&& f) -> std::future<std::invoke_result_t<F>>
+    {
+        std::packaged_task<std::invoke_result_t<F>()> task(std::forward<F>(f));
+        auto future = task.get_future();
+        {
+            std::lock_guard lock(mutex);
+            jobs.emplace_back(std::move(task));
+        }
+        jobAvailable.notify_one();
+        return future;
+    }
+
+    [[nodiscard]]
+    auto threadCount() const -> u32
+    {
+        return static_cast<u32>(workers.size());
+    }
+};
+
+// Shared pool sized to the machine, leaves one core for the main thread. Created on first use.
+auto workerPool() -> ThreadPool&;
@@ -0,0 +1,121 @@
+#include "lightBvh.h"
+
+#include "scene.h"
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <numeric>
+
+// Refit leaves this much larger than freshly sorted ones are worth a new sort
+static constexpr f32 RebuildLeafAreaRatio = 1.5f;
+
+// Spreads the low 10 bits out, two zero bits after each
+static auto expandBits(u32 value) -> u32
+{
+    value = (value * 0x00010001u) & 0xff0000ffu;
+    value = (value * 0x00000101u) & 0x0f00f00fu;
+    value = (value * 0x00000011u) & 0xc30c30c3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+// 30 bit code of a position in [0; 1]^3
+static auto mortonCode(glm::vec3 unitPos) -> u32
+{
+    const glm::uvec3 cell = glm::uvec3(glm::clamp(unitPos * 1024.f, glm::vec3(0.f), glm::vec3(1023.f)));
+    return (expandBits(cell.x) << 2) | (expandBits(cell.y) << 1) | expandBits(cell.z);
+}
+
+static auto surfaceArea(const LightBvhNode& node) -> f32
+{
+    // Empty leaves are inverted
+    const glm::vec3 extent = glm::max(node.aabbMax - node.aabbMin, glm::vec3(0.f));
+    return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+// Returns the summed leaf surface area
+static auto refit(LightBvh& bvh, std::span<const PointLight> lights) -> f32
+{
+    const u32 firstLeaf = bvh.leafCount - 1;
+
+    f32 leafArea = 0.f;
+    for (u32 leaf = 0; leaf < bvh.leafCount; ++leaf)
+    {
+        LightBvhNode& node = bvh.nodes[firstLeaf + leaf];
+        node.aabbMin = glm::vec3(std::numeric_limits<f32>::max());
+        node.aabbMax = glm::vec3(std::numeric_limits<f32>::lowest());
+        for (u32 i = node.firstLight; i < node.firstLight + node.lightCount; ++i)
+        {
+            const PointLight& light = lights[bvh.order[i]];
+            node.aabbMin = glm::min(node.aabbMin, light.pos - light.range);
+            node.aabbMax = glm::max(node.aabbMax, light.pos + light.range);
+        }
+        leafArea += surfaceArea(node);
+    }
+
+    for (u32 node = firstLeaf; node-- > 0;)
+    {
+        const LightBvhNode& left = bvh.nodes[2 * node + 1];
+        const LightBvhNode& right = bvh.nodes[2 * node + 2];
+        bvh.nodes[node].aabbMin = glm::min(left.aabbMin, right.aabbMin);
+        bvh.nodes[node].aabbMax = glm::max(left.aabbMax, right.aabbMax);
+    }
+
+    return leafArea;
+}
+
+auto buildLightBvh(LightBvh& bvh, std::span<const PointLight> lights) -> void
+{
+    ZoneScoped;
+
+    glm::vec3 boundsMin = glm::vec3(std::numeric_limits<f32>::max());
+    glm::vec3 boundsMax = glm::vec3(std::numeric_limits<f32>::lowest());
+    for (const PointLight& light : lights)
+    {
+        boundsMin = glm::min(boundsMin, light.pos);
+        boundsMax = glm::max(boundsMax, light.pos);
+    }
+    const glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+
+    std::vector<u32> codes(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        codes[i] = mortonCode((lights[i].pos - boundsMin) / extent);
+    }
+    bvh.order.resize(lights.size());
+    std::iota(bvh.order.begin(), bvh.order.end(), 0);
+    std::ranges::sort(bvh.order, {}, [&](u32 light) { return codes[light]; });
+
+    const u32 lightCount = static_cast<u32>(lights.size());
+    bvh.leafCount = std::bit_ceil(std::max(1u, (lightCount + LightBvh::LightsPerLeaf - 1) / LightBvh::LightsPerLeaf));
+    bvh.nodes.assign(2 * bvh.leafCount - 1, LightBvhNode{});
+
+    const u32 firstLeaf = bvh.leafCount - 1;
+    for (u32 leaf = 0; leaf < bvh.leafCount; ++leaf)
+    {
+        LightBvhNode& node = bvh.nodes[firstLeaf + leaf];
+        node.firstLight = std::min(leaf * LightBvh::LightsPerLeaf, lightCount);
+        node.lightCount = std::min(LightBvh::LightsPerLeaf, lightCount - node.firstLight);
+    }
+
+    bvh.builtLeafArea = refit(bvh, lights);
+    bvh.rebuilds++;
+}
+
+auto updateLightBvh(LightBvh& bvh, std::span<const PointLight> lights) -> void
+{
+    ZoneScoped;
+
+    if (bvh.order.size() != lights.size())
+    {
+        buildLightBvh(bvh, lights);
+        return;
+    }
+
+    if (refit(bvh, lights) > bvh.builtLeafArea * RebuildLeafAreaRatio)
+    {
+        buildLightBvh(bvh, lights);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "engine.h"
+
+#include <glm/glm.hpp>
+
+#include <span>
+#include <vector>
+
+struct PointLight;
+
+// Matches LightBvhNode in lights.glsl
+struct LightBvhNode
+{
+    glm::vec3 aabbMin;
+    u32 firstLight;
+    glm::vec3 aabbMax;
+    // 0 for inner nodes
+    u32 lightCount;
+};
+
+// Bounds of the lights' spheres of influence. The lights are sorted along a Morton curve and cut into leaves of
+// consecutive runs of them, the tree above is a complete binary tree stored implicitly: children of node i are
+// 2i + 1 and 2i + 2, the leaves come last. The GPU walks it without a stack.
+//
+// Moving lights only refit the bounds. The sort is redone once refitting made the leaves too loose or the light
+// count changed.
+struct LightBvh
+{
+    // Matches the culling shader's workgroup size, a leaf is tested in one go
+    static constexpr u32 LightsPerLeaf = 128;
+
+    // Light order the tree was built for, the lights are uploaded in this order
+    std::vector<u32> order;
+    std::vector<LightBvhNode> nodes;
+    u32 leafCount = 0;
+
+    // Summed leaf surface area right after the last sort
+    f32 builtLeafArea = 0.f;
+    u32 rebuilds = 0;
+};
+
+auto buildLightBvh(LightBvh& bvh, std::span<const PointLight> lights) -> void;
+auto updateLightBvh(LightBvh& bvh, std::span<const PointLight> lights) -> void;
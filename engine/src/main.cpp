@@ -1,119 +1,163 @@
 #define GLFW_INCLUDE_VULKAN
-#include "passes/atmosphere.h"
-#include "passes/culling.h"
-#include "passes/forward.h"
-#include "passes/lightCulling.h"
-#include "passes/shadows.h"
-#include "passes/zPrePass.h"
-#include "passes/blur.h"
-#include "passes/bloom.h"
-#include "passes/screenSpace.h"
-#include "renderGraph.h"
+#include "cameraPath.h"
+#include "debugUI.h"
+#include "headless.h"
 #include "rhi/vulkan/backend.h"
 #include "scene.h"
-#include "debugUI.h"
+#include "worldRenderer.h"
 
-#define TINYGLTF_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-
-#include "tiny_gltf.h"
-#include "GLFW/glfw3.h"
+#include "stb_image_write.h"
 
 #define IMGUI_DEFINE_MATH_OPERATORS
+#include <algorithm>
 #include <chrono>
-#include <optional>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "imgui.h"
-#include "imgui_impl_glfw.h"
-#include "imgui_impl_vulkan.h"
 
-struct WorldRenderer
+struct HeadlessOptions
 {
-    VulkanBackend& backend;
-
-    std::optional<CompiledRenderGraph> compiledRenderGraph;
-
-    std::optional<GeometryCulling> culling;
-    std::optional<ZPrePassRenderer> prePass;
-    std::optional<ShadowRenderer> shadows;
-    std::optional<ForwardOpaqueRenderer> opaque;
-    std::optional<LightCulling> lightCulling;
+    u32 frameCount = 1000;
+    // Keyframe file, see loadCameraPath(). Sponza fly-through when empty.
+    std::string cameraPath;
+    // Per-frame CPU/GPU times as CSV, nothing written when empty
+    std::string timingsPath;
+    // Last frame as a PNG, nothing written when empty
+    std::string screenshotPath;
+};
 
-    // Postpro fx
-    std::optional<AtmosphereRenderer> atmosphere;
+static auto runHeadless(VulkanBackend& backend, Scene& scene, const HeadlessOptions& options) -> i32
+{
+    CameraPath cameraPath = sponzaFlythrough();
+    if (!options.cameraPath.empty())
+    {
+        auto loaded = loadCameraPath(options.cameraPath);
+        if (!loaded)
+        {
+            return 1;
+        }
+        cameraPath = std::move(*loaded);
+    }
 
-    std::optional<ScreenSpaceRenderer> ss;
-    std::optional<BlurRenderer> blur;
-    std::optional<BloomRenderer> bloom;
+    WorldRenderer worldRenderer(backend);
 
-    explicit WorldRenderer(VulkanBackend& backend) : backend(backend) {}
+    std::vector<HeadlessFrame> timings;
+    timings.reserve(options.frameCount);
+    renderCameraPath(worldRenderer, scene, cameraPath, options.frameCount, [&](const HeadlessFrame& frame)
+    {
+        timings.push_back(frame);
+    });
 
-    void compileRenderGraph(Scene& scene)
+    f64 totalCpuMs = 0.0;
+    f64 maxCpuMs = 0.0;
+    for (const auto& timing : timings)
     {
-        // NOTE: Instead of the usual per-frame recompilation of render graph,
-        // it's enough to make it once and reuse the cached compiled render
-        // graph. Once we get into more complicated rendering we can start
-        // thinking about recompiling it every frame.
-        RenderGraph graph = {
-            .backend = backend
-        };
-
-        // const auto [draws, lightList] = sceneUploadPass(sceneDataUploader, backend, graph);
-        const auto [culledDraws] = cpuFrustumCullingPass(culling, backend, graph);
-        const auto [depthMap] = zPrePass(prePass, backend, graph, culledDraws);
-        const auto [shadowMap, cascadeData] = csmPass(shadows, backend, graph, 4);
-        auto lightData = tiledLightCullingPass(lightCulling, backend, graph, scene, depthMap,
-            1.f / 20.f);
-        // auto [lightList, culledLightData] = clusteredLightCullingPass(lightCulling, backend, graph);
-        // auto [pointLightShadowAtlas] = pointLightShadowPass(pointLightShadows, backend, graph, lightList, lightIndexList, lightGrid);
-        auto [colorOutput, normal, positions, reflections] = opaqueForwardPass(opaque, backend, graph, culledDraws, depthMap, cascadeData, shadowMap, lightData);
-        auto output = ssrPass(ss, blur, backend, graph, colorOutput, normal, positions, reflections);
-        output = atmospherePass(atmosphere, backend, graph, depthMap, output);
-
-        auto _ = bloomPass(bloom, blur, backend, graph, output);
-        //output = reinhardTonemapPass(tonemapper, backend, graph, output);
-        //smaaPass(antiAliaser, backend, graph, output);
-
-        compiledRenderGraph = compile(backend, std::move(graph));
+        totalCpuMs += timing.cpuMs;
+        maxCpuMs = std::max(maxCpuMs, timing.cpuMs);
     }
+    std::println("Rendered {} frames, CPU avg {:.3f} ms, max {:.3f} ms", timings.size(),
+        totalCpuMs / std::max<size_t>(timings.size(), 1), maxCpuMs);
 
-    void render(Frame& frame, Scene& scene, f64 dt)
+    if (!options.timingsPath.empty())
     {
-        glfwPollEvents();
-
-        ImGui_ImplVulkan_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        ImGui::SetNextWindowBgAlpha(0.0f);
-        ImGui::DockSpaceOverViewport(0, nullptr, ImGuiDockNodeFlags_PassthruCentralNode);
+        std::ofstream file(options.timingsPath);
+        if (!file)
+        {
+            std::println("Failed opening {}", options.timingsPath);
+            return 1;
+        }
+        file << "frame,cpu_ms,gpu_ms\n";
+        for (const auto& timing : timings)
+        {
+            file << std::format("{},{:.4f},{:.4f}\n", timing.index, timing.cpuMs, timing.gpuMs);
+        }
+    }
 
-        scene.update(dt, 0.f, backend.window);
+    if (!options.screenshotPath.empty())
+    {
+        const auto pixels = backend.readBackbuffer();
+        const i32 width = static_cast<i32>(backend.backbufferImage.extent.width);
+        const i32 height = static_cast<i32>(backend.backbufferImage.extent.height);
+        if (!stbi_write_png(options.screenshotPath.c_str(), width, height, 4, pixels.data(), width * 4))
+        {
+            std::println("Failed writing {}", options.screenshotPath);
+            return 1;
+        }
+    }
 
-        drawDebugUI(debugUI, backend, scene, dt);
-        debugUI.fns.clear();
+    return 0;
+}
 
-        // NOTE: for now let's just directly pass in the graph and let the
-        // backend figure out what it wants to do. Generally we should transform
-        // compiledRenderGraph into a command buffer or a list of secondary
-        // command buffers. I.e.: cmds = backend.recordCommandBuffers(compiledRenderGraph); backend.submit(cmds);
-        if (compiledRenderGraph)
+i32 main(i32 argc, char** argv)
+{
+    // --headless [--frames N] [--camera-path path.txt] [--timings out.csv] [--screenshot out.png]
+    // [--width W] [--height H] [--texture-budget-mb MB]
+    BackendConfig config;
+    HeadlessOptions headlessOptions;
+    for (i32 i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--headless")
+        {
+            config.headless = true;
+        }
+        else if (arg == "--frames" && hasValue)
+        {
+            headlessOptions.frameCount = std::stoul(argv[++i]);
+        }
+        else if (arg == "--camera-path" && hasValue)
+        {
+            headlessOptions.cameraPath = argv[++i];
+        }
+        else if (arg == "--timings" && hasValue)
+        {
+            headlessOptions.timingsPath = argv[++i];
+        }
+        else if (arg == "--screenshot" && hasValue)
+        {
+            headlessOptions.screenshotPath = argv[++i];
+        }
+        else if (arg == "--width" && hasValue)
+        {
+            config.width = std::stoul(argv[++i]);
+        }
+        else if (arg == "--height" && hasValue)
         {
-            backend.render(frame, *compiledRenderGraph, scene);
+            config.height = std::stoul(argv[++i]);
+        }
+        else if (arg == "--texture-budget-mb" && hasValue)
+        {
+            config.textureBudgetBytes = std::stoull(argv[++i]) * 1024 * 1024;
+        }
+        else
+        {
+            std::println("Unknown argument {}", arg);
+            return 1;
         }
     }
-};
 
-i32 main()
-{
-    VulkanBackend* backend = initVulkanBackend().expect("Failed initialising Vulkan backend");
+    VulkanBackend* backend = initVulkanBackend(config).expect("Failed initialising Vulkan backend");
 
     Scene scene = loadScene(*backend, "Sponza", "../assets/Sponza/Sponza.gltf", 4096 - 1)
         .value_or(emptyScene(*backend));
 
+    if (config.headless)
+    {
+        const i32 result = runHeadless(*backend, scene, headlessOptions);
+        backend->deinit();
+        return result;
+    }
+
     WorldRenderer worldRenderer(*backend);
-    worldRenderer.compileRenderGraph(scene);
+
+    CameraPath recordedPath;
+    char recordedPathFile[256] = "camera.path";
 
     FrameStats lastFrameStats = backend->endFrame(backend->newFrame());
     while (!lastFrameStats.shutdownRequested)
@@ -122,6 +166,30 @@ i32 main()
         std::chrono::duration<f64> elapsed = frame.stats.startTime - lastFrameStats.startTime;
         frame.stats.pastFrameDt = elapsed.count();
 
+        // Benchmark paths are recorded by flying around, see renderCameraPath()
+        addDebugUI(debugUI, frame.ctx.get().frameArena, SCENE, [&]()
+        {
+            if (ImGui::TreeNode("Camera path"))
+            {
+                if (ImGui::Button("Add keyframe"))
+                {
+                    recordedPath.keyframes.push_back(keyframeFromCamera(*scene.activeCamera));
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Clear"))
+                {
+                    recordedPath.keyframes.clear();
+                }
+                ImGui::InputText("File", recordedPathFile, sizeof(recordedPathFile));
+                if (ImGui::Button("Save"))
+                {
+                    saveCameraPath(recordedPath, recordedPathFile);
+                }
+                ImGui::Text("Keyframes: %zu", recordedPath.keyframes.size());
+                ImGui::TreePop();
+            }
+        });
+
         worldRenderer.render(frame, scene, elapsed.count());
 
         lastFrameStats = backend->endFrame(std::move(frame));
@@ -0,0 +1,77 @@
+#include "memory/allocationCounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions, everything else in the program (std containers, ImGui, tinygltf, etc.)
+// ends up here. Only the counter is added on top of plain malloc/free.
+
+static std::atomic<u64> allocationCount = 0;
+
+auto heapAllocationCount() -> u64
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+static auto countedAllocate(size_t size) -> void*
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+static auto countedAllocateAligned(size_t size, std::align_val_t alignment) -> void*
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    const size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) & ~(align - 1));
+}
+
+void* operator new(size_t size)
+{
+    if (void* memory = countedAllocate(size))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return ::operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (void* memory = countedAllocateAligned(size, alignment))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return ::operator new(size, alignment);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
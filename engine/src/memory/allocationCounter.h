@@ -0,0 +1,8 @@
+#pragma once
+
+#include "engine.h"
+
+// Number of global operator new calls since startup. Meant for spotting per-frame heap churn, see
+// VulkanBackend::endFrame().
+[[nodiscard]]
+auto heapAllocationCount() -> u64;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "memory/linearArena.h"
+
+#include <cstddef>
+#include <vector>
+
+// std compatible allocator handing out LinearArena memory. deallocate() is a no-op, memory comes back when the arena
+// is reset, so containers using it must not outlive the arena's reset. Unlike LinearArena::create() element
+// destructors do run, the container takes care of that.
+template <typename T>
+struct ArenaAllocator
+{
+    using value_type = T;
+
+    LinearArena* arena;
+
+    explicit ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena)
+    {
+    }
+
+    [[nodiscard]]
+    auto allocate(size_t count) -> T*
+    {
+        return static_cast<T*>(arena->allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    auto deallocate(T*, size_t) -> void {}
+
+    template <typename U>
+    auto operator==(const ArenaAllocator<U>& other) const -> bool
+    {
+        return arena == other.arena;
+    }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
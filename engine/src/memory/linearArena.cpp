@@ -0,0 +1,59 @@
+#include "memory/linearArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+auto LinearArena::allocate(size_t size, size_t alignment) -> void*
+{
+    while (true)
+    {
+        for (; currentBlock < blocks.size(); currentBlock++, offset = 0)
+        {
+            auto& block = blocks[currentBlock];
+            const auto base = reinterpret_cast<uintptr_t>(block.memory.get());
+            const auto aligned = (base + offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+            const size_t alignedOffset = aligned - base;
+            if (alignedOffset + size <= block.size)
+            {
+                offset = alignedOffset + size;
+                bytesAllocated += size;
+                return block.memory.get() + alignedOffset;
+            }
+        }
+
+        const size_t blockSize = std::max(defaultBlockSize, size + alignment);
+        blocks.push_back({
+            .memory = std::make_unique_for_overwrite<std::byte[]>(blockSize),
+            .size = blockSize
+        });
+        currentBlock = blocks.size() - 1;
+        offset = 0;
+    }
+}
+
+auto LinearArena::reset() -> void
+{
+    if (blocks.size() > 1)
+    {
+        const size_t totalSize = capacity();
+        blocks.clear();
+        blocks.push_back({
+            .memory = std::make_unique_for_overwrite<std::byte[]>(totalSize),
+            .size = totalSize
+        });
+    }
+
+    currentBlock = 0;
+    offset = 0;
+    bytesAllocated = 0;
+}
+
+auto LinearArena::capacity() const -> size_t
+{
+    size_t totalSize = 0;
+    for (const auto& block : blocks)
+    {
+        totalSize += block.size;
+    }
+    return totalSize;
+}
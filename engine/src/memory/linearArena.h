@@ -0,0 +1,57 @@
+#pragma once
+
+#include "engine.h"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for short-lived data. Nothing is freed individually, reset() releases everything at once and
+// destructors are never run, so only trivially destructible types can be placed in it.
+//
+// Memory comes in blocks so pointers stay valid while the arena grows. On reset() the blocks get merged into
+// one, meaning that a workload which allocates roughly the same amount every time stops allocating altogether
+// after the first couple of resets.
+struct LinearArena
+{
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> memory;
+        size_t size;
+    };
+
+    size_t defaultBlockSize = 64 * 1024;
+
+    std::vector<Block> blocks;
+    size_t currentBlock = 0;
+    size_t offset = 0;
+
+    // Since last reset
+    size_t bytesAllocated = 0;
+
+    [[nodiscard]]
+    auto allocate(size_t size, size_t alignment = alignof(std::max_align_t)) -> void*;
+    auto reset() -> void;
+
+    [[nodiscard]]
+    auto capacity() const -> size_t;
+
+    template <typename T, typename... Args>
+    [[nodiscard]]
+    auto create(Args&&... args) -> T*
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "LinearArena never runs destructors");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    [[nodiscard]]
+    auto allocateArray(size_t count) -> T*
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "LinearArena never runs destructors");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+};
@@ -0,0 +1,46 @@
+#include "mesh.h"
+
+#include <algorithm>
+
+auto copyVertexAttribute(std::vector<Vertex>& vertices, i32 vertexOffset, i32 attributeOffset, const f32* data,
+    i32 count, i32 componentCount) -> void
+{
+    for (i32 i = 0; i < count; i++)
+    {
+        i32 vertexIndex = vertexOffset + i;
+        if (vertices.size() <= vertexIndex)
+        {
+            vertices.emplace_back();
+        }
+        Vertex& vertex = vertices[vertexIndex];
+
+        for (i32 j = 0; j < componentCount; j++)
+        {
+            vertex.raw[attributeOffset + j] = data[i * componentCount + j];
+        }
+    }
+}
+
+auto expandVertexBounds(const std::vector<Vertex>& vertices, i32 vertexOffset, i32 count, glm::vec3& aabbMin,
+    glm::vec3& aabbMax) -> void
+{
+    for (i32 i = vertexOffset; i < vertexOffset + count; i++)
+    {
+        const Vertex& vertex = vertices[i];
+        aabbMin.x = std::min(aabbMin.x, vertex.pos[0]);
+        aabbMin.y = std::min(aabbMin.y, vertex.pos[1]);
+        aabbMin.z = std::min(aabbMin.z, vertex.pos[2]);
+
+        aabbMax.x = std::max(aabbMax.x, vertex.pos[0]);
+        aabbMax.y = std::max(aabbMax.y, vertex.pos[1]);
+        aabbMax.z = std::max(aabbMax.z, vertex.pos[2]);
+    }
+}
+
+auto appendIndices(std::vector<u32>& indices, const u16* data, size_t count, i32 vertexOffset) -> void
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        indices.push_back(data[i] + vertexOffset);
+    }
+}
@@ -3,7 +3,10 @@
 #include "engine.h"
 
 #include <glm/glm.hpp>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 struct Vertex
 {
@@ -51,3 +54,50 @@ struct Mesh
     i16 normalTexture;
     i16 bumpTexture;
 };
+
+// Per instance data read by the shaders, indexed by firstInstance
+struct ModelData
+{
+    glm::vec4 textures;
+    glm::vec4 selected;
+    glm::vec4 metallicRoughnessFactors;
+    glm::mat4 model;
+};
+
+// Per frame callers pass a frame arena allocator, see FrameCtx::frameArena
+template <typename Allocator = std::allocator<ModelData>>
+[[nodiscard]]
+auto gatherModelData(const std::unordered_map<std::string, Mesh>& meshes, u32 instanceCount,
+    const Allocator& allocator = Allocator()) -> std::vector<ModelData, Allocator>
+{
+    std::vector<ModelData, Allocator> modelData(allocator);
+    modelData.reserve(instanceCount);
+    for (auto& mesh : meshes)
+    {
+        for (auto& instance : mesh.second.instances)
+        {
+            modelData.push_back({
+                .textures = glm::vec4(
+                    mesh.second.albedoTexture,
+                    mesh.second.normalTexture,
+                    mesh.second.bumpTexture,
+                    mesh.second.metallicRoughnessTexture
+                ),
+                .selected = glm::vec4(instance.selected ? 1.f : 0.f),
+                .metallicRoughnessFactors = instance.metallicRoughnessFactors,
+                .model = instance.modelTransform,
+            });
+        }
+    }
+
+    return modelData;
+}
+
+// Copies a tightly packed f32 attribute into vertices[vertexOffset...] starting at attributeOffset floats into
+// each Vertex, growing the vertex array as needed
+auto copyVertexAttribute(std::vector<Vertex>& vertices, i32 vertexOffset, i32 attributeOffset, const f32* data,
+    i32 count, i32 componentCount) -> void;
+auto expandVertexBounds(const std::vector<Vertex>& vertices, i32 vertexOffset, i32 count, glm::vec3& aabbMin,
+    glm::vec3& aabbMax) -> void;
+// Rebases 16-bit mesh local indices onto the shared vertex array
+auto appendIndices(std::vector<u32>& indices, const u16* data, size_t count, i32 vertexOffset) -> void;
@@ -36,9 +36,6 @@ auto initAtmosphere(VulkanBackend& backend) -> AtmosphereRenderer
 {
     return AtmosphereRenderer{
         .pipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-            })
             .addPushConstants({
                 VkPushConstantRange{
                     .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
@@ -79,12 +76,11 @@ auto atmospherePass(std::optional<AtmosphereRenderer>& atmosphere, VulkanBackend
     pass.pass.debugName = "Atmosphere pass";
     pass.pass.pipeline = atmosphere->pipeline;
 
-    depthMap = readResource<BindlessTexture>(graph, pass, depthMap, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
-    const auto output = writeResource<BindlessTexture>(graph, pass,
-        readResource<BindlessTexture>(graph, pass, input, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    depthMap = readResource<BindlessTexture>(graph, pass, depthMap, ResourceUsage::DepthAttachmentRead);
+    // Blended on top of the input, the attachment read is part of the write
+    const auto output = writeResource<BindlessTexture>(graph, pass, input, ResourceUsage::ColorAttachmentWrite);
 
-    pass.pass.beginRendering = [output, depthMap, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
+    setBeginRendering(graph, pass, [output, depthMap, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
     {
         VkExtent2D swapchainSize = {
             static_cast<u32>(backend.viewport.width),
@@ -101,9 +97,9 @@ auto atmospherePass(std::optional<AtmosphereRenderer>& atmosphere, VulkanBackend
         const auto renderingInfo = vkutil::init::renderingInfo(swapchainSize, &colorAttachmentInfo, 1,
             &depthAttachmentInfo);
         vkCmdBeginRendering(cmd, &renderingInfo);
-    };
+    });
 
-    pass.pass.draw = [](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
+    setDraw(graph, pass, [&backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
     {
         static f32 time = 0.35f;
         static bool moveSun = false;
@@ -123,7 +119,8 @@ auto atmospherePass(std::optional<AtmosphereRenderer>& atmosphere, VulkanBackend
         static f32 scatteringScale = 1.f;
         static bool scalesLocked = true;
 
-        addDebugUI(debugUI, GRAPHICS_PASSES, [&]()
+        // Drawn next frame, after this callback returned. The coefficients are copied, everything else is static.
+        addDebugUI(debugUI, backend.currentFrame().frameArena, GRAPHICS_PASSES, [&, rayleighCoeffs, mieCoeff]()
         {
             if (ImGui::TreeNode("Atmosphere"))
             {
@@ -178,7 +175,8 @@ auto atmospherePass(std::optional<AtmosphereRenderer>& atmosphere, VulkanBackend
             &pushConstants);
 
         vkCmdDraw(cmd, 3, 1, 0, 0);
-    };
+        pass.drawCalls++;
+    });
 
     return output;
 }
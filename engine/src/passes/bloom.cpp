@@ -17,10 +17,6 @@ auto initBloom(VulkanBackend& backend) -> BloomRenderer
 {
     return BloomRenderer{
         .pipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-                backend.bindlessResources->bindlessTexDescLayout
-            })
             .addPushConstants({
                 VkPushConstantRange {
                     .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
@@ -62,13 +58,13 @@ auto bloomPass(std::optional<BloomRenderer>& bloom, std::optional<BlurRenderer>&
     }
 
     auto& pass = createPass(graph);
-    pass.pass.debugName = std::format("Bloom pass");
+    pass.pass.debugName = "Bloom pass";
     pass.pass.pipeline = bloom->pipeline;
 
-    input = readResource<BindlessTexture>(graph, pass, input, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    blurredInput = readResource<BindlessTexture>(graph, pass, blurredInput, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    input = readResource<BindlessTexture>(graph, pass, input, ResourceUsage::SampledRead);
+    blurredInput = readResource<BindlessTexture>(graph, pass, blurredInput, ResourceUsage::SampledRead);
 
-    pass.pass.beginRendering = [&backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
+    setBeginRendering(graph, pass, [&backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
     {
         VkExtent2D swapchainSize = {
             static_cast<u32>(backend.viewport.width),
@@ -81,14 +77,14 @@ auto bloomPass(std::optional<BloomRenderer>& bloom, std::optional<BlurRenderer>&
             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
         const auto renderingInfo = vkutil::init::renderingInfo(swapchainSize, &colorAttachmentInfo, 1, nullptr);
         vkCmdBeginRendering(cmd, &renderingInfo);
-    };
+    });
 
-    pass.pass.draw = [input, blurredInput, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
+    setDraw(graph, pass, [input, blurredInput, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
     {
         ZoneScopedCpuGpuAuto("Bloom pass", backend.currentFrame());
 
         static float bloomIntensity = 0.04f;
-        addDebugUI(debugUI, GRAPHICS_PASSES, [&]()
+        addDebugUI(debugUI, backend.currentFrame().frameArena, GRAPHICS_PASSES, [&]()
         {
             if (ImGui::TreeNode("Bloom"))
             {
@@ -111,8 +107,9 @@ auto bloomPass(std::optional<BloomRenderer>& bloom, std::optional<BlurRenderer>&
         vkCmdBindDescriptorSets(cmd, pass.pipeline->pipelineBindPoint, pass.pipeline->pipelineLayout, 1, 1,
             &backend.bindlessResources->bindlessTexDesc, 0, nullptr);
         vkCmdDraw(cmd, 3, 1, 0, 0);
-    };
+        pass.drawCalls++;
+    });
 
     // TEMP: replace with actual resource
-    return 0;
+    return {};
 }
@@ -54,10 +54,6 @@ auto initDualKawase(VulkanBackend& backend, RenderGraph& graph) -> BlurRenderer
 
     return BlurRenderer{
         .dualKawaseDownPipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-                backend.bindlessResources->bindlessTexDescLayout
-            })
             .addPushConstants({
                 VkPushConstantRange {
                     .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
@@ -82,10 +78,6 @@ auto initDualKawase(VulkanBackend& backend, RenderGraph& graph) -> BlurRenderer
             .disableDepthTest()
             .build(),
         .dualKawaseUpPipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-                backend.bindlessResources->bindlessTexDescLayout
-            })
             .addPushConstants({
                 VkPushConstantRange {
                     .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
@@ -122,29 +114,27 @@ auto initDualKawase(VulkanBackend& backend, RenderGraph& graph) -> BlurRenderer
 
 [[nodiscard]]
 auto kawasePass(Pipeline& kawasePipeline, VulkanBackend& backend, RenderGraph& graph, f32 positionOffsetMultiplier,
-    f32 colorMultiplier, RenderGraphResource<BindlessTexture> input, BindlessTexture output)
+    f32 colorMultiplier, RenderGraphResource<BindlessTexture> input, BindlessTexture* output)
     -> RenderGraphResource<BindlessTexture>
 {
     auto& pass = createPass(graph);
-    pass.pass.debugName = std::format("Dual Kawase Blur pass");
+    pass.pass.debugName = "Dual Kawase Blur pass";
     pass.pass.pipeline = kawasePipeline;
 
-    input = readResource<BindlessTexture>(graph, pass, input, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    BindlessTexture* hackToNotLooseResource = new BindlessTexture(output);
-    auto outputResource = writeResource<BindlessTexture>(graph, pass, importResource(graph, pass,
-        hackToNotLooseResource),
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    input = readResource<BindlessTexture>(graph, pass, input, ResourceUsage::SampledRead);
+    auto outputResource = writeResource<BindlessTexture>(graph, pass, importResource(graph, pass, output),
+        ResourceUsage::ColorAttachmentWrite);
 
-    pass.pass.beginRendering = [outputResource, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
+    setBeginRendering(graph, pass, [outputResource, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
     {
         const auto& outputTexture = backend.bindlessResources->getTexture(*getResource<BindlessTexture>(graph, outputResource));
         auto colorAttachmentInfo = vkutil::init::renderingColorAttachmentInfo(outputTexture.view, nullptr,
             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
         auto renderingInfo = vkutil::init::renderingInfo(outputTexture.image.extent, &colorAttachmentInfo, 1, nullptr);
         vkCmdBeginRendering(cmd, &renderingInfo);
-    };
+    });
 
-    pass.pass.draw = [input, outputResource, positionOffsetMultiplier, colorMultiplier, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
+    setDraw(graph, pass, [input, outputResource, positionOffsetMultiplier, colorMultiplier, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
     {
         ZoneScopedCpuGpuAuto("Dual Kawase Blur pass", backend.currentFrame());
         const auto bindlessInputTexture = *getResource<BindlessTexture>(graph, input);
@@ -182,7 +172,8 @@ auto kawasePass(Pipeline& kawasePipeline, VulkanBackend& backend, RenderGraph& g
         vkCmdBindDescriptorSets(cmd, pass.pipeline->pipelineBindPoint, pass.pipeline->pipelineLayout, 1, 1,
             &backend.bindlessResources->bindlessTexDesc, 0, nullptr);
         vkCmdDraw(cmd, 3, 1, 0, 0);
-    };
+        pass.drawCalls++;
+    });
 
     return outputResource;
 }
@@ -199,20 +190,18 @@ auto dualKawaseBlur(std::optional<BlurRenderer>& blur, VulkanBackend& backend, R
 
     for (i8 i = 0; i < downsampleCount; i++)
     {
-        const auto outputTexture = blur->intermediateTextures[i];
         input = kawasePass(blur->dualKawaseDownPipeline, backend, graph, positionOffsetMultiplier, colorMultiplier,
-            input, outputTexture);
+            input, &blur->intermediateTextures[i]);
     }
 
     for (i8 i = downsampleCount - 2; i > 0; i--)
     {
-        const auto outputTexture = blur->intermediateTextures[i];
         input = kawasePass(blur->dualKawaseUpPipeline, backend, graph, positionOffsetMultiplier, colorMultiplier,
-            input, outputTexture);
+            input, &blur->intermediateTextures[i]);
     }
 
     const auto output = kawasePass(blur->dualKawaseUpPipeline, backend, graph,
-        positionOffsetMultiplier, colorMultiplier, input, blur->output);
+        positionOffsetMultiplier, colorMultiplier, input, &blur->output);
 
     return output;
 }
\ No newline at end of file
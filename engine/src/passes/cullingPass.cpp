@@ -2,6 +2,8 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include "frustum.h"
+#include "memory/arenaAllocator.h"
 #include "passes/culling.h"
 #include "rhi/renderpass.h"
 #include "rhi/vulkan/backend.h"
@@ -9,29 +11,6 @@
 #include "rhi/vulkan/utils/inits.h"
 #include "scene.h"
 
-auto insideCameraFrustum(const glm::vec3 aabbMin, const glm::vec3 aabbMax,
-    const std::array<glm::vec4, 6>& frustumPlanes)
-    -> bool
-{
-    for (u8 i = 0; i < 6; ++i)
-    {
-        const glm::vec4& plane = frustumPlanes[i];
-        if ((glm::dot(plane, glm::vec4(aabbMin.x, aabbMin.y, aabbMin.z, 1.0f)) < 0.0) &&
-            (glm::dot(plane, glm::vec4(aabbMax.x, aabbMin.y, aabbMin.z, 1.0f)) < 0.0) &&
-            (glm::dot(plane, glm::vec4(aabbMin.x, aabbMax.y, aabbMin.z, 1.0f)) < 0.0) &&
-            (glm::dot(plane, glm::vec4(aabbMax.x, aabbMax.y, aabbMin.z, 1.0f)) < 0.0) &&
-            (glm::dot(plane, glm::vec4(aabbMin.x, aabbMin.y, aabbMax.z, 1.0f)) < 0.0) &&
-            (glm::dot(plane, glm::vec4(aabbMax.x, aabbMin.y, aabbMax.z, 1.0f)) < 0.0) &&
-            (glm::dot(plane, glm::vec4(aabbMin.x, aabbMax.y, aabbMax.z, 1.0f)) < 0.0) &&
-            (glm::dot(plane, glm::vec4(aabbMax.x, aabbMax.y, aabbMax.z, 1.0f)) < 0.0))
-        {
-            return false;
-        }
-    }
-
-    return true;
-}
-
 auto initCulling(VulkanBackend& backend) -> GeometryCulling
 {
     // FIXME: we should not be hardcoding the mesh count
@@ -56,9 +35,11 @@ auto cpuFrustumCullingPass(std::optional<GeometryCulling>& geometryCulling, Vulk
     pass.pass.debugName = "CPU frustum culling pass";
 
     CullingPassRenderGraphData data = {};
-    data.culledDraws = importResource<Buffer>(graph, pass, &geometryCulling->culledDraws.buffer);
+    // Uploaded with a staging copy
+    data.culledDraws = writeResource<Buffer>(graph, pass,
+        importResource<Buffer>(graph, pass, &geometryCulling->culledDraws.buffer), ResourceUsage::TransferWrite);
 
-    pass.pass.draw = [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass&, Scene& scene)
+    setDraw(graph, pass, [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass&, Scene& scene)
     {
         ZoneScopedN("CPU Frustum culling");
         {
@@ -68,24 +49,16 @@ auto cpuFrustumCullingPass(std::optional<GeometryCulling>& geometryCulling, Vulk
             const auto projection = glm::perspectiveFov<f32>(scene.mainCamera.verticalFov,
                 backend.backbufferImage.extent.width, backend.backbufferImage.extent.height,
                 scene.mainCamera.nearClippingPlaneDist, scene.mainCamera.farClippingPlaneDist);
-            const auto viewProj = projection * view;
-            const auto viewProjTranspose = glm::transpose(viewProj);
-            const std::array frustumPlanes = {
-                (viewProjTranspose[3] + viewProjTranspose[0]),
-                (viewProjTranspose[3] - viewProjTranspose[0]),
-                (viewProjTranspose[3] + viewProjTranspose[1]),
-                (viewProjTranspose[3] - viewProjTranspose[1]),
-                (viewProjTranspose[3] + viewProjTranspose[2]),
-                (viewProjTranspose[3] - viewProjTranspose[2]),
-            };
+            const auto frustum = frustumPlanes(projection * view);
 
-            std::vector<VkDrawIndexedIndirectCommand> indirectCmds;
+            ArenaVector<VkDrawIndexedIndirectCommand> indirectCmds(
+                ArenaAllocator<VkDrawIndexedIndirectCommand>(backend.currentFrame().frameArena));
             indirectCmds.reserve(scene.meshCount);
             for (auto& mesh : scene.meshes)
             {
                 for (auto& instance : mesh.second.instances)
                 {
-                    const u32 instanceCount = insideCameraFrustum(instance.aabbMin, instance.aabbMax, frustumPlanes) ? 1 : 0;
+                    const u32 instanceCount = insideCameraFrustum(instance.aabbMin, instance.aabbMax, frustum) ? 1 : 0;
                     VkDrawIndexedIndirectCommand command = {
                         .indexCount = static_cast<u32>(mesh.second.indexCount),
                         .instanceCount = instanceCount,
@@ -100,7 +73,7 @@ auto cpuFrustumCullingPass(std::optional<GeometryCulling>& geometryCulling, Vulk
             backend.copyBufferWithStaging(indirectCmds.data(), sizeof(VkDrawIndexedIndirectCommand) * indirectCmds.size(),
                 *getResource<Buffer>(graph, data.culledDraws));
         }
-    };
+    });
 
     return data;
 }
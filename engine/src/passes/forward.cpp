@@ -17,9 +17,12 @@
 #include "rhi/vulkan/vulkan.h"
 #include "scene.h"
 
+// Specialization constant after the feature bits
+static constexpr u32 PcfTapsPerAxisConstantId = ForwardFeatureCount;
+static constexpr u32 PcfTapsPerAxis = 15;
+
 struct ForwardPushConstants
 {
-    glm::vec4 enabledFeatures; // normal mapping, parallax mapping
     VkDeviceAddress vertexBufferAddr;
     VkDeviceAddress perModelDataBufferAddr;
     VkDeviceAddress shadowData;
@@ -28,6 +31,10 @@ struct ForwardPushConstants
     VkDeviceAddress lightGrid;
     u32 shadowMapIndex;
     u32 depthMapIndex;
+    u32 lightTileCount[2];
+    u32 lightSliceCount;
+    f32 depthSliceScale;
+    f32 depthSliceBias;
 };
 
 auto initForwardOpaque(VulkanBackend& backend) -> ForwardOpaqueRenderer
@@ -53,11 +60,7 @@ auto initForwardOpaque(VulkanBackend& backend) -> ForwardOpaqueRenderer
         VK_IMAGE_ASPECT_COLOR_BIT);
 
     return ForwardOpaqueRenderer{
-        .pipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-                backend.bindlessResources->bindlessTexDescLayout
-            })
+        .pipelines = PipelinePermutations(PipelineBuilder(backend)
             .addPushConstants({
                 VkPushConstantRange{
                     .stageFlags = VK_SHADER_STAGE_ALL,
@@ -82,7 +85,8 @@ auto initForwardOpaque(VulkanBackend& backend) -> ForwardOpaqueRenderer
             .depthFormat(VK_FORMAT_D32_SFLOAT) // TEMP: this should be taken from bindless
             .addViewportScissorDynamicStates()
             .enableDepthTest(true, VK_COMPARE_OP_LESS_OR_EQUAL)
-            .build(),
+            .specializationConstant(PcfTapsPerAxisConstantId, PcfTapsPerAxis),
+            ForwardFeatureCount).prewarm(),
         .color = backend.bindlessResources->addTexture(
             Texture{
                 .image = outputImage,
@@ -115,56 +119,79 @@ auto initForwardOpaque(VulkanBackend& backend) -> ForwardOpaqueRenderer
 }
 
 auto opaqueForwardPass(std::optional<ForwardOpaqueRenderer>& forwardOpaqueRenderer, VulkanBackend& backend,
-    RenderGraph& graph, RenderGraphResource<Buffer> culledDraws, RenderGraphResource<BindlessTexture> depthMap,
-    RenderGraphResource<Buffer> shadowData, RenderGraphResource<BindlessTexture> shadowMap,
-    LightData lightData)
+    RenderGraph& graph, const SceneUploadRenderGraphData& sceneData, RenderGraphResource<Buffer> culledDraws,
+    RenderGraphResource<BindlessTexture> depthMap, RenderGraphResource<Buffer> shadowData,
+    RenderGraphResource<BindlessTexture> shadowMap, LightData lightData)
     -> ForwardRenderGraphData
 {
     if (!forwardOpaqueRenderer)
     {
-        forwardOpaqueRenderer = initForwardOpaque(backend);
+        forwardOpaqueRenderer.emplace(initForwardOpaque(backend));
     }
 
+    static bool normalMappingEnabled = true;
+    static bool parallaxMappingEnabled = true;
+    addDebugUI(debugUI, backend.currentFrame().frameArena, GRAPHICS_PASSES, [&]()
+    {
+        if (ImGui::TreeNode("Forward Opaque"))
+        {
+            ImGui::Checkbox("Normal mapping", &normalMappingEnabled);
+            ImGui::Checkbox("Parallax mapping", &parallaxMappingEnabled);
+
+            ImGui::TreePop();
+        }
+    });
+    const u32 features = (normalMappingEnabled ? ForwardNormalMapping : 0) |
+                         (parallaxMappingEnabled ? ForwardParallaxMapping : 0);
+
     auto& pass = createPass(graph);
     pass.pass.debugName = "Forward Opaque pass";
-    pass.pass.pipeline = forwardOpaqueRenderer->pipeline;
+    pass.pass.pipeline = forwardOpaqueRenderer->pipelines.get(features);
 
     struct ForwardOpaqueRenderGraphData
     {
+        VkDeviceAddress modelData;
         RenderGraphResource<Buffer> culledDraws;
         RenderGraphResource<Buffer> shadowData;
         RenderGraphResource<BindlessTexture> shadowMap;
         RenderGraphResource<BindlessTexture> depthMap;
-        RenderGraphResource<Buffer> lightList;
+        VkDeviceAddress lightList;
         RenderGraphResource<Buffer> lightIndexList;
         RenderGraphResource<Buffer> lightGrid;
         RenderGraphResource<BindlessTexture> color;
         RenderGraphResource<BindlessTexture> normal;
         RenderGraphResource<BindlessTexture> positions;
         RenderGraphResource<BindlessTexture> reflections;
+        u16 lightClusterCount[3];
+        f32 depthSliceScale;
+        f32 depthSliceBias;
     } data = {
-        .culledDraws = readResource<Buffer>(graph, pass, culledDraws),
-        .shadowData = readResource<Buffer>(graph, pass, shadowData),
-        .shadowMap = readResource<BindlessTexture>(graph, pass, shadowMap, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL),
-        .depthMap = readResource<BindlessTexture>(graph, pass, depthMap, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL),
-        .lightList = readResource<Buffer>(graph, pass, lightData.lightList),
-        .lightIndexList = readResource<Buffer>(graph, pass, lightData.lightIndexList),
-        .lightGrid = readResource<Buffer>(graph, pass, lightData.lightGrid),
+        .modelData = sceneData.modelData,
+        .culledDraws = readResource<Buffer>(graph, pass, culledDraws, ResourceUsage::IndirectRead),
+        .shadowData = readResource<Buffer>(graph, pass, shadowData, ResourceUsage::StorageRead),
+        .shadowMap = readResource<BindlessTexture>(graph, pass, shadowMap, ResourceUsage::DepthSampledRead),
+        .depthMap = readResource<BindlessTexture>(graph, pass, depthMap, ResourceUsage::DepthAttachmentRead),
+        .lightList = lightData.lightList,
+        .lightIndexList = readResource<Buffer>(graph, pass, lightData.lightIndexList, ResourceUsage::StorageRead),
+        .lightGrid = readResource<Buffer>(graph, pass, lightData.lightGrid, ResourceUsage::StorageRead),
         .color = writeResource<BindlessTexture>(graph, pass,
             importResource<BindlessTexture>(graph, pass, &forwardOpaqueRenderer->color),
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+            ResourceUsage::ColorAttachmentWrite),
         .normal = writeResource<BindlessTexture>(graph, pass,
             importResource<BindlessTexture>(graph, pass, &forwardOpaqueRenderer->normal),
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+            ResourceUsage::ColorAttachmentWrite),
         .positions = writeResource<BindlessTexture>(graph, pass,
             importResource<BindlessTexture>(graph, pass, &forwardOpaqueRenderer->positions),
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+            ResourceUsage::ColorAttachmentWrite),
         .reflections = writeResource<BindlessTexture>(graph, pass,
             importResource<BindlessTexture>(graph, pass, &forwardOpaqueRenderer->reflections),
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+            ResourceUsage::ColorAttachmentWrite),
+        .lightClusterCount = {lightData.clusterCount[0], lightData.clusterCount[1], lightData.clusterCount[2]},
+        .depthSliceScale = lightData.depthSliceScale,
+        .depthSliceBias = lightData.depthSliceBias,
     };
 
-    pass.pass.beginRendering = [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
+    setBeginRendering(graph, pass, [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
     {
         const VkExtent2D swapchainSize = {
             static_cast<u32>(backend.viewport.width),
@@ -203,40 +230,25 @@ auto opaqueForwardPass(std::optional<ForwardOpaqueRenderer>& forwardOpaqueRender
         auto renderingInfo = vkutil::init::renderingInfo(swapchainSize, attachments, std::size(attachments),
             &depthAttachmentInfo);
         vkCmdBeginRendering(cmd, &renderingInfo);
-    };
+    });
 
-    pass.pass.draw = [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene) -> void
+    setDraw(graph, pass, [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene) -> void
     {
         ZoneScopedCpuGpuAuto("Forward opaque pass", backend.currentFrame());
 
-        static bool normalMappingEnabled = true;
-        static bool parallaxMappingEnabled = true;
-        addDebugUI(debugUI, GRAPHICS_PASSES, [&]()
-        {
-            if (ImGui::TreeNode("Forward Opaque"))
-            {
-                ImGui::Checkbox("Normal mapping", &normalMappingEnabled);
-                ImGui::Checkbox("Parallax mapping", &parallaxMappingEnabled);
-
-                ImGui::TreePop();
-            }
-        });
-
         const ForwardPushConstants pushConstants = {
-            .enabledFeatures = glm::vec4(
-                normalMappingEnabled ? 1.f : 0.f,
-                parallaxMappingEnabled ? 1.f : 0.f,
-                0.f,
-                0.f
-            ),
             .vertexBufferAddr = backend.getBufferDeviceAddress(scene.vertexBuffer.buffer),
-            .perModelDataBufferAddr = backend.getBufferDeviceAddress(scene.perModelBuffer.buffer),
+            .perModelDataBufferAddr = data.modelData,
             .shadowData = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.shadowData)),
-            .lightList = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightList)),
+            .lightList = data.lightList,
             .lightIndexList = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightIndexList)),
             .lightGrid = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightGrid)),
             .shadowMapIndex = *getResource<BindlessTexture>(graph, data.shadowMap),
             .depthMapIndex = *getResource<BindlessTexture>(graph, data.depthMap),
+            .lightTileCount = {data.lightClusterCount[0], data.lightClusterCount[1]},
+            .lightSliceCount = data.lightClusterCount[2],
+            .depthSliceScale = data.depthSliceScale,
+            .depthSliceBias = data.depthSliceBias,
         };
         vkCmdPushConstants(cmd, pass.pipeline->pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(pushConstants),
             &pushConstants);
@@ -245,7 +257,8 @@ auto opaqueForwardPass(std::optional<ForwardOpaqueRenderer>& forwardOpaqueRender
         vkCmdBindIndexBuffer(cmd, scene.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
         vkCmdDrawIndexedIndirect(cmd, *getResource<Buffer>(graph, data.culledDraws), 0, scene.meshes.size(),
             sizeof(VkDrawIndexedIndirectCommand));
-    };
+        pass.drawCalls += static_cast<u32>(scene.meshes.size());
+    });
 
     return ForwardRenderGraphData {
         .color = data.color,
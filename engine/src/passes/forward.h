@@ -3,13 +3,22 @@
 #include "renderGraph.h"
 
 #include "passes/lightCulling.h"
+#include "rhi/vulkan/pipelinePermutations.h"
 
 class VulkanBackend;
 struct RenderGraph;
 
+// Feature keys of ForwardOpaqueRenderer::pipelines, bit i is specialization constant i of mesh.frag.glsl
+enum ForwardFeature : u32
+{
+    ForwardNormalMapping = 1 << 0,
+    ForwardParallaxMapping = 1 << 1,
+};
+constexpr u32 ForwardFeatureCount = 2;
+
 struct ForwardOpaqueRenderer
 {
-    Pipeline pipeline;
+    PipelinePermutations pipelines;
 
     BindlessTexture color;
     BindlessTexture normal;
@@ -27,7 +36,7 @@ struct ForwardRenderGraphData
 
 [[nodiscard]]
 auto opaqueForwardPass(std::optional<ForwardOpaqueRenderer>& forwardOpaqueRenderer, VulkanBackend& backend,
-    RenderGraph& graph, RenderGraphResource<Buffer> culledDraws, RenderGraphResource<BindlessTexture> depthMap,
-    RenderGraphResource<Buffer> shadowData, RenderGraphResource<BindlessTexture> shadowMap,
-    LightData lightData)
+    RenderGraph& graph, const SceneUploadRenderGraphData& sceneData, RenderGraphResource<Buffer> culledDraws,
+    RenderGraphResource<BindlessTexture> depthMap, RenderGraphResource<Buffer> shadowData,
+    RenderGraphResource<BindlessTexture> shadowMap, LightData lightData)
     -> ForwardRenderGraphData;
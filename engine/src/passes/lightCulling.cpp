@@ -7,6 +7,11 @@
 #include "rhi/vulkan/vulkan.h"
 #include "scene.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
 struct LightCullingPushConstants
 {
     u32 depthMap;
@@ -14,126 +19,337 @@ struct LightCullingPushConstants
     VkDeviceAddress lightIndexList;
     VkDeviceAddress lightGrid;
     VkDeviceAddress lightCount;
+    u32 lightIdCapacity;
 };
 
-auto initLightCulling(VulkanBackend& backend, Scene& scene, const u16 tileCount[2]) -> LightCulling
+struct ClusteredLightCullingPushConstants
 {
-    const u16 lightGridSize = tileCount[0] * tileCount[1];
-
-    constexpr u16 maxLightsPerTile = 1048;
-    constexpr u16 maxLights = 20000;
-    constexpr VkBufferUsageFlags lightBufferFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-
-    return LightCulling{
-        .pipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-                backend.bindlessResources->bindlessTexDescLayout
-            })
-            .addPushConstants({
-                VkPushConstantRange {
-                    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
-                    .offset = 0,
-                    .size = sizeof(LightCullingPushConstants)
-                }
-            })
-            .addShader(SHADER_PATH("tiledLightCulling.comp.glsl"), VK_SHADER_STAGE_COMPUTE_BIT)
-            .build(),
-        .lightList = backend.allocateBuffer(
-            vkutil::init::bufferCreateInfo(sizeof(decltype(scene.pointLights)::value_type) * maxLights,
-                lightBufferFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT),
-            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
-        .lightIndexList = backend.allocateBuffer(
-            vkutil::init::bufferCreateInfo(sizeof(u64) * lightGridSize * maxLightsPerTile, lightBufferFlags),
-            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    VkDeviceAddress lightList;
+    VkDeviceAddress lightIndexList;
+    VkDeviceAddress lightGrid;
+    VkDeviceAddress lightCount;
+    VkDeviceAddress lightBvh;
+    f32 nearPlane;
+    f32 farPlane;
+    // 0 if the tree didn't fit lightBvh, every light is tested then
+    u32 bvhLeafCount;
+    u32 lightIdCapacity;
+};
+
+// 16:9 tiles on screen, each cut into depth slices that get exponentially thicker with distance
+static constexpr u16 ClusterCount[3] = {16, 9, 24};
+// Starting points, grown once culling reports it needed more
+static constexpr u16 MaxLightsPerTile = 1048;
+static constexpr u16 MaxLightsPerCluster = 256;
+// Average light ids a tile is expected to need, sizes the index list
+static constexpr u32 LightIdBudgetPerTile = 32;
+
+// Light ids are packed two per uint and every tile's run starts on an even id, see LightIds in lights.glsl
+static_assert(SceneDataUploader::MaxLights <= 0xffff);
+static_assert(MaxLightsPerTile % 2 == 0 && MaxLightsPerCluster % 2 == 0);
+
+static auto allocateLightIndexList(VulkanBackend& backend, u32 lightIdCapacity) -> AllocatedBuffer
+{
+    return backend.allocateBuffer(
+        vkutil::init::bufferCreateInfo(sizeof(u16) * lightIdCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT),
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+// Largest tile the culling shaders' shared memory can gather, a power of two so the ids stay evenly packed
+static auto maxSharedLightsPerTile(const VulkanBackend& backend) -> u16
+{
+    // Leaves room for the rest of the shaders' shared variables
+    const u32 sharedIds = (backend.gpuProperties.limits.maxComputeSharedMemorySize - 1024) / sizeof(u32);
+    return static_cast<u16>(std::min(std::bit_floor(sharedIds), 0x8000u));
+}
+
+static auto initLightCulling(VulkanBackend& backend, Pipeline pipeline, const u16 clusterCount[3],
+    u16 maxLightsPerTile) -> LightCulling
+{
+    const u32 lightGridSize = clusterCount[0] * clusterCount[1] * clusterCount[2];
+    const u32 lightIdCapacity = lightGridSize * LightIdBudgetPerTile;
+
+    LightCulling lightCulling = {
+        .pipeline = std::move(pipeline),
+        .maxLightsPerTile = maxLightsPerTile,
+        .lightIndexList = allocateLightIndexList(backend, lightIdCapacity),
+        .lightIdCapacity = lightIdCapacity,
         .lightGrid = backend.allocateBuffer(
-            vkutil::init::bufferCreateInfo(sizeof(u64) * 2 * 2 * lightGridSize, lightBufferFlags),
+            // Count and offset
+            vkutil::init::bufferCreateInfo(sizeof(u32) * 2 * lightGridSize,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT),
             VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
-        // TEMP:
-        .lightCount = backend.allocateBuffer(
-            vkutil::init::bufferCreateInfo(sizeof(u64), lightBufferFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT),
-            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        .clusterCount = {clusterCount[0], clusterCount[1], clusterCount[2]},
     };
+    for (MappedBuffer& readback : lightCulling.counterReadback)
+    {
+        readback = backend.allocateMappedBuffer(
+            vkutil::init::bufferCreateInfo(sizeof(LightCullingCounters), VK_BUFFER_USAGE_TRANSFER_DST_BIT),
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+        // Nothing overflowed before the first frame
+        std::memset(readback.data, 0, sizeof(LightCullingCounters));
+    }
+    return lightCulling;
+}
+
+auto deinitLightCulling(VulkanBackend& backend, LightCulling& lightCulling) -> void
+{
+    vmaDestroyBuffer(backend.allocator, lightCulling.lightIndexList.buffer, lightCulling.lightIndexList.allocation);
+    vmaDestroyBuffer(backend.allocator, lightCulling.lightGrid.buffer, lightCulling.lightGrid.allocation);
+    for (const MappedBuffer& readback : lightCulling.counterReadback)
+    {
+        vmaDestroyBuffer(backend.allocator, readback.buffer.buffer, readback.buffer.allocation);
+    }
+    backend.destroyPipeline(lightCulling.pipeline);
+}
+
+// The graph is redeclared every frame, so the grid may change between frames. Resizing it is rare enough that
+// simply waiting for the GPU before dropping the old buffers is fine.
+static auto releaseOnGridChange(std::optional<LightCulling>& lightCulling, VulkanBackend& backend,
+    const u16 clusterCount[3]) -> void
+{
+    if (lightCulling && !std::equal(clusterCount, clusterCount + 3, lightCulling->clusterCount))
+    {
+        vkDeviceWaitIdle(backend.device);
+        deinitLightCulling(backend, *lightCulling);
+        lightCulling.reset();
+    }
+}
+
+// Reads the counters this frame's previous use copied back, it has retired by now. Whatever they overflowed is grown
+// for this and later frames, the lights dropped back then are only missing for that one frame.
+static auto growOnOverflow(LightCulling& lightCulling, VulkanBackend& backend,
+    Pipeline (*buildPipeline)(VulkanBackend&, u16 maxLightsPerTile)) -> void
+{
+    LightCullingCounters counters;
+    std::memcpy(&counters,
+        lightCulling.counterReadback[backend.currentFrameNumber % VulkanBackend::MaxFramesInFlight].data,
+        sizeof(counters));
+
+    if (counters.lightIdCount > lightCulling.lightIdCapacity)
+    {
+        // Headroom so a slowly growing light count doesn't reallocate every frame
+        const u32 lightIdCapacity = std::bit_ceil(counters.lightIdCount + counters.lightIdCount / 4);
+        std::println("Light index list overflowed, growing it from {} to {} ids.", lightCulling.lightIdCapacity,
+            lightIdCapacity);
+        backend.destroyBufferDeferred(lightCulling.lightIndexList);
+        lightCulling.lightIndexList = allocateLightIndexList(backend, lightIdCapacity);
+        lightCulling.lightIdCapacity = lightIdCapacity;
+    }
+
+    const u16 maxLightsPerTile = static_cast<u16>(
+        std::min<u32>(std::bit_ceil(counters.maxTileLightCount), maxSharedLightsPerTile(backend)));
+    if (maxLightsPerTile > lightCulling.maxLightsPerTile)
+    {
+        std::println("Light culling tile overflowed, growing it from {} to {} lights.", lightCulling.maxLightsPerTile,
+            maxLightsPerTile);
+        // Rare enough to wait for the GPU instead of retiring the old pipeline
+        vkDeviceWaitIdle(backend.device);
+        backend.destroyPipeline(lightCulling.pipeline);
+        lightCulling.pipeline = buildPipeline(backend, maxLightsPerTile);
+        lightCulling.maxLightsPerTile = maxLightsPerTile;
+    }
+}
+
+// Copies the counters back for growOnOverflow()
+static auto lightCullingReadbackPass(LightCulling& lightCulling, VulkanBackend& backend, RenderGraph& graph,
+    RenderGraphResource<Buffer> lightIdCount) -> void
+{
+    auto& pass = createPass(graph);
+    pass.pass.debugName = "Light culling readback pass";
+
+    const auto counters = readResource<Buffer>(graph, pass, lightIdCount, ResourceUsage::TransferRead);
+    const VkBuffer readback =
+        lightCulling.counterReadback[backend.currentFrameNumber % VulkanBackend::MaxFramesInFlight].buffer.buffer;
+
+    setDraw(graph, pass, [counters, readback, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph,
+        RenderPass&, Scene&)
+    {
+        ZoneScopedCpuGpuAuto("Light culling readback pass", backend.currentFrame());
+
+        const VkBufferCopy copyRegion = {.srcOffset = 0, .dstOffset = 0, .size = sizeof(LightCullingCounters)};
+        vkCmdCopyBuffer(cmd, *getResource<Buffer>(graph, counters), readback, 1, &copyRegion);
+
+        // The graph doesn't know about host reads
+        const VkMemoryBarrier2 toHost = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+            .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+        };
+        const VkDependencyInfo dependency = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &toHost,
+        };
+        vkCmdPipelineBarrier2(cmd, &dependency);
+    });
+}
+
+static auto tiledLightCullingPipeline(VulkanBackend& backend, u16 maxLightsPerTile) -> Pipeline
+{
+    return PipelineBuilder(backend)
+        .addPushConstants({
+            VkPushConstantRange {
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(LightCullingPushConstants)
+            }
+        })
+        .addShader(SHADER_PATH("tiledLightCulling.comp.glsl"), VK_SHADER_STAGE_COMPUTE_BIT)
+        // MAX_LIGHTS_PER_TILE, MAX_POINT_LIGHTS
+        .specializationConstant(0, maxLightsPerTile)
+        .specializationConstant(1, SceneDataUploader::MaxLights)
+        .build();
+}
+
+static auto clusteredLightCullingPipeline(VulkanBackend& backend, u16 maxLightsPerCluster) -> Pipeline
+{
+    return PipelineBuilder(backend)
+        .addPushConstants({
+            VkPushConstantRange {
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(ClusteredLightCullingPushConstants)
+            }
+        })
+        .addShader(SHADER_PATH("clusteredLightCulling.comp.glsl"), VK_SHADER_STAGE_COMPUTE_BIT)
+        // MAX_LIGHTS_PER_CLUSTER, MAX_POINT_LIGHTS
+        .specializationConstant(0, maxLightsPerCluster)
+        .specializationConstant(1, SceneDataUploader::MaxLights)
+        .build();
 }
 
 auto tiledLightCullingPass(std::optional<LightCulling>& lightCulling, VulkanBackend& backend, RenderGraph& graph,
-    Scene& scene, RenderGraphResource<BindlessTexture> depthMap, f32 tileSizeAsPercentageOfScreen)
+    const SceneUploadRenderGraphData& sceneData, RenderGraphResource<BindlessTexture> depthMap,
+    f32 tileSizeAsPercentageOfScreen)
     -> LightData
 {
     // TODO: This should inspect some GPU capabilities
-    const u16 tileCount[2] = {
+    const u16 tileCount[3] = {
         static_cast<u16>(std::ceil(static_cast<f32>(backend.backbufferImage.extent.width) * tileSizeAsPercentageOfScreen)),
-        static_cast<u16>(std::ceil(static_cast<f32>(backend.backbufferImage.extent.height) * tileSizeAsPercentageOfScreen))
+        static_cast<u16>(std::ceil(static_cast<f32>(backend.backbufferImage.extent.height) * tileSizeAsPercentageOfScreen)),
+        1
     };
-    std::println("Using {}x{} tiles for light culling.", tileCount[0], tileCount[1]);
 
+    releaseOnGridChange(lightCulling, backend, tileCount);
     if (!lightCulling)
     {
-        lightCulling = initLightCulling(backend, scene, tileCount);
+        std::println("Using {}x{} tiles for light culling.", tileCount[0], tileCount[1]);
+        lightCulling = initLightCulling(backend, tiledLightCullingPipeline(backend, MaxLightsPerTile), tileCount,
+            MaxLightsPerTile);
     }
+    growOnOverflow(*lightCulling, backend, tiledLightCullingPipeline);
 
     auto& pass = createPass(graph);
     pass.pass.debugName = "Tiled light culling pass";
     pass.pass.pipeline = lightCulling->pipeline;
 
     LightData data = {
-        // TODO: light list should be uploaded in a separate, earlier pass
-        .depthMap = readResource<BindlessTexture>(graph, pass, depthMap, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-        .lightList = readResource<Buffer>(graph, pass, importResource(graph, pass, &lightCulling->lightList.buffer)),
-        .lightIndexList = writeResource<Buffer>(
-            graph, pass, importResource(graph, pass, &lightCulling->lightIndexList.buffer)),
-        .lightGrid = writeResource<Buffer>(graph, pass, importResource(graph, pass, &lightCulling->lightGrid.buffer)),
-        // TEMP:
-        .lightCount = writeResource<Buffer>(graph, pass, importResource(graph, pass, &lightCulling->lightCount.buffer)),
+        .depthMap = readResource<BindlessTexture>(graph, pass, depthMap, ResourceUsage::SampledRead),
+        .lightList = sceneData.lightList,
+        .lightIndexList = writeResource<Buffer>(graph, pass,
+            importResource(graph, pass, &lightCulling->lightIndexList.buffer), ResourceUsage::StorageWrite),
+        .lightGrid = writeResource<Buffer>(graph, pass, importResource(graph, pass, &lightCulling->lightGrid.buffer),
+            ResourceUsage::StorageWrite),
+        .lightIdCount = writeResource<Buffer>(graph, pass, sceneData.lightIdCount, ResourceUsage::StorageWrite),
+        .clusterCount = {tileCount[0], tileCount[1], tileCount[2]},
+        // Single slice
+        .depthSliceScale = 0.f,
+        .depthSliceBias = 0.f,
     };
 
-    pass.pass.draw = [data, tileCount, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
+    const u32 lightIdCapacity = lightCulling->lightIdCapacity;
+    setDraw(graph, pass, [data, lightIdCapacity, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph,
+        RenderPass& pass, Scene& scene)
     {
         ZoneScopedCpuGpuAuto("Tiled light culling pass", backend.currentFrame());
 
-        // TODO: this should live in a separate pass at the start, for uploading all the scene info.
-        u32 count = scene.pointLights.size();
-        backend.copyBufferWithStaging(&count, sizeof(count), *getResource<Buffer>(graph, data.lightList));
-        backend.copyBufferWithStaging(scene.pointLights.data(),
-            sizeof(decltype(scene.pointLights)::value_type) * scene.pointLights.size(),
-            *getResource<Buffer>(graph, data.lightList),
-            VkBufferCopy{
-                .srcOffset = 0,
-                .dstOffset = sizeof(glm::vec4),
-            }
-        );
-
-        // TEMP:
-        count = 0;
-        backend.copyBufferWithStaging(&count, sizeof(count), *getResource<Buffer>(graph, data.lightCount));
-
         const LightCullingPushConstants pushConstants = {
             .depthMap = *getResource<BindlessTexture>(graph, data.depthMap),
-            .lightList = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightList)),
+            .lightList = data.lightList,
             .lightIndexList = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightIndexList)),
             .lightGrid = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightGrid)),
-            // TEMP:
-            .lightCount = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightCount)),
+            .lightCount = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightIdCount)),
+            .lightIdCapacity = lightIdCapacity,
         };
 
         vkCmdPushConstants(cmd, pass.pipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
             &pushConstants);
         vkCmdBindDescriptorSets(cmd, pass.pipeline->pipelineBindPoint, pass.pipeline->pipelineLayout, 1, 1,
             &backend.bindlessResources->bindlessTexDesc, 0, nullptr);
-        vkCmdDispatch(cmd, tileCount[0], tileCount[1], 1);
-    };
+        vkCmdDispatch(cmd, data.clusterCount[0], data.clusterCount[1], 1);
+    });
 
+    lightCullingReadbackPass(*lightCulling, backend, graph, data.lightIdCount);
     return data;
 }
 
 auto clusteredLightCullingPass(std::optional<LightCulling>& lightCulling, VulkanBackend& backend,
-    RenderGraph& graph, RenderGraphResource<BindlessTexture> depthMap, Scene& scene)
+    RenderGraph& graph, const SceneUploadRenderGraphData& sceneData, RenderGraphResource<BindlessTexture> depthMap,
+    Scene& scene)
     -> LightData
 {
-    return tiledLightCullingPass(lightCulling, backend, graph, scene, depthMap, 1.f / 32.f);
+    releaseOnGridChange(lightCulling, backend, ClusterCount);
+    if (!lightCulling)
+    {
+        std::println("Using {}x{}x{} clusters for light culling.", ClusterCount[0], ClusterCount[1],
+            ClusterCount[2]);
+        lightCulling = initLightCulling(backend, clusteredLightCullingPipeline(backend, MaxLightsPerCluster),
+            ClusterCount, MaxLightsPerCluster);
+    }
+    growOnOverflow(*lightCulling, backend, clusteredLightCullingPipeline);
+
+    auto& pass = createPass(graph);
+    pass.pass.debugName = "Clustered light culling pass";
+    pass.pass.pipeline = lightCulling->pipeline;
+
+    // Slice k of n starts at near * (far / near)^(k / n), so the slice of depth d is n * log(d / near) / log(far / near)
+    const f32 nearPlane = scene.activeCamera->nearClippingPlaneDist;
+    const f32 farPlane = scene.activeCamera->farClippingPlaneDist;
+    const f32 logDepthRange = std::log(farPlane / nearPlane);
+
+    LightData data = {
+        // Clusters are bounded by their depth slice instead, the depth map is only passed through
+        .depthMap = depthMap,
+        .lightList = sceneData.lightList,
+        .lightIndexList = writeResource<Buffer>(graph, pass,
+            importResource(graph, pass, &lightCulling->lightIndexList.buffer), ResourceUsage::StorageWrite),
+        .lightGrid = writeResource<Buffer>(graph, pass, importResource(graph, pass, &lightCulling->lightGrid.buffer),
+            ResourceUsage::StorageWrite),
+        .lightIdCount = writeResource<Buffer>(graph, pass, sceneData.lightIdCount, ResourceUsage::StorageWrite),
+        .clusterCount = {ClusterCount[0], ClusterCount[1], ClusterCount[2]},
+        .depthSliceScale = ClusterCount[2] / logDepthRange,
+        .depthSliceBias = -ClusterCount[2] * std::log(nearPlane) / logDepthRange,
+    };
+
+    const u32 lightIdCapacity = lightCulling->lightIdCapacity;
+    setDraw(graph, pass, [data, sceneData, nearPlane, farPlane, lightIdCapacity, &backend](VkCommandBuffer cmd,
+        CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
+    {
+        ZoneScopedCpuGpuAuto("Clustered light culling pass", backend.currentFrame());
+
+        const ClusteredLightCullingPushConstants pushConstants = {
+            .lightList = data.lightList,
+            .lightIndexList = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightIndexList)),
+            .lightGrid = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightGrid)),
+            .lightCount = backend.getBufferDeviceAddress(*getResource<Buffer>(graph, data.lightIdCount)),
+            .lightBvh = sceneData.lightBvh,
+            .nearPlane = nearPlane,
+            .farPlane = farPlane,
+            .bvhLeafCount = sceneData.lightBvhLeafCount,
+            .lightIdCapacity = lightIdCapacity,
+        };
+
+        vkCmdPushConstants(cmd, pass.pipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants),
+            &pushConstants);
+        vkCmdDispatch(cmd, data.clusterCount[0], data.clusterCount[1], data.clusterCount[2]);
+    });
+
+    lightCullingReadbackPass(*lightCulling, backend, graph, data.lightIdCount);
+    return data;
 }
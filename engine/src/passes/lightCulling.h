@@ -1,37 +1,54 @@
 #pragma once
 
 #include "engine.h"
+#include "passes/sceneUpload.h"
 #include "renderGraph.h"
 #include "rhi/renderpass.h"
 #include "rhi/vulkan/bindless.h"
 #include "rhi/vulkan/utils/buffer.h"
 
+// Tiles append their light ids to one shared index list. Both the list and the lights a tile can gather are sized
+// from a budget and grown once a frame that overflowed them has retired, see growOnOverflow().
 struct LightCulling
 {
     Pipeline pipeline;
+    // Lights a tile gathers in shared memory, a specialization constant of the pipeline
+    u16 maxLightsPerTile;
 
-    AllocatedBuffer lightList;
     AllocatedBuffer lightIndexList;
+    // In light ids
+    u32 lightIdCapacity;
     AllocatedBuffer lightGrid;
-    // TEMP:
-    AllocatedBuffer lightCount;
+
+    // LightCullingCounters of each frame in flight, copied back after culling
+    MappedBuffer counterReadback[VulkanBackend::MaxFramesInFlight];
+
+    // Tile grid the buffers above were sized for, a single depth slice when culling per tile
+    u16 clusterCount[3];
 };
 
 struct LightData
 {
     RenderGraphResource<BindlessTexture> depthMap;
-    RenderGraphResource<Buffer> lightList;
+    // See SceneUploadRenderGraphData
+    VkDeviceAddress lightList;
     RenderGraphResource<Buffer> lightIndexList;
     RenderGraphResource<Buffer> lightGrid; // Might be 2d or 3d depending on culling algorithm
-    // TEMP:
-    RenderGraphResource<Buffer> lightCount;
+    RenderGraphResource<Buffer> lightIdCount;
+
+    u16 clusterCount[3];
+    // Depth slice of a view space depth d is log(d) * depthSliceScale + depthSliceBias
+    f32 depthSliceScale;
+    f32 depthSliceBias;
 };
 
 [[nodiscard]]
 auto tiledLightCullingPass(std::optional<LightCulling>& lightCulling, VulkanBackend& backend, RenderGraph& graph,
-    Scene& scene, RenderGraphResource<BindlessTexture> depthMap, f32 tileSizeAsPercentageOfScreen)
+    const SceneUploadRenderGraphData& sceneData, RenderGraphResource<BindlessTexture> depthMap,
+    f32 tileSizeAsPercentageOfScreen)
     -> LightData;
 [[nodiscard]]
 auto clusteredLightCullingPass(std::optional<LightCulling>& lightCulling, VulkanBackend& backend,
-    RenderGraph& graph, RenderGraphResource<BindlessTexture> depthMap, Scene& scene)
+    RenderGraph& graph, const SceneUploadRenderGraphData& sceneData, RenderGraphResource<BindlessTexture> depthMap,
+    Scene& scene)
     -> LightData;
\ No newline at end of file
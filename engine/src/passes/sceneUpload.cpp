@@ -0,0 +1,135 @@
+#include "passes/sceneUpload.h"
+
+#include "memory/arenaAllocator.h"
+#include "mesh.h"
+#include "rhi/renderpass.h"
+#include "rhi/vulkan/utils/inits.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cstring>
+
+static auto allocateMappedBuffer(VulkanBackend& backend, VkDeviceSize size) -> MappedBuffer
+{
+    return backend.allocateMappedBuffer(
+        vkutil::init::bufferCreateInfo(size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT),
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+}
+
+static auto initSceneDataUploader(VulkanBackend& backend, u32 modelDataCapacity) -> SceneDataUploader
+{
+    SceneDataUploader uploader = {
+        .modelDataCapacity = modelDataCapacity,
+        .lightIdCount = backend.allocateBuffer(
+            vkutil::init::bufferCreateInfo(sizeof(LightCullingCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT),
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    for (auto& frame : uploader.frames)
+    {
+        frame = {
+            .lightList = allocateMappedBuffer(backend,
+                sizeof(glm::vec4) + sizeof(PointLight) * SceneDataUploader::MaxLights),
+            .lightBvh = allocateMappedBuffer(backend, sizeof(LightBvhNode) * SceneDataUploader::MaxLightBvhNodes),
+            // Empty scenes still get a valid address
+            .modelData = allocateMappedBuffer(backend, sizeof(ModelData) * std::max(modelDataCapacity, 1u)),
+        };
+    }
+    return uploader;
+}
+
+static auto deinitSceneDataUploader(VulkanBackend& backend, SceneDataUploader& uploader) -> void
+{
+    for (auto& frame : uploader.frames)
+    {
+        for (const auto* mapped : {&frame.lightList, &frame.lightBvh, &frame.modelData})
+        {
+            vmaDestroyBuffer(backend.allocator, mapped->buffer.buffer, mapped->buffer.allocation);
+        }
+    }
+    vmaDestroyBuffer(backend.allocator, uploader.lightIdCount.buffer, uploader.lightIdCount.allocation);
+}
+
+auto sceneUploadPass(std::optional<SceneDataUploader>& uploader, VulkanBackend& backend, RenderGraph& graph,
+    Scene& scene) -> SceneUploadRenderGraphData
+{
+    // A scene with more instances than the buffers hold was loaded. Rare enough to simply wait for the GPU.
+    if (uploader && uploader->modelDataCapacity < scene.meshCount)
+    {
+        vkDeviceWaitIdle(backend.device);
+        deinitSceneDataUploader(backend, *uploader);
+        uploader.reset();
+    }
+
+    if (!uploader)
+    {
+        uploader = initSceneDataUploader(backend, scene.meshCount);
+    }
+
+    auto& pass = createPass(graph);
+    pass.pass.debugName = "Scene upload pass";
+
+    const LightBvh& bvh = scene.lightBvh;
+    const bool bvhUploaded = bvh.order.size() == scene.pointLights.size() &&
+        bvh.nodes.size() <= SceneDataUploader::MaxLightBvhNodes;
+
+    const auto* frame = &uploader->frames[backend.currentFrameNumber % VulkanBackend::MaxFramesInFlight];
+    SceneUploadRenderGraphData data = {
+        .lightList = backend.getBufferDeviceAddress(frame->lightList.buffer.buffer),
+        .lightBvh = backend.getBufferDeviceAddress(frame->lightBvh.buffer.buffer),
+        .modelData = backend.getBufferDeviceAddress(frame->modelData.buffer.buffer),
+        .lightBvhLeafCount = bvhUploaded ? bvh.leafCount : 0,
+        .lightIdCount = writeResource<Buffer>(graph, pass,
+            importResource(graph, pass, &uploader->lightIdCount.buffer), ResourceUsage::TransferWrite),
+    };
+
+    setDraw(graph, pass, [data, frame, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass&,
+        Scene& scene)
+    {
+        ZoneScopedCpuGpuAuto("Scene upload pass", backend.currentFrame());
+
+        {
+            ZoneScopedN("Model data");
+            auto modelData = gatherModelData(scene.meshes, scene.meshCount,
+                ArenaAllocator<ModelData>(backend.currentFrame().frameArena));
+            // Meshes keep their handles, the slots the shaders index may have moved on a residency change
+            for (ModelData& model : modelData)
+            {
+                for (glm::length_t i = 0; i < 4; ++i)
+                {
+                    if (model.textures[i] >= 0.f)
+                    {
+                        model.textures[i] = static_cast<f32>(
+                            backend.bindlessResources->resolve(static_cast<BindlessTexture>(model.textures[i])));
+                    }
+                }
+            }
+            std::memcpy(frame->modelData.data, modelData.data(), sizeof(ModelData) * modelData.size());
+        }
+
+        {
+            ZoneScopedN("Lights");
+            // Lights go up in the light BVH's order
+            const LightBvh& bvh = scene.lightBvh;
+            const bool sorted = bvh.order.size() == scene.pointLights.size();
+            const u32 lightCount = std::min<size_t>(scene.pointLights.size(), SceneDataUploader::MaxLights);
+            std::memcpy(frame->lightList.data, &lightCount, sizeof(lightCount));
+            auto* lights = reinterpret_cast<PointLight*>(frame->lightList.data + sizeof(glm::vec4));
+            for (u32 i = 0; i < lightCount; ++i)
+            {
+                lights[i] = scene.pointLights[sorted ? bvh.order[i] : i];
+            }
+
+            if (data.lightBvhLeafCount > 0)
+            {
+                std::memcpy(frame->lightBvh.data, bvh.nodes.data(), sizeof(LightBvhNode) * bvh.nodes.size());
+            }
+        }
+
+        vkCmdFillBuffer(cmd, *getResource<Buffer>(graph, data.lightIdCount), 0, VK_WHOLE_SIZE, 0);
+    });
+
+    return data;
+}
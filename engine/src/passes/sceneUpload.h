@@ -0,0 +1,61 @@
+#pragma once
+
+#include "engine.h"
+#include "lightBvh.h"
+#include "renderGraph.h"
+#include "rhi/vulkan/backend.h"
+#include "rhi/vulkan/utils/buffer.h"
+
+#include <bit>
+#include <optional>
+
+struct Scene;
+
+// Matches LightIdCount in lights.glsl
+struct LightCullingCounters
+{
+    // Ids the tiles asked for, more than the index list holds if it overflowed
+    u32 lightIdCount;
+    // Lights found in the fullest tile, before capping them to what the culling shader holds
+    u32 maxTileLightCount;
+};
+
+// CPU side scene data the GPU reads every frame. The buffers are host visible and stay mapped, there is one set per
+// frame in flight so the CPU fills the current frame's while the GPU may still read the previous one's.
+struct SceneDataUploader
+{
+    static constexpr u32 MaxLights = 20000;
+    static constexpr u32 MaxLightBvhNodes =
+        2 * std::bit_ceil((MaxLights + LightBvh::LightsPerLeaf - 1) / LightBvh::LightsPerLeaf) - 1;
+
+    struct FrameBuffers
+    {
+        // Light count in front of the lights
+        MappedBuffer lightList;
+        MappedBuffer lightBvh;
+        MappedBuffer modelData;
+    };
+    FrameBuffers frames[VulkanBackend::MaxFramesInFlight];
+    // Instances the model data buffers were sized for
+    u32 modelDataCapacity;
+
+    // LightCullingCounters, reset on the GPU at the start of every frame
+    AllocatedBuffer lightIdCount;
+};
+
+struct SceneUploadRenderGraphData
+{
+    // Written by the CPU before the frame is submitted, which makes them visible without any barriers. They
+    // change every frame, so they aren't graph resources either.
+    VkDeviceAddress lightList;
+    VkDeviceAddress lightBvh;
+    VkDeviceAddress modelData;
+    // 0 if the light BVH wasn't uploaded
+    u32 lightBvhLeafCount;
+
+    RenderGraphResource<Buffer> lightIdCount;
+};
+
+[[nodiscard]]
+auto sceneUploadPass(std::optional<SceneDataUploader>& uploader, VulkanBackend& backend, RenderGraph& graph,
+    Scene& scene) -> SceneUploadRenderGraphData;
@@ -7,6 +7,7 @@
 #include "rhi/vulkan/utils/inits.h"
 #include "rhi/vulkan/vulkan.h"
 #include "scene.h"
+#include "shadowCascades.h"
 
 #include <glm/glm.hpp>
 #include <optional>
@@ -19,111 +20,6 @@ struct CascadeParams
     u32 cascadeCount;
 };
 
-auto frustumCornersInWorldSpace(glm::mat4 invViewProj) -> std::array<glm::vec3, 8>
-{
-    std::array frustumCorners = {
-        glm::vec3(-1.0f, 1.0f, 0.0f),
-        glm::vec3(1.0f, 1.0f, 0.0f),
-        glm::vec3(1.0f, -1.0f, 0.0f),
-        glm::vec3(-1.0f, -1.0f, 0.0f),
-        glm::vec3(-1.0f, 1.0f, 1.0f),
-        glm::vec3(1.0f, 1.0f, 1.0f),
-        glm::vec3(1.0f, -1.0f, 1.0f),
-        glm::vec3(-1.0f, -1.0f, 1.0f),
-    };
-
-    for (u32 i = 0; i < 8; i++)
-    {
-        const auto invCorner = invViewProj * glm::vec4(frustumCorners[i], 1.0f);
-        frustumCorners[i] = invCorner / invCorner.w;
-    }
-
-    return frustumCorners;
-}
-
-void csmLightViewProjMats(glm::mat4* viewProjMats, glm::vec4* cascadeDistances, i32 cascadeCount, glm::mat4 view,
-    glm::mat4 proj, glm::vec3 lightDirr, f32 nearClip, f32 farClip, f32 cascadeSplitLambda, f32 resolution)
-{
-    // f32 cascadeSplitLambda = 0.8f;
-    f32 cascadeSplits[cascadeCount];
-
-    f32 clipRange = farClip - nearClip;
-
-    f32 minZ = nearClip;
-    f32 maxZ = nearClip + clipRange;
-
-    f32 range = maxZ - minZ;
-    f32 ratio = maxZ / minZ;
-
-    // Calculate split depths based on view camera frustum
-    // Based on method presented in https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
-    for (u32 i = 0; i < cascadeCount; i++)
-    {
-        f32 p = (i + 1) / static_cast<f32>(cascadeCount);
-        f32 log = minZ * std::pow(ratio, p);
-        f32 uniform = minZ + range * p;
-        f32 d = cascadeSplitLambda * (log - uniform) + uniform;
-        // cascadeDistances[i] = (d - nearClip) / clipRange;
-        cascadeSplits[i] = (d - nearClip) / clipRange;
-    }
-
-    f32 lastSplitDist = 0.f;
-    glm::mat4 invViewProj = glm::inverse(proj * view);
-    for (i32 i = 0; i < cascadeCount; i++)
-    {
-        std::array<glm::vec3, 8> frustumCorners = frustumCornersInWorldSpace(invViewProj);
-
-        f32 splitDist = cascadeSplits[i];
-        for (u32 j = 0; j < 4; j++)
-        {
-            glm::vec3 dist = frustumCorners[j + 4] - frustumCorners[j];
-            frustumCorners[j + 4] = frustumCorners[j] + (dist * splitDist);
-            frustumCorners[j] = frustumCorners[j] + (dist * lastSplitDist);
-        }
-        lastSplitDist = cascadeSplits[i];
-
-        glm::vec3 frustumCenter = glm::vec3(0.0f);
-        for (u32 j = 0; j < 8; j++)
-        {
-            frustumCenter += frustumCorners[j];
-        }
-        frustumCenter /= 8.0f;
-
-        f32 radius = 0.0f;
-        for (u32 j = 0; j < 8; j++)
-        {
-            f32 distance = glm::length(frustumCorners[j] - frustumCenter);
-            radius = glm::max(radius, distance);
-        }
-        //radius = std::ceil(radius / 2.0f) * 2.0f;
-        radius = std::ceil(radius * 16.0f) / 16.0f;
-
-        glm::vec3 lightDir = normalize(lightDirr); // NOTE: convert lightDir into light pos
-
-        glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - (lightDir * radius), frustumCenter,
-            glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 lightOrthoMatrix = glm::ortho(-radius, radius, -radius, radius,
-            -radius * 2, radius * 2);
-        viewProjMats[i] = lightOrthoMatrix * lightViewMatrix;
-
-        glm::vec4 lightSpaceOrigin = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-        lightSpaceOrigin = viewProjMats[i] * lightSpaceOrigin;
-        lightSpaceOrigin = lightSpaceOrigin * (resolution / 2.0f); // Range [-resolution/2; resolution/2]
-
-        glm::vec4 roundedOrigin = glm::round(lightSpaceOrigin);
-        glm::vec4 roundOffset = roundedOrigin - lightSpaceOrigin;
-        roundOffset = roundOffset * (2.0f / resolution);
-        roundOffset.z = 0.0f;
-        roundOffset.w = 0.0f;
-
-        glm::mat4 shadowProj = viewProjMats[i];
-        shadowProj[3] += roundOffset;
-        viewProjMats[i] = shadowProj;
-
-        cascadeDistances[i] = glm::vec4((nearClip + splitDist * clipRange) * -1.0f);
-    }
-}
-
 auto csmCascadeParams(u32 cascadeCount, Camera& camera, glm::vec3 lightDir, f32 cascadeSplitLambda, f32 resolution)
     -> CascadeParams
 {
@@ -199,7 +95,8 @@ auto initCsm(VulkanBackend& backend, u32 cascadeCount) -> ShadowRenderer
     };
 }
 
-auto csmPass(std::optional<ShadowRenderer>& shadowRenderer, VulkanBackend& backend, RenderGraph& graph, u8 cascadeCount)
+auto csmPass(std::optional<ShadowRenderer>& shadowRenderer, VulkanBackend& backend, RenderGraph& graph,
+    const SceneUploadRenderGraphData& sceneData, u8 cascadeCount)
     ->ShadowPassRenderGraphData
 {
     if (!shadowRenderer)
@@ -209,16 +106,18 @@ auto csmPass(std::optional<ShadowRenderer>& shadowRenderer, VulkanBackend& backe
 
     auto& pass = createPass(graph);
     pass.pass.debugName = "CSM pass";
+    pass.pass.bindSceneDescriptors = false;
     pass.pass.pipeline = shadowRenderer->pipeline;
 
     ShadowPassRenderGraphData data = {
         .shadowMap = writeResource<BindlessTexture>(graph, pass,
-            importResource(graph, pass, &shadowRenderer->shadowMap), VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL),
+            importResource(graph, pass, &shadowRenderer->shadowMap), ResourceUsage::DepthAttachmentWrite),
+        // Uploaded with a staging copy
         .cascadeParams = writeResource<Buffer>(graph, pass,
-            importResource(graph, pass, &shadowRenderer->cascadeParams.buffer))
+            importResource(graph, pass, &shadowRenderer->cascadeParams.buffer), ResourceUsage::TransferWrite)
     };
 
-    pass.pass.beginRendering = [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
+    setBeginRendering(graph, pass, [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
     {
         const auto shadowMap = backend.bindlessResources->getTexture(
             *getResource<BindlessTexture>(graph, data.shadowMap));
@@ -230,10 +129,10 @@ auto csmPass(std::optional<ShadowRenderer>& shadowRenderer, VulkanBackend& backe
         auto depthAttachmentInfo = vkutil::init::renderingDepthAttachmentInfo(shadowMap.view);
         auto renderingInfo = vkutil::init::renderingInfo(size, nullptr, 0, &depthAttachmentInfo);
         vkCmdBeginRendering(cmd, &renderingInfo);
-    };
+    });
 
-    pass.pass.draw = [data, cascadeCount, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass,
-        Scene& scene)
+    setDraw(graph, pass, [data, cascadeCount, modelData = sceneData.modelData, &backend](VkCommandBuffer cmd,
+        CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
     {
         ZoneScopedCpuGpuAuto("CSM pass", backend.currentFrame());
 
@@ -249,7 +148,7 @@ auto csmPass(std::optional<ShadowRenderer>& shadowRenderer, VulkanBackend& backe
         ShadowPushConstants pushConstants{
             .vertexBufferAddr = backend.getBufferDeviceAddress(scene.vertexBuffer.buffer),
             .cascadeDataAddr = backend.getBufferDeviceAddress(cascadeParamBuffer),
-            .perModelDataBufferAddr = backend.getBufferDeviceAddress(scene.perModelBuffer.buffer),
+            .perModelDataBufferAddr = modelData,
         };
 
         VkViewport viewport = {
@@ -278,8 +177,9 @@ auto csmPass(std::optional<ShadowRenderer>& shadowRenderer, VulkanBackend& backe
 
             vkCmdDrawIndexedIndirect(cmd, scene.indirectCommands.buffer, 0, scene.meshes.size(),
                 sizeof(VkDrawIndexedIndirectCommand));
+            pass.drawCalls += static_cast<u32>(scene.meshes.size());
         }
-    };
+    });
 
     return data;
 }
\ No newline at end of file
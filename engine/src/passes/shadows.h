@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../rhi/vulkan/bindless.h"
+#include "passes/sceneUpload.h"
 #include "renderGraph.h"
 #include "rhi/vulkan/utils/buffer.h"
 
@@ -21,5 +22,5 @@ struct ShadowPassRenderGraphData
 
 [[nodiscard]]
 auto csmPass(std::optional<ShadowRenderer>& shadowRenderer, VulkanBackend& backend,
-    RenderGraph& graph, u8 cascadeCount = 4)
+    RenderGraph& graph, const SceneUploadRenderGraphData& sceneData, u8 cascadeCount = 4)
     -> ShadowPassRenderGraphData;
@@ -30,10 +30,6 @@ auto initScreenSpace(VulkanBackend& backend) -> ScreenSpaceRenderer
 
     return ScreenSpaceRenderer{
         .ssrPipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-                backend.bindlessResources->bindlessTexDescLayout
-            })
             .addPushConstants({
                 VkPushConstantRange {
                     .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
@@ -84,15 +80,15 @@ auto ssrPass(std::optional<ScreenSpaceRenderer>& ssRenderer, std::optional<BlurR
     pass.pass.debugName = "SSR pass";
     pass.pass.pipeline = ssRenderer->ssrPipeline;
 
-    colorOutput = readResource<BindlessTexture>(graph, pass, colorOutput, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    normal = readResource<BindlessTexture>(graph, pass, normal, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    positions = readResource<BindlessTexture>(graph, pass, positions, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    reflectionUvs = readResource<BindlessTexture>(graph, pass, reflectionUvs, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    blurredReflectionUvs = readResource<BindlessTexture>(graph, pass, blurredReflectionUvs, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    colorOutput = readResource<BindlessTexture>(graph, pass, colorOutput, ResourceUsage::SampledRead);
+    normal = readResource<BindlessTexture>(graph, pass, normal, ResourceUsage::SampledRead);
+    positions = readResource<BindlessTexture>(graph, pass, positions, ResourceUsage::SampledRead);
+    reflectionUvs = readResource<BindlessTexture>(graph, pass, reflectionUvs, ResourceUsage::SampledRead);
+    blurredReflectionUvs = readResource<BindlessTexture>(graph, pass, blurredReflectionUvs, ResourceUsage::SampledRead);
     const auto output = writeResource<BindlessTexture>(graph, pass, importResource(graph, pass, &ssRenderer->output),
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        ResourceUsage::ColorAttachmentWrite);
 
-    pass.pass.beginRendering = [output, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
+    setBeginRendering(graph, pass, [output, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
     {
         const VkExtent2D swapchainSize = {
             static_cast<u32>(backend.viewport.width),
@@ -106,9 +102,9 @@ auto ssrPass(std::optional<ScreenSpaceRenderer>& ssRenderer, std::optional<BlurR
             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
         auto renderingInfo = vkutil::init::renderingInfo(swapchainSize, &colorAttachmentInfo, 1, nullptr);
         vkCmdBeginRendering(cmd, &renderingInfo);
-    };
+    });
 
-    pass.pass.draw = [colorOutput, normal, positions, reflectionUvs, blurredReflectionUvs, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
+    setDraw(graph, pass, [colorOutput, normal, positions, reflectionUvs, blurredReflectionUvs, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
     {
         ZoneScopedCpuGpuAuto("SSR pass", backend.currentFrame());
 
@@ -123,7 +119,7 @@ auto ssrPass(std::optional<ScreenSpaceRenderer>& ssRenderer, std::optional<BlurR
         } mode = BLEND;
         static float reflectionIntensity = 2.f;
         static float blurIntensity = 0.75f;
-        addDebugUI(debugUI, GRAPHICS_PASSES, [&]()
+        addDebugUI(debugUI, backend.currentFrame().frameArena, GRAPHICS_PASSES, [&]()
         {
             if (ImGui::TreeNode("Screen Space Reflections"))
             {
@@ -159,7 +155,8 @@ auto ssrPass(std::optional<ScreenSpaceRenderer>& ssRenderer, std::optional<BlurR
         vkCmdBindDescriptorSets(cmd, pass.pipeline->pipelineBindPoint, pass.pipeline->pipelineLayout, 1, 1,
             &backend.bindlessResources->bindlessTexDesc, 0, nullptr);
         vkCmdDraw(cmd, 3, 1, 0, 0);
-    };
+        pass.drawCalls++;
+    });
 
     return output;
 }
@@ -10,9 +10,6 @@ auto initTestRenderer(VulkanBackend& backend) -> TestRenderer
 {
     return TestRenderer{
         .pipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-            })
             .addShader(SHADER_PATH("colored_triangle.vert.glsl"), VK_SHADER_STAGE_VERTEX_BIT)
             .addShader(SHADER_PATH("colored_triangle.frag.glsl"), VK_SHADER_STAGE_FRAGMENT_BIT)
             .topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
@@ -38,7 +35,7 @@ auto testPass(std::optional<TestRenderer>& renderer, VulkanBackend& backend, Ren
     pass.pass.debugName = "Test pass";
     pass.pass.pipeline = renderer->pipeline;
 
-    pass.pass.beginRendering = [&backend](VkCommandBuffer cmd, CompiledRenderGraph&)
+    setBeginRendering(graph, pass, [&backend](VkCommandBuffer cmd, CompiledRenderGraph&)
     {
         const VkExtent2D swapchainSize = {
             static_cast<u32>(backend.viewport.width),
@@ -48,10 +45,11 @@ auto testPass(std::optional<TestRenderer>& renderer, VulkanBackend& backend, Ren
             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
         const auto renderingInfo = vkutil::init::renderingInfo(swapchainSize, &colorAttachmentInfo, 1, nullptr);
         vkCmdBeginRendering(cmd, &renderingInfo);
-    };
+    });
 
-    pass.pass.draw = [](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
+    setDraw(graph, pass, [](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
     {
         vkCmdDraw(cmd, 3, 1, 0, 0);
-    };
+        pass.drawCalls++;
+    });
 }
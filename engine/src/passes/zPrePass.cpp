@@ -21,10 +21,6 @@ auto initZPrePass(VulkanBackend& backend) -> ZPrePassRenderer
 
     return ZPrePassRenderer{
         .pipeline = PipelineBuilder(backend)
-            .addDescriptorLayouts({
-                backend.sceneDescriptorSetLayout,
-                backend.bindlessResources->bindlessTexDescLayout
-            })
             .addPushConstants({
                 VkPushConstantRange{
                     .stageFlags = VK_SHADER_STAGE_ALL,
@@ -54,7 +50,7 @@ auto initZPrePass(VulkanBackend& backend) -> ZPrePassRenderer
 }
 
 auto zPrePass(std::optional<ZPrePassRenderer>& renderer, VulkanBackend& backend, RenderGraph& graph,
-    RenderGraphResource<Buffer> culledDraws)
+    const SceneUploadRenderGraphData& sceneData, RenderGraphResource<Buffer> culledDraws)
     -> ZPrePassRenderGraphData
 {
     if (!renderer)
@@ -67,12 +63,12 @@ auto zPrePass(std::optional<ZPrePassRenderer>& renderer, VulkanBackend& backend,
     pass.pass.pipeline = renderer->pipeline;
 
     ZPrePassRenderGraphData data = {
-        .depthMap = readResource<BindlessTexture>(graph, pass,
-            importResource(graph, pass, &renderer->depthMap), VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL),
+        .depthMap = writeResource<BindlessTexture>(graph, pass,
+            importResource(graph, pass, &renderer->depthMap), ResourceUsage::DepthAttachmentWrite),
     };
-    culledDraws = readResource<Buffer>(graph, pass, culledDraws);
+    culledDraws = readResource<Buffer>(graph, pass, culledDraws, ResourceUsage::IndirectRead);
 
-    pass.pass.beginRendering = [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
+    setBeginRendering(graph, pass, [data, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph)
     {
         const VkExtent2D swapchainSize = {
             static_cast<u32>(backend.viewport.width),
@@ -83,16 +79,16 @@ auto zPrePass(std::optional<ZPrePassRenderer>& renderer, VulkanBackend& backend,
         auto depthAttachmentInfo = vkutil::init::renderingDepthAttachmentInfo(depthMap.view);
         const auto renderingInfo = vkutil::init::renderingInfo(swapchainSize, nullptr, 0, &depthAttachmentInfo);
         vkCmdBeginRendering(cmd, &renderingInfo);
-    };
+    });
 
-    pass.pass.draw = [culledDraws, &backend](VkCommandBuffer cmd, CompiledRenderGraph& graph, RenderPass& pass,
-        Scene& scene)
+    setDraw(graph, pass, [culledDraws, modelData = sceneData.modelData, &backend](VkCommandBuffer cmd,
+        CompiledRenderGraph& graph, RenderPass& pass, Scene& scene)
     {
         ZoneScopedCpuGpuAuto("Z Pre pass", backend.currentFrame());
 
         const ZPrePassPushConstants pushConstants = {
             .vertexBufferAddr = backend.getBufferDeviceAddress(scene.vertexBuffer.buffer),
-            .perModelDataBufferAddr = backend.getBufferDeviceAddress(scene.perModelBuffer.buffer),
+            .perModelDataBufferAddr = modelData,
         };
         vkCmdPushConstants(cmd, pass.pipeline->pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(pushConstants),
             &pushConstants);
@@ -101,7 +97,8 @@ auto zPrePass(std::optional<ZPrePassRenderer>& renderer, VulkanBackend& backend,
         vkCmdBindIndexBuffer(cmd, scene.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
         vkCmdDrawIndexedIndirect(cmd, *getResource<Buffer>(graph, culledDraws), 0, scene.meshes.size(),
             sizeof(VkDrawIndexedIndirectCommand));
-    };
+        pass.drawCalls += static_cast<u32>(scene.meshes.size());
+    });
 
     return data;
 }
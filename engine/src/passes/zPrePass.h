@@ -1,5 +1,6 @@
 #pragma once
 
+#include "passes/sceneUpload.h"
 #include "renderGraph.h"
 #include "rhi/vulkan/bindless.h"
 #include "rhi/vulkan/utils/buffer.h"
@@ -17,5 +18,5 @@ struct ZPrePassRenderGraphData
 
 [[nodiscard]]
 auto zPrePass(std::optional<ZPrePassRenderer>& renderer, VulkanBackend& backend, RenderGraph& graph,
-    RenderGraphResource<Buffer> culledDraws)
+    const SceneUploadRenderGraphData& sceneData, RenderGraphResource<Buffer> culledDraws)
     -> ZPrePassRenderGraphData;
@@ -2,13 +2,19 @@
 
 #include "renderGraph.h"
 
-#include <limits>
+#include "rhi/vulkan/backend.h"
+#include "rhi/vulkan/utils/inits.h"
 
-auto getHandle(RenderGraph& graph) -> Handle
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <print>
+
+auto getHandle(RenderGraph& graph, u32 resource) -> Handle
 {
-    const auto handle = graph.resources.size();
-    graph.resources.push_back(nullptr);
-    graph.layouts.push_back(VK_IMAGE_LAYOUT_UNDEFINED);
+    const auto handle = static_cast<Handle>(graph.handleResources.size());
+    graph.handleResources.push_back(resource);
     return handle;
 }
 
@@ -21,29 +27,408 @@ auto createPass(RenderGraph& graph) -> RenderGraph::Node&
     return node;
 }
 
-auto compile(VulkanBackend& backend, RenderGraph&& graph) -> CompiledRenderGraph
+auto nodeIndex(RenderGraph& graph, RenderGraph::Node& node) -> u32
+{
+    return static_cast<u32>(&node - graph.nodes.data());
+}
+
+auto describeResource(VulkanBackend& backend, Buffer* buffer) -> ResourceDesc
+{
+    return ResourceDesc{.kind = ResourceKind::Buffer};
+}
+
+auto describeResource(VulkanBackend& backend, BindlessTexture* texture) -> ResourceDesc
+{
+    const auto& tex = backend.bindlessResources->getTexture(*texture);
+    return ResourceDesc{
+        .kind = ResourceKind::Texture,
+        .format = tex.image.format,
+        .extent = tex.image.extent,
+    };
+}
+
+auto resetRenderGraph(RenderGraph& graph) -> void
+{
+    graph.nodes.clear();
+    graph.accesses.clear();
+    graph.resources.clear();
+    graph.handleResources.clear();
+    graph.arena.reset();
+}
+
+template <typename T>
+static auto hashCombine(u64 hash, const T& value) -> u64
+{
+    // FNV-1a
+    const auto* bytes = reinterpret_cast<const u8*>(&value);
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// VkBuffer or VkImage behind a resource, which is what the barriers are recorded against
+static auto underlyingHandle(const RenderGraph& graph, const ResourceRef& data) -> uintptr_t
+{
+    if (const auto* buffer = std::get_if<Buffer*>(&data))
+    {
+        return reinterpret_cast<uintptr_t>(**buffer);
+    }
+    const Texture& texture = graph.backend.bindlessResources->getTexture(*std::get<BindlessTexture*>(data));
+    return reinterpret_cast<uintptr_t>(texture.image.image);
+}
+
+auto structureHash(const RenderGraph& graph) -> u64
+{
+    ZoneScoped;
+
+    // Everything that ends up in the barriers has to be hashed: which resource is accessed, by which node and
+    // how. Pipelines are hashed as well, both so that a swapped pipeline does not go unnoticed and because the
+    // bind point decides the shader stages used in the barriers.
+    u64 hash = 0xcbf29ce484222325ull;
+    hash = hashCombine(hash, graph.nodes.size());
+    for (const auto& node : graph.nodes)
+    {
+        // Layouts are created with their pipeline, hashing them doesn't wait for the compile
+        hash = hashCombine(hash, node.pass.pipeline ? node.pass.pipeline->pipelineLayout : VK_NULL_HANDLE);
+        hash = hashCombine(hash, static_cast<bool>(node.pass.beginRendering));
+    }
+    hash = hashCombine(hash, graph.resources.size());
+    for (const auto& resource : graph.resources)
+    {
+        hash = hashCombine(hash, resource.data.index());
+        hash = hashCombine(hash, std::visit([](auto* data) { return reinterpret_cast<uintptr_t>(data); },
+            resource.data));
+        // Reallocated in place keeps the pointer but not the handle
+        hash = hashCombine(hash, underlyingHandle(graph, resource.data));
+        hash = hashCombine(hash, resource.initialLayout);
+        hash = hashCombine(hash, resource.desc.format);
+        hash = hashCombine(hash, resource.desc.extent);
+    }
+    for (const auto& access : graph.accesses)
+    {
+        hash = hashCombine(hash, access.node);
+        hash = hashCombine(hash, access.oldHandle);
+        hash = hashCombine(hash, access.newHandle);
+        hash = hashCombine(hash, access.usage);
+        hash = hashCombine(hash, access.write);
+    }
+
+    return hash;
+}
+
+namespace
+{
+struct UsageInfo
+{
+    Layout layout;
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    // VkImageUsageFlags or VkBufferUsageFlags, depending on the resource kind
+    u32 usageFlags;
+};
+
+auto usageInfo(ResourceUsage usage, ResourceKind kind, VkPipelineStageFlags2 shaderStages) -> UsageInfo
+{
+    const bool texture = kind == ResourceKind::Texture;
+    constexpr VkPipelineStageFlags2 depthStages =
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+    switch (usage)
+    {
+        case ResourceUsage::None:
+            return {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, 0};
+        case ResourceUsage::SampledRead:
+            return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, shaderStages, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                VK_IMAGE_USAGE_SAMPLED_BIT};
+        case ResourceUsage::DepthSampledRead:
+            return {VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, shaderStages, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                VK_IMAGE_USAGE_SAMPLED_BIT};
+        case ResourceUsage::ColorAttachmentWrite:
+            return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+        case ResourceUsage::DepthAttachmentRead:
+            return {VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, depthStages | shaderStages,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+        case ResourceUsage::DepthAttachmentWrite:
+            return {VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, depthStages,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+        case ResourceUsage::StorageRead:
+            return {VK_IMAGE_LAYOUT_GENERAL, shaderStages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                texture ? static_cast<u32>(VK_IMAGE_USAGE_STORAGE_BIT)
+                        : static_cast<u32>(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)};
+        case ResourceUsage::StorageWrite:
+            return {VK_IMAGE_LAYOUT_GENERAL, shaderStages,
+                VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                texture ? static_cast<u32>(VK_IMAGE_USAGE_STORAGE_BIT)
+                        : static_cast<u32>(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)};
+        case ResourceUsage::IndirectRead:
+            return {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT};
+        case ResourceUsage::TransferRead:
+            return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                VK_ACCESS_2_TRANSFER_READ_BIT,
+                texture ? static_cast<u32>(VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+                        : static_cast<u32>(VK_BUFFER_USAGE_TRANSFER_SRC_BIT)};
+        case ResourceUsage::TransferWrite:
+            return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                texture ? static_cast<u32>(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+                        : static_cast<u32>(VK_BUFFER_USAGE_TRANSFER_DST_BIT)};
+    }
+
+    assert(false);
+    return {};
+}
+
+auto shaderStages(const RenderPass& pass) -> VkPipelineStageFlags2
+{
+    if (!pass.pipeline)
+    {
+        // CPU side pass, no idea what it records
+        return VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    }
+    if (pass.pipeline->pipelineBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE)
+    {
+        return VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    }
+    return VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+}
+
+auto isDepthFormat(VkFormat format) -> bool
+{
+    return format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+        format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+// Synchronisation state of a single resource while walking the accesses
+struct ResourceState
+{
+    Layout layout;
+    // Last write, has to be made available before anything else touches the resource
+    VkPipelineStageFlags2 writeStages;
+    VkAccessFlags2 writeAccess;
+    // Everything that has already waited for the last write
+    VkPipelineStageFlags2 readStages;
+    VkAccessFlags2 readAccess;
+    Handle latest;
+};
+}  // namespace
+
+// Every handle a cached graph's barriers name has to still be one of the graph's resources
+static auto barriersMatchResources(const RenderGraph& graph, const CompiledRenderGraph& compiledGraph) -> bool
+{
+    auto isResource = [&](uintptr_t handle)
+    {
+        return std::ranges::any_of(graph.resources, [&](const RenderGraph::Resource& resource)
+        {
+            return underlyingHandle(graph, resource.data) == handle;
+        });
+    };
+    for (const auto& node : compiledGraph.nodes)
+    {
+        for (const auto& barrier : node.bufferBarriers)
+        {
+            if (!isResource(reinterpret_cast<uintptr_t>(barrier.buffer)))
+            {
+                return false;
+            }
+        }
+        for (const auto& barrier : node.imageBarriers)
+        {
+            if (!isResource(reinterpret_cast<uintptr_t>(barrier.image)))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+auto compile(VulkanBackend& backend, RenderGraph& graph, RenderGraphCache& cache) -> CompiledRenderGraph&
 {
-    CompiledRenderGraph compiledGraph;
+    ZoneScoped;
+
+    const u64 hash = structureHash(graph);
+    const bool cached = cache.compiled && cache.compiled->structureHash == hash;
+    if (!cache.compiled)
+    {
+        cache.compiled.emplace();
+    }
+    auto& compiledGraph = *cache.compiled;
+
+    // NOTE: passes are re-declared every frame and can capture per-frame state, so they always get swapped in
+    compiledGraph.nodes.resize(graph.nodes.size());
+    for (u32 i = 0; i < graph.nodes.size(); i++)
+    {
+        compiledGraph.nodes[i].pass = std::move(graph.nodes[i].pass);
+    }
+    compiledGraph.resources.resize(graph.handleResources.size());
+    for (Handle handle = 0; handle < graph.handleResources.size(); handle++)
+    {
+        compiledGraph.resources[handle] = graph.resources[graph.handleResources[handle]].data;
+    }
+
+    if (cached)
+    {
+        // Fails when a resource was reallocated without changing the hash
+        assert(barriersMatchResources(graph, compiledGraph));
+        cache.hits++;
+        return compiledGraph;
+    }
+    cache.misses++;
+
+    for (auto& compiledNode : compiledGraph.nodes)
+    {
+        compiledNode.imageBarriers.clear();
+        compiledNode.bufferBarriers.clear();
+        compiledNode.memoryBarriers.clear();
+    }
+
+    std::vector<ResourceState> states;
+    states.reserve(graph.resources.size());
+    for (u32 i = 0; i < graph.resources.size(); i++)
+    {
+        // Whatever happened before the graph (previous frame, uploads) is unknown, so the first access waits on
+        // everything
+        states.push_back({
+            .layout = graph.resources[i].initialLayout,
+            .writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .readStages = VK_PIPELINE_STAGE_2_NONE,
+            .readAccess = VK_ACCESS_2_NONE,
+            .latest = InvalidHandle,
+        });
+        graph.resources[i].desc.requiredUsage = 0;
+    }
+    for (Handle handle = 0; handle < graph.handleResources.size(); handle++)
+    {
+        auto& state = states[graph.handleResources[handle]];
+        if (state.latest == InvalidHandle)
+        {
+            // The imported handle is always the first one of its resource
+            state.latest = handle;
+        }
+    }
 
-    for (auto& node : graph.nodes)
+    for (const auto& access : graph.accesses)
     {
-        auto& compiledNode = compiledGraph.nodes.emplace_back();
-        compiledNode.pass = node.pass;
+        const u32 resourceIndex = graph.handleResources[access.oldHandle];
+        auto& resource = graph.resources[resourceIndex];
+        auto& state = states[resourceIndex];
+        auto& compiledNode = compiledGraph.nodes[access.node];
+        const auto& pass = compiledNode.pass;
 
-        u32 read = 0;
-        u32 write = 0;
-        while (read + write < node.reads.size() + node.writes.size())
+        if (access.write && access.oldHandle != state.latest)
         {
-            const auto newReadHandle = read < node.reads.size() ? node.reads[read].newHandle : std::numeric_limits<u32>::max();
-            const auto newWriteHandle = write < node.writes.size() ? node.writes[write].newHandle : std::numeric_limits<u32>::max();
-            const auto& olderAccess = newReadHandle < newWriteHandle ? node.reads[read] : node.writes[write];
-            (newReadHandle < newWriteHandle ? read : write) += 1;
+            std::println("[render graph] WARNING: \"{}\" writes to a stale version of a resource ({} instead of {}), "
+                "the newer write will be lost", pass.debugName, access.oldHandle, state.latest);
+        }
+        state.latest = access.newHandle;
 
-            olderAccess.transition(backend, compiledNode, graph.resources[olderAccess.newHandle],
-                graph.layouts[olderAccess.oldHandle], graph.layouts[olderAccess.newHandle]);
+        const auto info = usageInfo(access.usage, resource.desc.kind, shaderStages(pass));
+        if (access.usage == ResourceUsage::None)
+        {
+            continue;
         }
+        resource.desc.requiredUsage |= info.usageFlags;
+
+        const bool texture = resource.desc.kind == ResourceKind::Texture;
+        const bool layoutChange = texture && state.layout != info.layout;
+
+        VkPipelineStageFlags2 srcStages;
+        VkAccessFlags2 srcAccess;
+        if (access.write || layoutChange)
+        {
+            // WAW/WAR, or a layout transition, which is a write as well. Reads only need an execution dependency.
+            srcStages = state.writeStages | state.readStages;
+            srcAccess = state.writeAccess;
+
+            state.writeStages = info.stages;
+            state.writeAccess = access.write ? info.access : VK_ACCESS_2_NONE;
+            state.readStages = access.write ? VK_PIPELINE_STAGE_2_NONE : info.stages;
+            state.readAccess = access.write ? VK_ACCESS_2_NONE : info.access;
+        }
+        else
+        {
+            // RAW, only stages/accesses that have not yet waited for the last write need a barrier
+            if ((info.stages & ~state.readStages) == 0 && (info.access & ~state.readAccess) == 0)
+            {
+                continue;
+            }
+            srcStages = state.writeStages;
+            srcAccess = state.writeAccess;
+
+            state.readStages |= info.stages;
+            state.readAccess |= info.access;
+        }
+        if (srcStages == VK_PIPELINE_STAGE_2_NONE)
+        {
+            srcStages = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
+        }
+
+        if (texture)
+        {
+            const auto* data = std::get<BindlessTexture*>(resource.data);
+            const Texture& tex = backend.bindlessResources->getTexture(*data);
+
+            const VkImageAspectFlags aspectMask = isDepthFormat(resource.desc.format)
+                ? VK_IMAGE_ASPECT_DEPTH_BIT
+                : VK_IMAGE_ASPECT_COLOR_BIT;
+            compiledNode.imageBarriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                .srcStageMask = srcStages,
+                .srcAccessMask = srcAccess,
+                .dstStageMask = info.stages,
+                .dstAccessMask = info.access,
+                .oldLayout = state.layout,
+                .newLayout = info.layout,
+                .image = tex.image.image,
+                .subresourceRange = vkutil::init::imageSubresourceRange(aspectMask),
+            });
+            state.layout = info.layout;
+        }
+        else
+        {
+            compiledNode.bufferBarriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                .srcStageMask = srcStages,
+                .srcAccessMask = srcAccess,
+                .dstStageMask = info.stages,
+                .dstAccessMask = info.access,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = *std::get<Buffer*>(resource.data),
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            });
+        }
+    }
+
+    for (const auto& resource : graph.resources)
+    {
+        if (resource.desc.kind != ResourceKind::Texture)
+        {
+            continue;
+        }
+        const Texture& tex = backend.bindlessResources->getTexture(*std::get<BindlessTexture*>(resource.data));
+        const u32 missingUsage = resource.desc.requiredUsage & ~tex.image.usage;
+        if (tex.image.usage != 0 && missingUsage != 0)
+        {
+            std::println("[render graph] ERROR: texture {} is used as 0x{:x} but is missing usage flags 0x{:x}",
+                *std::get<BindlessTexture*>(resource.data), resource.desc.requiredUsage, missingUsage);
+        }
+    }
+    compiledGraph.descs.resize(graph.handleResources.size());
+    for (Handle handle = 0; handle < graph.handleResources.size(); handle++)
+    {
+        compiledGraph.descs[handle] = graph.resources[graph.handleResources[handle]].desc;
     }
-    compiledGraph.resources = graph.resources;
+    compiledGraph.structureHash = hash;
 
     return compiledGraph;
 }
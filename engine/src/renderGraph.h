@@ -1,16 +1,23 @@
 #pragma once
 
 #include "engine.h"
+#include "memory/linearArena.h"
 #include "rhi/renderpass.h"
+#include "rhi/vulkan/bindless.h"
+#include "rhi/vulkan/utils/buffer.h"
 
 #include <vulkan/vulkan_core.h>
 
-#include <functional>
+#include <concepts>
+#include <limits>
+#include <optional>
+#include <variant>
 #include <vector>
 
 class VulkanBackend;
 
 using Handle = u32;
+constexpr Handle InvalidHandle = std::numeric_limits<Handle>::max();
 // TODO: Make this non VK specific
 using Layout = VkImageLayout;
 
@@ -19,6 +26,79 @@ using ImageBarrier = VkImageMemoryBarrier2;
 using BufferBarrier = VkBufferMemoryBarrier2;
 using MemoryBarrier = VkMemoryBarrier2;
 
+enum class ResourceKind : u8
+{
+    Buffer,
+    Texture,
+};
+
+// Kind tag of every type the graph can track. Anything without a specialisation can't be imported.
+template <typename T>
+struct ResourceTraits;
+
+template <>
+struct ResourceTraits<Buffer>
+{
+    static constexpr ResourceKind kind = ResourceKind::Buffer;
+};
+
+template <>
+struct ResourceTraits<BindlessTexture>
+{
+    static constexpr ResourceKind kind = ResourceKind::Texture;
+};
+
+template <typename T>
+concept GraphResource = requires { { ResourceTraits<T>::kind } -> std::convertible_to<ResourceKind>; };
+
+template <GraphResource T>
+struct RenderGraphResource
+{
+    static constexpr ResourceKind kind = ResourceTraits<T>::kind;
+
+    Handle handle = InvalidHandle;
+
+    [[nodiscard]]
+    auto valid() const -> bool
+    {
+        return handle != InvalidHandle;
+    }
+};
+
+using ResourceRef = std::variant<Buffer*, BindlessTexture*>;
+
+// How a pass uses a resource. Layouts, pipeline stages, access masks and the usage flags a resource has to be
+// created with are all derived from this, see compile().
+enum class ResourceUsage : u8
+{
+    // Imported and not touched yet
+    None,
+
+    SampledRead,
+    DepthSampledRead,
+    ColorAttachmentWrite,
+    // Depth test without a prior clear, the depth buffer can still be sampled in the same pass
+    DepthAttachmentRead,
+    DepthAttachmentWrite,
+    StorageRead,
+    StorageWrite,
+    IndirectRead,
+    TransferRead,
+    TransferWrite,
+};
+
+struct ResourceDesc
+{
+    ResourceKind kind;
+
+    // Textures only
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent3D extent = {};
+
+    // VkImageUsageFlags or VkBufferUsageFlags, depending on kind. Accumulated from all accesses.
+    u32 requiredUsage = 0;
+};
+
 struct CompiledRenderGraph
 {
     struct Node
@@ -30,7 +110,12 @@ struct CompiledRenderGraph
     };
 
     std::vector<Node> nodes;
-    std::vector<void*> resources;
+    // Indexed by handle
+    std::vector<ResourceRef> resources;
+    std::vector<ResourceDesc> descs;
+
+    // Hash of the graph structure this was compiled from, see structureHash()
+    u64 structureHash = 0;
 };
 
 struct RenderGraph
@@ -39,24 +124,51 @@ struct RenderGraph
 
     struct ResourceAccess
     {
+        u32 node;
         Handle oldHandle;
         Handle newHandle;
-        std::function<void(VulkanBackend& backend, CompiledRenderGraph::Node&, void*, Layout, Layout)> transition;
+        ResourceUsage usage;
+        bool write;
+    };
+    struct Resource
+    {
+        ResourceRef data;
+        ResourceDesc desc;
+        Layout initialLayout;
     };
     struct Node
     {
-        std::vector<ResourceAccess> reads;
-        std::vector<ResourceAccess> writes;
         RenderPass pass;
     };
 
+    // NOTE: the graph is redeclared every frame, so everything is kept in flat vectors that get cleared, but
+    // not freed, by resetRenderGraph(). Accesses are stored in declaration order, which is also handle order.
     std::vector<Node> nodes;
-    // TODO: change void* to std::variant or better yet -- concepts
-    std::vector<void*> resources;
-    std::vector<Layout> layouts;
+    std::vector<ResourceAccess> accesses;
+    // One per imported resource, every handle (version) points to one of these
+    std::vector<Resource> resources;
+    std::vector<u32> handleResources;
+
+    // Captured state of the pass callbacks. Lives until the next resetRenderGraph(), which is also when the
+    // compiled graph gets its passes replaced.
+    LinearArena arena;
+};
+
+// Keeps the last compiled graph around. When a newly declared graph has the same structure hash its barriers
+// are reused and only the passes are swapped in, so recompiling every frame is close to free.
+struct RenderGraphCache
+{
+    std::optional<CompiledRenderGraph> compiled;
+
+    u64 hits = 0;
+    u64 misses = 0;
 };
 
-auto getHandle(RenderGraph& graph) -> Handle;
+auto getHandle(RenderGraph& graph, u32 resource) -> Handle;
+auto nodeIndex(RenderGraph& graph, RenderGraph::Node& node) -> u32;
+
+auto describeResource(VulkanBackend& backend, Buffer* buffer) -> ResourceDesc;
+auto describeResource(VulkanBackend& backend, BindlessTexture* texture) -> ResourceDesc;
 
 // TODO: implement
 //template<typename T>
@@ -67,80 +179,85 @@ auto getHandle(RenderGraph& graph) -> Handle;
 //    return T{};
 //}
 
-template <typename T>
-using RenderGraphResource = Handle;
-
-template <typename T>
+template <GraphResource T>
 [[nodiscard]]
 auto importResource(RenderGraph& graph, RenderGraph::Node& node, T* data, Layout layout = VK_IMAGE_LAYOUT_UNDEFINED)
     -> RenderGraphResource<T>
 {
-    auto handle = getHandle(graph);
-    graph.resources[handle] = data;
-    graph.layouts[handle] = layout;
-    return handle;
+    const auto resource = static_cast<u32>(graph.resources.size());
+    const auto handle = getHandle(graph, resource);
+    graph.resources.push_back({
+        .data = data,
+        .desc = describeResource(graph.backend, data),
+        .initialLayout = layout,
+    });
+    return {handle};
 }
 
-template <typename T>
-auto readResource(RenderGraph& graph, RenderGraph::Node& node, RenderGraphResource<T> handle,
-    Layout layout = VK_IMAGE_LAYOUT_UNDEFINED)
+template <GraphResource T>
+auto accessResource(RenderGraph& graph, RenderGraph::Node& node, RenderGraphResource<T> resource,
+    ResourceUsage usage, bool write)
     -> RenderGraphResource<T>
 {
-    auto newHandle = getHandle(graph);
-    graph.resources[newHandle] = graph.resources[handle];
-    graph.layouts[newHandle] = layout;
-
-    node.reads.push_back({
-        .oldHandle = handle,
+    const auto newHandle = getHandle(graph, graph.handleResources[resource.handle]);
+    graph.accesses.push_back({
+        .node = nodeIndex(graph, node),
+        .oldHandle = resource.handle,
         .newHandle = newHandle,
-        .transition = [](VulkanBackend& backend, CompiledRenderGraph::Node& compiledNode, void* data, Layout oldLayout,
-            Layout newLayout)
-        {
-            addTransition<T>(backend, compiledNode, static_cast<T*>(data), oldLayout, newLayout);
-        }
+        .usage = usage,
+        .write = write,
     });
+    return {newHandle};
+}
 
-    return newHandle;
+template <GraphResource T>
+auto readResource(RenderGraph& graph, RenderGraph::Node& node, RenderGraphResource<T> resource,
+    ResourceUsage usage)
+    -> RenderGraphResource<T>
+{
+    return accessResource(graph, node, resource, usage, false);
 }
 
-template <typename T>
-auto writeResource(RenderGraph& graph, RenderGraph::Node& node, RenderGraphResource<T> handle,
-    Layout layout = VK_IMAGE_LAYOUT_UNDEFINED)
+template <GraphResource T>
+auto writeResource(RenderGraph& graph, RenderGraph::Node& node, RenderGraphResource<T> resource,
+    ResourceUsage usage)
     -> RenderGraphResource<T>
 {
-    auto newHandle = getHandle(graph);
-    graph.resources[newHandle] = graph.resources[handle];
-    graph.layouts[newHandle] = layout;
+    return accessResource(graph, node, resource, usage, true);
+}
 
-    node.writes.push_back({
-        .oldHandle = handle,
-        .newHandle = newHandle,
-        .transition = [](VulkanBackend& backend, CompiledRenderGraph::Node& compiledNode, void* data, Layout oldLayout,
-            Layout newLayout)
-        {
-            addTransition<T>(backend, compiledNode, static_cast<T*>(data), oldLayout, newLayout);
-        }
-    });
+template <typename F>
+auto setBeginRendering(RenderGraph& graph, RenderGraph::Node& node, F&& beginRendering) -> void
+{
+    node.pass.beginRendering = decltype(node.pass.beginRendering)::bind(graph.arena,
+        std::forward<F>(beginRendering));
+}
 
-    return newHandle;
+template <typename F>
+auto setDraw(RenderGraph& graph, RenderGraph::Node& node, F&& draw) -> void
+{
+    node.pass.draw = decltype(node.pass.draw)::bind(graph.arena, std::forward<F>(draw));
 }
 
-template <typename T>
-auto addTransition(VulkanBackend& backend, CompiledRenderGraph::Node& compiledNode, T* resource, Layout oldLayout,
-    Layout newLayout)
-    -> void
+template <GraphResource T>
+[[nodiscard]]
+auto getResource(CompiledRenderGraph& graph, RenderGraphResource<T> resource) -> T*
 {
+    // The handle type already guarantees the kind, std::get additionally catches handles from another graph
+    return std::get<T*>(graph.resources[resource.handle]);
 }
 
-template <typename T>
+template <GraphResource T>
 [[nodiscard]]
-auto getResource(CompiledRenderGraph& graph, RenderGraphResource<T> handle) -> T*
+auto getResourceDesc(CompiledRenderGraph& graph, RenderGraphResource<T> resource) -> const ResourceDesc&
 {
-    // TODO: would be nice to implement some sort of ensurance that this casting is valid
-    return static_cast<T*>(graph.resources[handle]);
+    return graph.descs[resource.handle];
 }
 
 [[nodiscard]]
 auto createPass(RenderGraph& graph) -> RenderGraph::Node&;
+auto resetRenderGraph(RenderGraph& graph) -> void;
+[[nodiscard]]
+auto structureHash(const RenderGraph& graph) -> u64;
 [[nodiscard]]
-auto compile(VulkanBackend& backend, RenderGraph&& graph) -> CompiledRenderGraph;
\ No newline at end of file
+auto compile(VulkanBackend& backend, RenderGraph& graph, RenderGraphCache& cache) -> CompiledRenderGraph&;
@@ -0,0 +1,101 @@
+#include "renderGraphStats.h"
+
+#include <algorithm>
+#include <cstring>
+
+auto addPassSample(RenderGraphStats& stats, u32 node, const char* name, const PassSample& sample) -> void
+{
+    if (node >= stats.passes.size())
+    {
+        stats.passes.resize(node + 1);
+    }
+
+    auto& pass = stats.passes[node];
+    if (strcmp(pass.name, name) != 0)
+    {
+        pass = PassStats{.name = name};
+    }
+
+    pass.samples[pass.next] = sample;
+    pass.next = (pass.next + 1) % PassStats::WindowSize;
+    pass.count = std::min(pass.count + 1, PassStats::WindowSize);
+}
+
+auto truncatePassStats(RenderGraphStats& stats, u32 nodeCount) -> void
+{
+    if (nodeCount < stats.passes.size())
+    {
+        stats.passes.resize(nodeCount);
+    }
+    stats.sampledFrames++;
+}
+
+auto findPassStats(const RenderGraphStats& stats, std::string_view name) -> const PassStats*
+{
+    for (const auto& pass : stats.passes)
+    {
+        if (name == pass.name)
+        {
+            return &pass;
+        }
+    }
+    return nullptr;
+}
+
+auto latestSample(const PassStats& pass) -> const PassSample&
+{
+    return pass.samples[(pass.next + PassStats::WindowSize - 1) % PassStats::WindowSize];
+}
+
+auto averageSample(const PassStats& pass) -> PassSample
+{
+    PassSample sum = {};
+    for (u32 i = 0; i < pass.count; i++)
+    {
+        const auto& sample = pass.samples[i];
+        sum.gpuMs += sample.gpuMs;
+        sum.cpuMs += sample.cpuMs;
+        sum.drawCalls += sample.drawCalls;
+        sum.barriers += sample.barriers;
+        sum.primitives += sample.primitives;
+        sum.clippedPrimitives += sample.clippedPrimitives;
+        sum.vertexInvocations += sample.vertexInvocations;
+        sum.fragmentInvocations += sample.fragmentInvocations;
+        sum.computeInvocations += sample.computeInvocations;
+    }
+    if (pass.count == 0)
+    {
+        return sum;
+    }
+
+    return PassSample{
+        .gpuMs = sum.gpuMs / pass.count,
+        .cpuMs = sum.cpuMs / pass.count,
+        .drawCalls = sum.drawCalls / pass.count,
+        .barriers = sum.barriers / pass.count,
+        .primitives = sum.primitives / pass.count,
+        .clippedPrimitives = sum.clippedPrimitives / pass.count,
+        .vertexInvocations = sum.vertexInvocations / pass.count,
+        .fragmentInvocations = sum.fragmentInvocations / pass.count,
+        .computeInvocations = sum.computeInvocations / pass.count,
+    };
+}
+
+auto maxSample(const PassStats& pass) -> PassSample
+{
+    PassSample result = {};
+    for (u32 i = 0; i < pass.count; i++)
+    {
+        const auto& sample = pass.samples[i];
+        result.gpuMs = std::max(result.gpuMs, sample.gpuMs);
+        result.cpuMs = std::max(result.cpuMs, sample.cpuMs);
+        result.drawCalls = std::max(result.drawCalls, sample.drawCalls);
+        result.barriers = std::max(result.barriers, sample.barriers);
+        result.primitives = std::max(result.primitives, sample.primitives);
+        result.clippedPrimitives = std::max(result.clippedPrimitives, sample.clippedPrimitives);
+        result.vertexInvocations = std::max(result.vertexInvocations, sample.vertexInvocations);
+        result.fragmentInvocations = std::max(result.fragmentInvocations, sample.fragmentInvocations);
+        result.computeInvocations = std::max(result.computeInvocations, sample.computeInvocations);
+    }
+    return result;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "engine.h"
+
+#include <array>
+#include <string_view>
+#include <vector>
+
+// One frame worth of measurements of a single render graph node
+struct PassSample
+{
+    f64 gpuMs = 0.0;
+    // Time spent recording the node, barriers and callbacks included
+    f64 cpuMs = 0.0;
+
+    u32 drawCalls = 0;
+    u32 barriers = 0;
+
+    // Pipeline statistics, zero when the device doesn't support them
+    u64 primitives = 0;
+    u64 clippedPrimitives = 0;
+    u64 vertexInvocations = 0;
+    u64 fragmentInvocations = 0;
+    u64 computeInvocations = 0;
+};
+
+struct PassStats
+{
+    static constexpr u32 WindowSize = 120;
+
+    const char* name = "";
+
+    // Ring buffer of the last WindowSize samples, oldest one at `next` once full
+    std::array<PassSample, WindowSize> samples = {};
+    u32 next = 0;
+    u32 count = 0;
+};
+
+// Rolling per-pass statistics gathered by the render graph executor. Samples lag behind by MaxFramesInFlight
+// frames as they are only read back once the GPU is done with the frame.
+struct RenderGraphStats
+{
+    // Indexed by node. A node whose name changes between frames starts a fresh window.
+    std::vector<PassStats> passes;
+
+    u64 sampledFrames = 0;
+};
+
+auto addPassSample(RenderGraphStats& stats, u32 node, const char* name, const PassSample& sample) -> void;
+// Drops nodes that were not part of the last sampled graph
+auto truncatePassStats(RenderGraphStats& stats, u32 nodeCount) -> void;
+
+[[nodiscard]]
+auto findPassStats(const RenderGraphStats& stats, std::string_view name) -> const PassStats*;
+[[nodiscard]]
+auto latestSample(const PassStats& pass) -> const PassSample&;
+[[nodiscard]]
+auto averageSample(const PassStats& pass) -> PassSample;
+[[nodiscard]]
+auto maxSample(const PassStats& pass) -> PassSample;
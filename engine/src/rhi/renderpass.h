@@ -1,22 +1,66 @@
 #pragma once
 
+#include "memory/linearArena.h"
 #include "vulkan/pipelineBuilder.h"
 
 #include <vulkan/vulkan_core.h>
 
-#include <functional>
 #include <optional>
-#include <string>
+#include <type_traits>
+#include <utility>
 
 struct CompiledRenderGraph;
 struct Scene;
 
+// Non-owning, type-erased callable: a pointer to the captured state and a single function pointer to call it
+// with. The state itself lives in the render graph's arena, see setDraw()/setBeginRendering().
+template <typename Signature>
+struct PassCallback;
+
+template <typename R, typename... Args>
+struct PassCallback<R(Args...)>
+{
+    void* capture = nullptr;
+    R (*invoke)(void* capture, Args... args) = nullptr;
+
+    explicit operator bool() const
+    {
+        return invoke != nullptr;
+    }
+
+    auto operator()(Args... args) const -> R
+    {
+        return invoke(capture, std::forward<Args>(args)...);
+    }
+
+    template <typename F>
+    [[nodiscard]]
+    static auto bind(LinearArena& arena, F&& f) -> PassCallback
+    {
+        using Capture = std::decay_t<F>;
+        static_assert(std::is_trivially_destructible_v<Capture>,
+            "Captured state lives in an arena and is never destroyed, capture handles, pointers and PODs only");
+
+        return PassCallback{
+            .capture = arena.create<Capture>(std::forward<F>(f)),
+            .invoke = [](void* capture, Args... args) -> R
+            {
+                return (*static_cast<Capture*>(capture))(std::forward<Args>(args)...);
+            },
+        };
+    }
+};
+
 struct RenderPass
 {
-    std::string debugName;
+    const char* debugName = "";
 
     std::optional<Pipeline> pipeline;
+    // TEMP: each pass should bind whatever it needs itself
+    bool bindSceneDescriptors = true;
+    // Reported by the draw callback, only used for stats
+    u32 drawCalls = 0;
 
-    std::optional<std::function<void(VkCommandBuffer cmd, CompiledRenderGraph&)>> beginRendering = std::nullopt;
-    std::function<void(VkCommandBuffer cmd, CompiledRenderGraph&, RenderPass&, Scene&)> draw;
-};
\ No newline at end of file
+    PassCallback<void(VkCommandBuffer cmd, CompiledRenderGraph&)> beginRendering;
+    PassCallback<void(VkCommandBuffer cmd, CompiledRenderGraph&, RenderPass&, Scene&)> draw;
+};
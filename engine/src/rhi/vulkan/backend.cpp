@@ -7,6 +7,7 @@
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_vulkan.h"
+#include "memory/allocationCounter.h"
 #include "renderGraph.h"
 #include "result.hpp"
 #include "rhi/renderpass.h"
@@ -21,38 +22,86 @@
 
 #include <vulkan/vulkan_core.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <format>
 
-auto initVulkanBackend() -> result::result<VulkanBackend*, backendError>
+auto initVulkanBackend(BackendConfig config) -> result::result<VulkanBackend*, backendError>
 {
-    if (!glfwInit())
+    GLFWwindow* window = nullptr;
+    if (!config.headless)
     {
-        std::println("Failed initing GLFW");
-        return result::fail(backendError{});
-    }
+        if (!glfwInit())
+        {
+            std::println("Failed initing GLFW");
+            return result::fail(backendError{});
+        }
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-    GLFWwindow* window = glfwCreateWindow(1920, 1080, "Engine", NULL, NULL);
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+        window = glfwCreateWindow(config.width, config.height, "Engine", NULL, NULL);
+    }
 
-    VulkanBackend* backend = new VulkanBackend(window);
+    VulkanBackend* backend = new VulkanBackend(window, config);
 
     return backend;
 }
 
 auto VulkanBackend::newFrame() -> Frame
 {
+    FrameCtx& frameCtx = currentFrame();
+    {
+        ZoneScopedN("Wait for frame in flight");
+
+        // Everything allocated from the frame arena the last time this ctx was used might still be read by the
+        // GPU through staging copies, wait for it to retire before handing the memory out again
+        constexpr u64 timeoutNs = 100'000'000'000'000;
+        VK_CHECK(vkWaitForFences(device, 1, &frameCtx.renderFence, true, timeoutNs));
+        frameCtx.frameArena.reset();
+    }
+
+    {
+        ZoneScopedN("Release retired resources");
+
+        std::erase_if(retiredBuffers, [&](const RetiredBuffer& retired)
+        {
+            if (retired.frameNumber + MaxFramesInFlight > currentFrameNumber)
+            {
+                return false;
+            }
+            vmaDestroyBuffer(allocator, retired.buffer.buffer, retired.buffer.allocation);
+            return true;
+        });
+        std::erase_if(retiredTextures, [&](const RetiredTexture& retired)
+        {
+            if (retired.frameNumber + MaxFramesInFlight > currentFrameNumber)
+            {
+                return false;
+            }
+            textures->unloadRaw(retired.texture);
+            return true;
+        });
+        bindlessResources->update(currentFrameNumber);
+    }
+
+    if (shaderReloader)
+    {
+        shaderReloader->update(currentFrameNumber);
+    }
+
     return Frame{
         .stats =
             {
                 .startTime = std::chrono::high_resolution_clock::now(),
                 .frameIndex = currentFrameNumber,
-                .shutdownRequested = glfwWindowShouldClose(window),
+                .shutdownRequested = !headless && glfwWindowShouldClose(window),
                 .pastFrameDt = 0.f,
             },
-        .ctx = currentFrame(),
+        .ctx = frameCtx,
     };
 }
 
@@ -62,14 +111,23 @@ auto VulkanBackend::endFrame(Frame&& frame) -> FrameStats
     currentFrameNumber++;
     stats.finishedFrameCount++;
 
+    const u64 heapAllocations = heapAllocationCount();
+    stats.frameHeapAllocations = heapAllocations - stats.heapAllocationsAtFrameEnd;
+    stats.heapAllocationsAtFrameEnd = heapAllocations;
+    TracyPlot("Heap allocations per frame", static_cast<i64>(stats.frameHeapAllocations));
+    TracyPlot("Frame arena bytes", static_cast<i64>(frame.ctx.get().frameArena.bytesAllocated));
+
     return frame.stats;
 }
 
-VulkanBackend::VulkanBackend(GLFWwindow* window) : window(window)
+VulkanBackend::VulkanBackend(GLFWwindow* window, BackendConfig config) : window(window), headless(config.headless)
 {
-    i32 width;
-    i32 height;
-    glfwGetFramebufferSize(window, &width, &height);
+    i32 width = static_cast<i32>(config.width);
+    i32 height = static_cast<i32>(config.height);
+    if (!headless)
+    {
+        glfwGetFramebufferSize(window, &width, &height);
+    }
 
     viewport.x = 0.f;
     viewport.y = 0.f;
@@ -89,15 +147,32 @@ VulkanBackend::VulkanBackend(GLFWwindow* window) : window(window)
     initImgui();
 
     initProfiler();
+    initQueries();
 
     textures = Textures(*this);
-    bindlessResources = BindlessResources(*this);
+    bindlessResources.emplace(*this);
+    pipelineLayoutCache.registerSetLayout(1,
+        {ShaderReflection::Binding{.binding = 0, .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .count = 0}},
+        bindlessResources->bindlessTexDescLayout);
+    textureStreamer.emplace(*this, config.textureBudgetBytes);
+    if (config.hotReloadShaders)
+    {
+        shaderReloader.emplace(*this);
+    }
 }
 
 auto VulkanBackend::deinit() -> void
 {
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    shaderReloader.reset();
+    pipelineCache.save(device);
+    pipelineCache.destroy(device);
+    pipelineLayoutCache.destroy(device);
+
+    if (!headless)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 }
 
 auto VulkanBackend::initVulkan() -> void
@@ -111,16 +186,21 @@ auto VulkanBackend::initVulkan() -> void
                       .request_validation_layers(false)
 #endif  // DEBUG
                       .require_api_version(1, 3, 0)
+                      .set_headless(headless)
                       .use_default_debug_messenger()
                       .build()
                       .value();
     instance = vkbInstance.instance;
     debugMessenger = vkbInstance.debug_messenger;
 
-    VkResult err = glfwCreateWindowSurface(instance, window, NULL, &surface);
-    if (err != VK_SUCCESS)
+    surface = VK_NULL_HANDLE;
+    if (!headless)
     {
-        std::println("Failed creating surface");
+        VkResult err = glfwCreateWindowSurface(instance, window, NULL, &surface);
+        if (err != VK_SUCCESS)
+        {
+            std::println("Failed creating surface");
+        }
     }
 
     VkPhysicalDeviceVulkan12Features features12 = {};
@@ -145,15 +225,28 @@ auto VulkanBackend::initVulkan() -> void
     features.multiDrawIndirect = true;
     features.drawIndirectFirstInstance = true;
     features.depthClamp = true;
+    features.textureCompressionBC = true;
 
     vkb::PhysicalDeviceSelector selector{vkbInstance};
-    vkb::PhysicalDevice physicalDevice = selector.set_minimum_version(1, 3)
-                                             .set_required_features(features)
-                                             .set_required_features_12(features12)
-                                             .set_required_features_13(features13)
-                                             .set_surface(surface)
-                                             .select()
-                                             .value();
+    selector.set_minimum_version(1, 3)
+        .set_required_features(features)
+        .set_required_features_12(features12)
+        .set_required_features_13(features13);
+    if (headless)
+    {
+        // No presentation support needed, which also lets software rasterizers like lavapipe through
+        selector.defer_surface_initialization();
+    }
+    else
+    {
+        selector.set_surface(surface);
+    }
+    vkb::PhysicalDevice physicalDevice = selector.select().value();
+    // Only feeds the render graph stats, enabled if present rather than required
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+    pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery;
+    physicalDevice.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
     vkb::DeviceBuilder deviceBuilder{physicalDevice};
     VkPhysicalDeviceShaderDrawParametersFeatures shaderDrawParametersFeatures = {};
     shaderDrawParametersFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
@@ -165,6 +258,7 @@ auto VulkanBackend::initVulkan() -> void
     device = vkbDevice.device;
 
     gpuProperties = vkbDevice.physical_device.properties;
+    pipelineCache.init(device, gpuProperties, "pipelineCache.bin");
 
     graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
     graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
@@ -184,23 +278,11 @@ auto VulkanBackend::initSwapchain() -> void
 {
     vkDeviceWaitIdle(device);
 
-    vkb::SwapchainBuilder builder{gpu, device, surface};
-    vkb::Swapchain vkbSwapchain = builder
-                                      .use_default_format_selection()
-                                      //.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-                                      .set_desired_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)
-                                      //.set_desired_present_mode(VK_PRESENT_MODE_FIFO_RELAXED_KHR)
-                                      //.set_desired_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
-                                      .set_desired_min_image_count(MaxFramesInFlight)
-                                      .set_desired_extent(viewport.width, viewport.height)
-                                      .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
-                                      .build()
-                                      .value();
-
-    swapchain = vkbSwapchain.swapchain;
-    swapchainImages = vkbSwapchain.get_images().value();
-    swapchainImageViews = vkbSwapchain.get_image_views().value();
-    swapchainImageFormat = vkbSwapchain.image_format;
+    // Headless rendering stops at the backbuffer
+    if (!headless)
+    {
+        initPresentation();
+    }
 
     // Backbuffer
     backbufferImage.format = VK_FORMAT_R16G16B16A16_SFLOAT;
@@ -218,12 +300,34 @@ auto VulkanBackend::initSwapchain() -> void
     allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     vmaCreateImage(allocator, &imgInfo, &allocInfo, &backbufferImage.image, &backbufferImage.allocation, nullptr);
+    backbufferImage.usage = backbufferUsageFlags;
 
     auto imgViewInfo = vkutil::init::imageViewCreateInfo(
         backbufferImage.format, backbufferImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
     VK_CHECK(vkCreateImageView(device, &imgViewInfo, nullptr, &backbufferImage.view));
 }
 
+auto VulkanBackend::initPresentation() -> void
+{
+    vkb::SwapchainBuilder builder{gpu, device, surface};
+    vkb::Swapchain vkbSwapchain = builder
+                                      .use_default_format_selection()
+                                      //.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+                                      .set_desired_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)
+                                      //.set_desired_present_mode(VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+                                      //.set_desired_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
+                                      .set_desired_min_image_count(MaxFramesInFlight)
+                                      .set_desired_extent(viewport.width, viewport.height)
+                                      .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+                                      .build()
+                                      .value();
+
+    swapchain = vkbSwapchain.swapchain;
+    swapchainImages = vkbSwapchain.get_images().value();
+    swapchainImageViews = vkbSwapchain.get_image_views().value();
+    swapchainImageFormat = vkbSwapchain.image_format;
+}
+
 auto VulkanBackend::initCommandBuffers() -> void
 {
     auto commandPoolInfo = vkutil::init::commandPoolCreateInfo(
@@ -280,9 +384,6 @@ struct SceneUniforms
     glm::vec4 lightDir;
     glm::vec4 time;
 };
-static SceneUniforms sceneUniforms;
-static AllocatedBuffer sceneUniformBuffer;
-static VkDescriptorSet sceneDescriptorSet;
 
 auto VulkanBackend::initDescriptors() -> void
 {
@@ -292,11 +393,6 @@ auto VulkanBackend::initDescriptors() -> void
     };
     descriptorAllocator.init(device, 20, poolSizes);
 
-    {
-        auto bufInfo = vkutil::init::bufferCreateInfo(sizeof(SceneUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-        sceneUniformBuffer = allocateBuffer(bufInfo, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
-            VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    }
     {
         DescriptorSetLayoutBuilder builder;
         builder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
@@ -304,12 +400,22 @@ auto VulkanBackend::initDescriptors() -> void
         sceneDescriptorSetLayout = builder.build(device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT |
                                                              VK_SHADER_STAGE_GEOMETRY_BIT |
                                                              VK_SHADER_STAGE_COMPUTE_BIT);
-        sceneDescriptorSet = descriptorAllocator.allocate(device, sceneDescriptorSetLayout);
+        pipelineLayoutCache.registerSetLayout(0,
+            {ShaderReflection::Binding{.binding = 0, .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .count = 1}},
+            sceneDescriptorSetLayout);
+    }
+
+    // One copy per frame in flight, the previous frame may still be reading its own
+    for (FrameCtx& frameCtx : frames)
+    {
+        auto bufInfo = vkutil::init::bufferCreateInfo(sizeof(SceneUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        frameCtx.sceneUniforms = allocateMappedBuffer(bufInfo, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 
+        frameCtx.sceneDescriptorSet = descriptorAllocator.allocate(device, sceneDescriptorSetLayout);
         VkDescriptorBufferInfo descriptorBufferInfo = vkutil::init::descriptorBufferInfo(
-            sceneUniformBuffer.buffer, 0, sizeof(SceneUniforms));
+            frameCtx.sceneUniforms.buffer.buffer, 0, sizeof(SceneUniforms));
         VkWriteDescriptorSet descriptorImageWrite = vkutil::init::writeDescriptorBuffer(
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sceneDescriptorSet, &descriptorBufferInfo, 0);
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCtx.sceneDescriptorSet, &descriptorBufferInfo, 0);
 
         vkUpdateDescriptorSets(device, 1, &descriptorImageWrite, 0, nullptr);
     }
@@ -317,24 +423,6 @@ auto VulkanBackend::initDescriptors() -> void
 
 auto VulkanBackend::initImgui() -> void
 {
-    VkDescriptorPoolSize pool_sizes[] = {{VK_DESCRIPTOR_TYPE_SAMPLER, 1000},
-        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000}, {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000},
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000}, {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000},
-        {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000}, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000}, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000}, {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000}};
-
-    VkDescriptorPoolCreateInfo poolCreateInfo = {};
-    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-    poolCreateInfo.maxSets = 1000;
-    poolCreateInfo.poolSizeCount = (u32)std::size(pool_sizes);
-    poolCreateInfo.pPoolSizes = pool_sizes;
-
-    VkDescriptorPool imguiPool;
-    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &imguiPool));
-
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     // ImGui::StyleColorsDark();
@@ -412,9 +500,41 @@ auto VulkanBackend::initImgui() -> void
         style.DockingSeparatorSize = 1.0f;
         style.SeparatorTextBorderSize = 2.0f;
     }
+    ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+
+    if (headless)
+    {
+        // UI code still runs every frame, it just never gets rendered. Without a renderer backend the font atlas
+        // has to be built by hand for ImGui::NewFrame() to be happy.
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(viewport.width, viewport.height);
+        io.IniFilename = nullptr;
+        u8* pixels;
+        i32 width;
+        i32 height;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+        return;
+    }
+
     ImGui_ImplGlfw_InitForVulkan(window, true);
 
-    ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+    VkDescriptorPoolSize pool_sizes[] = {{VK_DESCRIPTOR_TYPE_SAMPLER, 1000},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000}, {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000}, {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000},
+        {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000}, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000}, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000}, {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000}};
+
+    VkDescriptorPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+    poolCreateInfo.maxSets = 1000;
+    poolCreateInfo.poolSizeCount = (u32)std::size(pool_sizes);
+    poolCreateInfo.pPoolSizes = pool_sizes;
+
+    VkDescriptorPool imguiPool;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &imguiPool));
 
     ImGui_ImplVulkan_InitInfo imguiInitInfo = {};
     imguiInitInfo.Instance = instance;
@@ -464,14 +584,92 @@ auto VulkanBackend::initProfiler() -> void
     }
 }
 
+// Order matches the order results are written in, which is the bit order
+static constexpr VkQueryPipelineStatisticFlags passStatisticsFlags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+static constexpr u32 passStatisticsCount = 5;
+
+auto VulkanBackend::initQueries() -> void
+{
+    VkQueryPoolCreateInfo timestampPoolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = MaxInstrumentedPasses * 2,
+    };
+    VkQueryPoolCreateInfo statisticsPoolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+        .queryCount = MaxInstrumentedPasses,
+        .pipelineStatistics = passStatisticsFlags,
+    };
+    for (i32 i = 0; i < MaxFramesInFlight; i++)
+    {
+        VK_CHECK(vkCreateQueryPool(device, &timestampPoolInfo, nullptr, &frames[i].timestampQueryPool));
+        if (pipelineStatisticsSupported)
+        {
+            VK_CHECK(vkCreateQueryPool(device, &statisticsPoolInfo, nullptr, &frames[i].statisticsQueryPool));
+        }
+        frames[i].pendingPassSamples.reserve(MaxInstrumentedPasses);
+    }
+}
+
+auto VulkanBackend::collectPassStats(FrameCtx& frameCtx) -> void
+{
+    ZoneScoped;
+
+    const u32 passCount = static_cast<u32>(frameCtx.pendingPassSamples.size());
+    if (passCount == 0)
+    {
+        return;
+    }
+
+    u64 timestamps[MaxInstrumentedPasses * 2];
+    u64 statistics[MaxInstrumentedPasses * passStatisticsCount];
+    const bool timestampsValid = vkGetQueryPoolResults(device, frameCtx.timestampQueryPool, 0, passCount * 2,
+        sizeof(timestamps), timestamps, sizeof(u64), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+    const bool statisticsValid = frameCtx.statisticsQueryPool != VK_NULL_HANDLE &&
+        vkGetQueryPoolResults(device, frameCtx.statisticsQueryPool, 0, passCount, sizeof(statistics), statistics,
+            sizeof(u64) * passStatisticsCount, VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+
+    const f64 nsPerTick = gpuProperties.limits.timestampPeriod;
+    for (u32 i = 0; i < passCount; i++)
+    {
+        auto& [name, sample] = frameCtx.pendingPassSamples[i];
+        if (timestampsValid)
+        {
+            sample.gpuMs = static_cast<f64>(timestamps[i * 2 + 1] - timestamps[i * 2]) * nsPerTick / 1'000'000.0;
+        }
+        if (statisticsValid)
+        {
+            const u64* passStatistics = &statistics[i * passStatisticsCount];
+            sample.primitives = passStatistics[0];
+            sample.vertexInvocations = passStatistics[1];
+            sample.clippedPrimitives = passStatistics[2];
+            sample.fragmentInvocations = passStatistics[3];
+            sample.computeInvocations = passStatistics[4];
+        }
+        addPassSample(renderGraphStats, i, name, sample);
+    }
+    truncatePassStats(renderGraphStats, passCount);
+
+    frameCtx.pendingPassSamples.clear();
+}
+
 auto VulkanBackend::currentFrame() -> FrameCtx& { return frames[currentFrameNumber % MaxFramesInFlight]; }
 
 auto VulkanBackend::render(const Frame& frame, CompiledRenderGraph& graph, Scene& scene) -> void
 {
     ZoneScoped;
-    std::string profilerTag = std::format(
-        "Rendering (frame={}, mod={})", currentFrameNumber, currentFrameNumber % MaxFramesInFlight);
-    ZoneName(profilerTag.c_str(), profilerTag.size());
+    char profilerTag[64];
+    const auto profilerTagEnd = std::format_to_n(profilerTag, sizeof(profilerTag), "Rendering (frame={}, mod={})",
+        currentFrameNumber, currentFrameNumber % MaxFramesInFlight);
+    ZoneName(profilerTag, std::min<size_t>(profilerTagEnd.size, sizeof(profilerTag)));
 
     constexpr u64 timeoutNs = 100'000'000'000'000;
 
@@ -479,19 +677,26 @@ auto VulkanBackend::render(const Frame& frame, CompiledRenderGraph& graph, Scene
     auto cmd = frameCtx.cmdBuffer;
     auto computeCmd = frameCtx.cmdComputeBuffer;
 
-    u32 swapchainImageIndex;
+    // Textures added or swapped while building the graph are sampled by this frame already
+    bindlessResources->flushWrites();
+
+    u32 swapchainImageIndex = 0;
     {
         ZoneScopedN("Sync CPU");
 
         VK_CHECK(vkWaitForFences(device, 1, &frameCtx.renderFence, true, timeoutNs));
         // TODO: move after swapchain regen... maybe?
 
-        VK_CHECK(
-            vkAcquireNextImageKHR(device, swapchain, timeoutNs, frameCtx.presentSem, nullptr, &swapchainImageIndex));
-        // TODO: if swapchain regen requested process, reacquire index and continue
+        if (!headless)
+        {
+            VK_CHECK(vkAcquireNextImageKHR(device, swapchain, timeoutNs, frameCtx.presentSem, nullptr,
+                &swapchainImageIndex));
+            // TODO: if swapchain regen requested process, reacquire index and continue
+        }
 
         VK_CHECK(vkResetFences(device, 1, &frameCtx.renderFence));
     }
+    collectPassStats(frameCtx);
 
     {
         ZoneScopedN("Sync Tracy");
@@ -522,6 +727,18 @@ auto VulkanBackend::render(const Frame& frame, CompiledRenderGraph& graph, Scene
                 cmd, backbufferImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
         }
 
+        if (!pendingTextureUploads.empty())
+        {
+            ZoneScopedCpuGpuAuto("Texture uploads", frameCtx);
+
+            for (const TextureUpload& upload : pendingTextureUploads)
+            {
+                recordTextureUpload(cmd, upload);
+                destroyBufferDeferred(upload.staging);
+            }
+            pendingTextureUploads.clear();
+        }
+
         VkExtent2D swapchainSize{static_cast<u32>(viewport.width), static_cast<u32>(viewport.height)};
 
         // TODO: this should live as a separate pass in the render graph
@@ -529,29 +746,48 @@ auto VulkanBackend::render(const Frame& frame, CompiledRenderGraph& graph, Scene
         {
             ZoneScopedCpuGpuAuto("Memcpy SceneUniforms to GPU", frameCtx);
 
-            sceneUniforms.cameraPos = glm::vec4(scene.activeCamera->position, 1.f);
-            sceneUniforms.view = scene.activeCamera->view();
-            sceneUniforms.projection = scene.activeCamera->proj();
-            sceneUniforms.lightDir = glm::vec4(scene.lightDir, 5.f);
             static f64 time = 0.f;
             time += frame.stats.pastFrameDt;
-            sceneUniforms.time = glm::vec4(time);
-
-            u8* dataOnGpu;
-            vmaMapMemory(allocator, sceneUniformBuffer.allocation, (void**)&dataOnGpu);
-            memcpy(dataOnGpu, &sceneUniforms, sizeof(sceneUniforms));
-            vmaUnmapMemory(allocator, sceneUniformBuffer.allocation);
+            const SceneUniforms sceneUniforms = {
+                .cameraPos = glm::vec4(scene.activeCamera->position, 1.f),
+                .view = scene.activeCamera->view(),
+                .projection = scene.activeCamera->proj(),
+                .lightDir = glm::vec4(scene.lightDir, 5.f),
+                .time = glm::vec4(time),
+            };
+            memcpy(frameCtx.sceneUniforms.data, &sceneUniforms, sizeof(sceneUniforms));
         }
 
         {
             ZoneScopedCpuGpuAuto("Render graph", frameCtx);
 
-            for (CompiledRenderGraph::Node& node : graph.nodes)
+            const u32 instrumentedPasses = std::min(static_cast<u32>(graph.nodes.size()), MaxInstrumentedPasses);
+            vkCmdResetQueryPool(cmd, frameCtx.timestampQueryPool, 0, instrumentedPasses * 2);
+            const bool collectStatistics = frameCtx.statisticsQueryPool != VK_NULL_HANDLE;
+            if (collectStatistics)
+            {
+                vkCmdResetQueryPool(cmd, frameCtx.statisticsQueryPool, 0, instrumentedPasses);
+            }
+
+            for (u32 nodeIndex = 0; nodeIndex < graph.nodes.size(); nodeIndex++)
             {
+                CompiledRenderGraph::Node& node = graph.nodes[nodeIndex];
                 RenderPass& pass = node.pass;
 
                 ZoneScoped;
-                ZoneName(pass.debugName.c_str(), pass.debugName.size());
+                ZoneName(pass.debugName, strlen(pass.debugName));
+
+                const bool instrumented = nodeIndex < instrumentedPasses;
+                const auto cpuStart = std::chrono::high_resolution_clock::now();
+                if (instrumented)
+                {
+                    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, frameCtx.timestampQueryPool,
+                        nodeIndex * 2);
+                    if (collectStatistics)
+                    {
+                        vkCmdBeginQuery(cmd, frameCtx.statisticsQueryPool, nodeIndex, 0);
+                    }
+                }
 
                 {
                     ZoneScopedN("Barriers");
@@ -575,17 +811,15 @@ auto VulkanBackend::render(const Frame& frame, CompiledRenderGraph& graph, Scene
                     if (pass.beginRendering)
                     {
                         ZoneScopedN("Begin rendering");
-                        (*pass.beginRendering)(cmd, graph);
+                        pass.beginRendering(cmd, graph);
                     }
 
-                    vkCmdBindPipeline(cmd, pass.pipeline->pipelineBindPoint, pass.pipeline->pipeline);
+                    vkCmdBindPipeline(cmd, pass.pipeline->pipelineBindPoint, pass.pipeline->pipeline());
 
-                    // TEMP: each renderpass should specify this themselves
-                    // if (node.pass.debugName != "CSM pass" && node.pass.debugName != "Tiled light culling pass")
-                    if (node.pass.debugName != "CSM pass")
+                    if (pass.bindSceneDescriptors)
                     {
                         vkCmdBindDescriptorSets(cmd, pass.pipeline->pipelineBindPoint, pass.pipeline->pipelineLayout, 0,
-                            1, &sceneDescriptorSet, 0, nullptr);
+                            1, &frameCtx.sceneDescriptorSet, 0, nullptr);
                     }
 
                     vkCmdSetViewport(cmd, 0, 1, &viewport);
@@ -607,49 +841,115 @@ auto VulkanBackend::render(const Frame& frame, CompiledRenderGraph& graph, Scene
                     ZoneScopedN("Draw without pipeline");
                     pass.draw(cmd, graph, pass, scene);
                 }
+
+                if (instrumented)
+                {
+                    if (collectStatistics)
+                    {
+                        vkCmdEndQuery(cmd, frameCtx.statisticsQueryPool, nodeIndex);
+                    }
+                    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frameCtx.timestampQueryPool,
+                        nodeIndex * 2 + 1);
+
+                    const std::chrono::duration<f64, std::milli> cpuTime =
+                        std::chrono::high_resolution_clock::now() - cpuStart;
+                    frameCtx.pendingPassSamples.push_back({
+                        .name = pass.debugName,
+                        .sample = {
+                            .cpuMs = cpuTime.count(),
+                            .drawCalls = pass.drawCalls,
+                            .barriers = static_cast<u32>(node.imageBarriers.size() + node.bufferBarriers.size() +
+                                node.memoryBarriers.size()),
+                        },
+                    });
+                }
             }
         }
 
-        VkExtent2D backbufferSize{backbufferImage.extent.width, backbufferImage.extent.height};
+        if (headless)
         {
-            ZoneScopedCpuGpuAuto("Blit to swapchain", frameCtx);
-
+            // Leave the backbuffer ready for readBackbuffer()
             vkutil::image::transitionImage(cmd, backbufferImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-            vkutil::image::transitionImage(cmd, swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-            vkutil::image::blitImageToImage(
-                cmd, backbufferImage.image, backbufferSize, swapchainImages[swapchainImageIndex], swapchainSize);
+            // UI is still built, just never drawn
+            ImGui::Render();
+            VK_CHECK(vkEndCommandBuffer(cmd));
         }
-
+        else
         {
-            ZoneScopedCpuGpuAuto("Render Imgui", frameCtx);
+            recordPresentation(cmd, swapchainImageIndex, swapchainSize);
+        }
+    }
 
-            ImGui::Render();
+    if (headless)
+    {
+        ZoneScopedCpuGpuAuto("Submit Graphics", frameCtx);
 
-            vkutil::image::transitionImage(cmd, swapchainImages[swapchainImageIndex],
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        auto cmdInfo = vkutil::init::commandBufferSubmitInfo(cmd);
+        auto submit = vkutil::init::submitInfo2(&cmdInfo, nullptr, nullptr);
+        VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, frameCtx.renderFence));
+    }
+    else
+    {
+        submitAndPresent(frameCtx, swapchainImageIndex);
+    }
+
+    {
+        ZoneScopedCpuGpuAuto("Tracy", frameCtx);
+        TracyVkCollect(frameCtx.tracyCtx, frameCtx.tracyCmdBuffer);
+        VK_CHECK(vkEndCommandBuffer(frameCtx.tracyCmdBuffer));
+        auto cmdInfo = vkutil::init::commandBufferSubmitInfo(frameCtx.tracyCmdBuffer);
+        auto submit = vkutil::init::submitInfo2(&cmdInfo, nullptr, nullptr);
+        VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, frameCtx.tracyRenderFence));
+    }
+}
 
-            VkRenderingAttachmentInfo colorAttachmentInfo = vkutil::init::renderingColorAttachmentInfo(
-                swapchainImageViews[swapchainImageIndex], nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-            VkRenderingInfo renderingInfo = vkutil::init::renderingInfo(
-                swapchainSize, &colorAttachmentInfo, 1, nullptr);
+auto VulkanBackend::recordPresentation(VkCommandBuffer cmd, u32 swapchainImageIndex, VkExtent2D swapchainSize) -> void
+{
+    FrameCtx& frameCtx = currentFrame();
 
-            vkCmdBeginRendering(cmd, &renderingInfo);
-            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
-            vkCmdEndRendering(cmd);
-        }
+    VkExtent2D backbufferSize{backbufferImage.extent.width, backbufferImage.extent.height};
+    {
+        ZoneScopedCpuGpuAuto("Blit to swapchain", frameCtx);
+
+        vkutil::image::transitionImage(cmd, backbufferImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vkutil::image::transitionImage(cmd, swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        vkutil::image::blitImageToImage(
+            cmd, backbufferImage.image, backbufferSize, swapchainImages[swapchainImageIndex], swapchainSize);
+    }
+
+    {
+        ZoneScopedCpuGpuAuto("Render Imgui", frameCtx);
+
+        ImGui::Render();
 
         vkutil::image::transitionImage(cmd, swapchainImages[swapchainImageIndex],
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-        VK_CHECK(vkEndCommandBuffer(cmd));
+        VkRenderingAttachmentInfo colorAttachmentInfo = vkutil::init::renderingColorAttachmentInfo(
+            swapchainImageViews[swapchainImageIndex], nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        VkRenderingInfo renderingInfo = vkutil::init::renderingInfo(
+            swapchainSize, &colorAttachmentInfo, 1, nullptr);
+
+        vkCmdBeginRendering(cmd, &renderingInfo);
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+        vkCmdEndRendering(cmd);
     }
 
+    vkutil::image::transitionImage(cmd, swapchainImages[swapchainImageIndex],
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    VK_CHECK(vkEndCommandBuffer(cmd));
+}
+
+auto VulkanBackend::submitAndPresent(FrameCtx& frameCtx, u32 swapchainImageIndex) -> void
+{
     {
         ZoneScopedCpuGpuAuto("Submit Graphics", frameCtx);
 
-        auto cmdInfo = vkutil::init::commandBufferSubmitInfo(cmd);
+        auto cmdInfo = vkutil::init::commandBufferSubmitInfo(frameCtx.cmdBuffer);
         auto waitInfo = vkutil::init::semaphoreSubmitInfo(
             VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, frameCtx.presentSem);
         auto signalInfo = vkutil::init::semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, frameCtx.renderSem);
@@ -664,15 +964,61 @@ auto VulkanBackend::render(const Frame& frame, CompiledRenderGraph& graph, Scene
         auto presentInfo = vkutil::init::presentInfo(&swapchain, &frameCtx.renderSem, &swapchainImageIndex);
         VK_CHECK(vkQueuePresentKHR(graphicsQueue, &presentInfo));
     }
+}
+
+auto VulkanBackend::readBackbuffer() -> std::vector<u8>
+{
+    ZoneScoped;
+
+    // Both the headless and the windowed path leave the backbuffer in TRANSFER_SRC at the end of a frame
+    VK_CHECK(vkDeviceWaitIdle(device));
 
+    const u32 width = backbufferImage.extent.width;
+    const u32 height = backbufferImage.extent.height;
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+
+    auto bufInfo = vkutil::init::bufferCreateInfo(pixelCount * 4 * sizeof(u16), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    AllocatedBuffer readback = allocateBuffer(bufInfo, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    immediateSubmit([&](VkCommandBuffer cmd)
     {
-        ZoneScopedCpuGpuAuto("Tracy", frameCtx);
-        TracyVkCollect(frameCtx.tracyCtx, frameCtx.tracyCmdBuffer);
-        VK_CHECK(vkEndCommandBuffer(frameCtx.tracyCmdBuffer));
-        auto cmdInfo = vkutil::init::commandBufferSubmitInfo(frameCtx.tracyCmdBuffer);
-        auto submit = vkutil::init::submitInfo2(&cmdInfo, nullptr, nullptr);
-        VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, frameCtx.tracyRenderFence));
+        VkBufferImageCopy copyRegion = {
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+            .imageOffset = {0, 0, 0},
+            .imageExtent = backbufferImage.extent,
+        };
+        vkCmdCopyImageToBuffer(cmd, backbufferImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1,
+            &copyRegion);
+    });
+
+    VmaAllocationInfo readbackInfo;
+    vmaGetAllocationInfo(allocator, readback.allocation, &readbackInfo);
+    const auto* halfs = static_cast<const u16*>(readbackInfo.pMappedData);
+
+    // Same conversion the blit to an sRGB swapchain does
+    std::vector<u8> pixels(pixelCount * 4);
+    for (size_t i = 0; i < pixelCount * 4; i++)
+    {
+        f32 value = std::clamp(glm::unpackHalf1x16(halfs[i]), 0.f, 1.f);
+        if (i % 4 != 3)
+        {
+            value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+        }
+        pixels[i] = static_cast<u8>(value * 255.f + 0.5f);
     }
+
+    vmaDestroyBuffer(allocator, readback.buffer, readback.allocation);
+
+    return pixels;
 }
 
 auto VulkanBackend::immediateSubmit(std::function<void(VkCommandBuffer)>&& f) -> void
@@ -726,6 +1072,25 @@ auto VulkanBackend::copyBufferWithStaging(void* data, size_t size, VkBuffer dst,
     // TODO: release staging data
 }
 
+auto VulkanBackend::destroyBufferDeferred(AllocatedBuffer buffer) -> void
+{
+    retiredBuffers.push_back(RetiredBuffer{.buffer = buffer, .frameNumber = currentFrameNumber});
+}
+
+auto VulkanBackend::destroyTextureDeferred(Texture texture) -> void
+{
+    retiredTextures.push_back(RetiredTexture{.texture = texture, .frameNumber = currentFrameNumber});
+}
+
+auto VulkanBackend::destroyPipeline(const Pipeline& pipeline) -> void
+{
+    if (shaderReloader)
+    {
+        shaderReloader->untrack(pipeline);
+    }
+    vkDestroyPipeline(device, pipeline.pipeline(), nullptr);
+}
+
 auto VulkanBackend::allocateBuffer(VkBufferCreateInfo info, VmaMemoryUsage usage, VmaAllocationCreateFlags flags,
     VkMemoryPropertyFlags requiredFlags) -> AllocatedBuffer
 {
@@ -741,12 +1106,25 @@ auto VulkanBackend::allocateBuffer(VkBufferCreateInfo info, VmaMemoryUsage usage
     return buffer;
 }
 
+auto VulkanBackend::allocateMappedBuffer(VkBufferCreateInfo info, VmaAllocationCreateFlags hostAccess) -> MappedBuffer
+{
+    MappedBuffer mapped = {
+        .buffer = allocateBuffer(info, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_MAPPED_BIT | hostAccess,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+    };
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(allocator, mapped.buffer.allocation, &allocationInfo);
+    mapped.data = static_cast<u8*>(allocationInfo.pMappedData);
+    return mapped;
+}
+
 auto VulkanBackend::allocateImage(VkImageCreateInfo info, VmaMemoryUsage usage, VmaAllocationCreateFlags flags,
     VkMemoryPropertyFlags requiredFlags, VkImageAspectFlags aspectFlags) -> AllocatedImage
 {
     AllocatedImage image;
     image.format = info.format;
     image.extent = info.extent;
+    image.usage = info.usage;
 
     VmaAllocationCreateInfo allocInfo{
         .flags = flags,
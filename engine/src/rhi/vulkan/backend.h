@@ -5,11 +5,17 @@
 
 #include "VkBootstrap.h"
 #include "engine.h"
+#include "memory/linearArena.h"
+#include "renderGraphStats.h"
 #include "result.hpp"
 #include "rhi/renderpass.h"
 #include "rhi/vulkan/bindless.h"
 #include "rhi/vulkan/descriptors.h"
+#include "rhi/vulkan/pipelineCache.h"
+#include "rhi/vulkan/pipelineLayoutCache.h"
 #include "rhi/vulkan/shader.h"
+#include "rhi/vulkan/shaderReloader.h"
+#include "rhi/vulkan/textureStreamer.h"
 #include "rhi/vulkan/utils/buffer.h"
 #include "rhi/vulkan/utils/image.h"
 #include "rhi/vulkan/utils/texture.h"
@@ -20,6 +26,9 @@
 struct Stats
 {
     u64 finishedFrameCount = 0;
+    // Global operator new calls between the last two endFrame()s, should be 0 in steady state
+    u64 frameHeapAllocations = 0;
+    u64 heapAllocationsAtFrameEnd = 0;
 };
 
 struct FrameCtx
@@ -38,6 +47,25 @@ struct FrameCtx
 
     VkCommandPool cmdComputePool;
     VkCommandBuffer cmdComputeBuffer;
+
+    // Render graph instrumentation. Results are read back the next time this frame is used.
+    VkQueryPool timestampQueryPool;
+    // VK_NULL_HANDLE when the device doesn't support pipeline statistics
+    VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+    struct PendingPassSample
+    {
+        const char* name;
+        PassSample sample;
+    };
+    std::vector<PendingPassSample> pendingPassSamples;
+
+    // Camera etc. Stays mapped, written every frame in render()
+    MappedBuffer sceneUniforms;
+    VkDescriptorSet sceneDescriptorSet;
+
+    // Scratch memory for CPU data that only has to live until the frame's commands are recorded and submitted.
+    // Reset in newFrame() once the frame's previous use has retired on the GPU.
+    LinearArena frameArena;
 };
 
 class GLFWwindow;
@@ -45,9 +73,22 @@ struct Scene;
 struct Mesh;
 struct CompiledRenderGraph;
 
+struct BackendConfig
+{
+    // No window, surface or swapchain, frames only end up in the backbuffer. See VulkanBackend::readBackbuffer().
+    bool headless = false;
+    // Backbuffer size when headless, the window size is used otherwise
+    u32 width = 1920;
+    u32 height = 1080;
+    // Streamed texture mips are kept within this, see TextureStreamer
+    u64 textureBudgetBytes = 512ull * 1024 * 1024;
+    // Edited shaders are recompiled and their pipelines swapped while running, see ShaderReloader
+    bool hotReloadShaders = true;
+};
+
 class VulkanBackend;
 enum class backendError {};
-result::result<VulkanBackend*, backendError> initVulkanBackend();
+result::result<VulkanBackend*, backendError> initVulkanBackend(BackendConfig config = {});
 
 struct FrameStats
 {
@@ -65,7 +106,9 @@ struct Frame
 
 struct VulkanBackend
 {
+    // nullptr when headless
     GLFWwindow* window;
+    bool headless = false;
 
     vkb::Instance vkbInstance;
     VkInstance instance;
@@ -75,6 +118,8 @@ struct VulkanBackend
     VkPhysicalDevice gpu;
     VkDevice device;
     VkPhysicalDeviceProperties gpuProperties;
+    // Optional, pass samples carry no pipeline statistics without it
+    bool pipelineStatisticsSupported = false;
 
     VkQueue graphicsQueue;
     u32 graphicsQueueFamily;
@@ -111,21 +156,44 @@ struct VulkanBackend
 
     // Caches
     ShaderModuleCache shaderModuleCache;
+    PipelineCache pipelineCache;
+    PipelineLayoutCache pipelineLayoutCache;
+    std::optional<ShaderReloader> shaderReloader;
 
     // Profiler
     TracyVkCtx tracyCtx;
 
     // Debug
     Stats stats;
+    RenderGraphStats renderGraphStats;
+    // Nodes past this are not instrumented
+    static constexpr u32 MaxInstrumentedPasses = 64;
 
     // Resources
     std::optional<Textures> textures;
     std::optional<BindlessResources> bindlessResources;
+    std::optional<TextureStreamer> textureStreamer;
+
+    // Destroyed once every frame in flight that could still use them has retired, see newFrame()
+    struct RetiredBuffer
+    {
+        AllocatedBuffer buffer;
+        u64 frameNumber;
+    };
+    struct RetiredTexture
+    {
+        Texture texture;
+        u64 frameNumber;
+    };
+    std::vector<RetiredBuffer> retiredBuffers;
+    std::vector<RetiredTexture> retiredTextures;
+    // Recorded at the start of the next render(), see createCompressedTextureDeferred()
+    std::vector<TextureUpload> pendingTextureUploads;
 
     VkDescriptorSetLayout sceneDescriptorSetLayout;
 
     explicit VulkanBackend() {}
-    explicit VulkanBackend(GLFWwindow* window);
+    explicit VulkanBackend(GLFWwindow* window, BackendConfig config);
     // TODO: init?
     auto deinit() -> void;
 
@@ -139,19 +207,36 @@ struct VulkanBackend
     auto copyBuffer(VkBuffer src, VkBuffer dst, VkBufferCopy copyRegion) -> void;
     auto copyBufferWithStaging(void* data, size_t size, VkBuffer dst, VkBufferCopy copyRegion = VkBufferCopy()) -> void;
 
+    auto destroyBufferDeferred(AllocatedBuffer buffer) -> void;
+    auto destroyTextureDeferred(Texture texture) -> void;
+    // Right away, the GPU must be done with it. Stops the shader reloader from recompiling it too.
+    auto destroyPipeline(const Pipeline& pipeline) -> void;
+
     auto allocateBuffer(VkBufferCreateInfo info, VmaMemoryUsage usage, VmaAllocationCreateFlags flags,
         VkMemoryPropertyFlags requiredFlags) -> AllocatedBuffer;
+    // hostAccess is VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT or ..._RANDOM_BIT
+    auto allocateMappedBuffer(VkBufferCreateInfo info, VmaAllocationCreateFlags hostAccess) -> MappedBuffer;
     auto allocateImage(VkImageCreateInfo info, VmaMemoryUsage usage, VmaAllocationCreateFlags flags,
         VkMemoryPropertyFlags requiredFlags, VkImageAspectFlags aspectFlags) -> AllocatedImage;
 
     auto getBufferDeviceAddress(VkBuffer buffer) -> VkDeviceAddress;
 
+    // Waits for the GPU and returns the last rendered frame as tightly packed, sRGB encoded RGBA8
+    auto readBackbuffer() -> std::vector<u8>;
+
 private:
     auto initVulkan() -> void;
     auto initSwapchain() -> void;
+    auto initPresentation() -> void;
     auto initCommandBuffers() -> void;
     auto initSyncStructs() -> void;
     auto initDescriptors() -> void;
     auto initImgui() -> void;
     auto initProfiler() -> void;
+    auto initQueries() -> void;
+
+    auto collectPassStats(FrameCtx& frameCtx) -> void;
+
+    auto recordPresentation(VkCommandBuffer cmd, u32 swapchainImageIndex, VkExtent2D swapchainSize) -> void;
+    auto submitAndPresent(FrameCtx& frameCtx, u32 swapchainImageIndex) -> void;
 };
\ No newline at end of file
@@ -1,14 +1,57 @@
 #include "rhi/vulkan/bindless.h"
 
-#include "renderGraph.h"
 #include "rhi/vulkan/backend.h"
 #include "rhi/vulkan/descriptors.h"
 #include "rhi/vulkan/utils/inits.h"
 #include "rhi/vulkan/utils/texture.h"
 
-BindlessResources::BindlessResources(VulkanBackend& backend) : backend(&backend)
+#include <algorithm>
+#include <numeric>
+#include <print>
+
+static constexpr u32 maxBindlessResourceCount = 10000;
+
+auto BindlessSlotAllocator::allocate() -> std::optional<u32>
+{
+    std::lock_guard lock(mutex);
+    if (!freeSlots.empty())
+    {
+        const u32 slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    if (nextSlot == capacity)
+    {
+        return std::nullopt;
+    }
+    return nextSlot++;
+}
+
+auto BindlessSlotAllocator::free(u32 slot, u64 frameNumber) -> void
+{
+    std::lock_guard lock(mutex);
+    pendingFrees.push_back(PendingFree{.slot = slot, .frameNumber = frameNumber});
+}
+
+auto BindlessSlotAllocator::retire(u64 frameNumber, u64 framesInFlight, std::vector<u32>& retired) -> void
+{
+    std::lock_guard lock(mutex);
+    // Frees are queued in frame order, the retired ones are a prefix
+    const auto firstPending = std::find_if(pendingFrees.begin(), pendingFrees.end(), [&](const PendingFree& pending)
+    {
+        return pending.frameNumber + framesInFlight > frameNumber;
+    });
+    for (auto pending = pendingFrees.begin(); pending != firstPending; ++pending)
+    {
+        freeSlots.push_back(pending->slot);
+        retired.push_back(pending->slot);
+    }
+    pendingFrees.erase(pendingFrees.begin(), firstPending);
+}
+
+BindlessResources::BindlessResources(VulkanBackend& backend)
+    : backend(&backend), textureSlots(maxBindlessResourceCount)
 {
-    constexpr u32 maxBindlessResourceCount = 10000;
     {
         VkDescriptorPoolSize poolSizes[] = {
             VkDescriptorPoolSize{
@@ -38,6 +81,15 @@ BindlessResources::BindlessResources(VulkanBackend& backend) : backend(&backend)
     bindlessTexDesc = bindlessDescPoolAllocator.allocate(
         backend.device, bindlessTexDescLayout, &variableDescriptorCountAllocInfo);
 
+    VkSamplerCreateInfo samplerInfo = vkutil::init::samplerCreateInfo(
+        VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_LOD_CLAMP_NONE);
+    vkCreateSampler(backend.device, &samplerInfo, nullptr, &sampler);
+
+    textures.resize(maxBindlessResourceCount);
+    redirects.resize(maxBindlessResourceCount);
+    std::iota(redirects.begin(), redirects.end(), 0);
+    pendingWrites.reserve(64);
+
     // Default textures. No need to deallocate -- we need these to always exist
     addTexture(whiteTexture(backend, 1));
     addTexture(blackTexture(backend, 1));
@@ -46,75 +98,152 @@ BindlessResources::BindlessResources(VulkanBackend& backend) : backend(&backend)
 
 auto BindlessResources::addTexture(Texture texture) -> BindlessTexture
 {
-    // TODO: Updating the bindless texture data should be moved
-    VkSampler sampler;
-    VkSamplerCreateInfo samplerInfo = vkutil::init::samplerCreateInfo(
-        VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, texture.mipCount);
-    vkCreateSampler(backend->device, &samplerInfo, nullptr, &sampler);
-
-    VkDescriptorImageInfo descriptorImageInfo = vkutil::init::descriptorImageInfo(
-        sampler, texture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    VkWriteDescriptorSet descriptorWrite = vkutil::init::writeDescriptorImage(
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, bindlessTexDesc, &descriptorImageInfo, 0);
-
-    BindlessTexture index = lastUsedIndex;
-    if (!freeIndices.empty())
+    const auto slot = textureSlots.allocate();
+    if (!slot)
     {
-        index = *freeIndices.begin();
-        freeIndices.erase(index);
+        std::println("Out of bindless texture slots");
+        return kError;
     }
-    else
+
+    textures[*slot] = texture;
     {
-        textures.emplace_back();
-        lastUsedIndex += 1;
+        std::lock_guard lock(writesMutex);
+        pendingWrites.push_back(PendingWrite{.slot = *slot, .view = texture.view});
     }
-    textures[index] = texture;
-    descriptorWrite.dstArrayElement = index;
-
-    vkUpdateDescriptorSets(backend->device, 1, &descriptorWrite, 0, nullptr);
-
-    return index;
+    return *slot;
 }
 
 auto BindlessResources::getTexture(BindlessTexture handle, BindlessTexture defaultTexture) -> const Texture&
 {
-    if (handle < textures.size() && !freeIndices.contains(handle)) return textures[handle];
+    if (handle < textures.size() && textures[redirects[handle]].view != VK_NULL_HANDLE)
+    {
+        return textures[redirects[handle]];
+    }
 
     return textures[defaultTexture];
 }
 
-auto BindlessResources::removeTexture(BindlessTexture handle) -> void { assert(false); }
-
-template <>
-auto addTransition<BindlessTexture>(VulkanBackend& backend, CompiledRenderGraph::Node& node, BindlessTexture* resource,
-    Layout oldLayout, Layout newLayout)
-    -> void
+auto BindlessResources::removeTexture(BindlessTexture handle) -> void
 {
-    if (oldLayout == newLayout)
+    if (handle <= kError || handle >= textures.size() || textures[handle].view == VK_NULL_HANDLE)
     {
         return;
     }
+    if (const BindlessTexture redirect = redirects[handle]; redirect != handle)
+    {
+        textures[redirect] = Texture{};
+        textureSlots.free(redirect, backend->currentFrameNumber);
+        redirects[handle] = handle;
+    }
+    textures[handle] = Texture{};
+    textureSlots.free(handle, backend->currentFrameNumber);
+}
+
+auto BindlessResources::replaceTexture(std::span<const BindlessTexture> handles, Texture texture) -> bool
+{
+    std::vector<u32> slots;
+    slots.reserve(handles.size());
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        const auto slot = textureSlots.allocate();
+        if (!slot)
+        {
+            std::println("Out of bindless texture slots, not replacing the texture");
+            for (const u32 allocated : slots)
+            {
+                textureSlots.free(allocated, backend->currentFrameNumber);
+            }
+            return false;
+        }
+        slots.push_back(*slot);
+    }
+
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        const BindlessTexture handle = handles[i];
+        const BindlessTexture previous = redirects[handle];
+        // The handle's own slot stays taken for as long as the handle lives, it is freed by removeTexture()
+        if (previous != handle)
+        {
+            textures[previous] = Texture{};
+            textureSlots.free(previous, backend->currentFrameNumber);
+        }
+
+        redirects[handle] = slots[i];
+        textures[slots[i]] = texture;
+        std::lock_guard lock(writesMutex);
+        pendingWrites.push_back(PendingWrite{.slot = slots[i], .view = texture.view});
+    }
+    return true;
+}
+
+auto BindlessResources::resolve(BindlessTexture handle) const -> BindlessTexture
+{
+    return handle < redirects.size() ? redirects[handle] : handle;
+}
 
-    VkImageMemoryBarrier2 imageBarrier = {};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    imageBarrier.pNext = nullptr;
+auto BindlessResources::update(u64 frameNumber) -> void
+{
+    // Held across retiring so a slot handed out again right away gets its write queued after the error one
+    std::lock_guard lock(writesMutex);
+    retiredSlots.clear();
+    textureSlots.retire(frameNumber, VulkanBackend::MaxFramesInFlight, retiredSlots);
 
-    // TODO: we can improve this
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+    // Nothing samples a retired slot anymore, pointing it at the error texture makes stale indices obvious
+    for (const u32 slot : retiredSlots)
+    {
+        pendingWrites.push_back(PendingWrite{.slot = slot, .view = textures[kError].view});
+    }
+}
+
+auto BindlessResources::flushWrites() -> void
+{
+    ZoneScoped;
 
-    imageBarrier.oldLayout = oldLayout;
-    imageBarrier.newLayout = newLayout;
+    std::lock_guard lock(writesMutex);
+    if (pendingWrites.empty())
+    {
+        return;
+    }
 
-    const Texture& tex = backend.bindlessResources->getTexture(*resource);
-    imageBarrier.image = tex.image.image;
+    // Last write to a slot wins. Consecutive slots end up in a single VkWriteDescriptorSet.
+    std::stable_sort(pendingWrites.begin(), pendingWrites.end(),
+        [](const PendingWrite& a, const PendingWrite& b) { return a.slot < b.slot; });
 
-    const bool isDepth = tex.image.format == VK_FORMAT_D32_SFLOAT;
+    writeImageInfos.clear();
+    writes.clear();
+    writeImageInfos.reserve(pendingWrites.size());
+    for (size_t i = 0; i < pendingWrites.size(); ++i)
+    {
+        const PendingWrite& write = pendingWrites[i];
+        if (i + 1 < pendingWrites.size() && pendingWrites[i + 1].slot == write.slot)
+        {
+            continue;
+        }
+
+        writeImageInfos.push_back(vkutil::init::descriptorImageInfo(
+            sampler, write.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+        if (!writes.empty() && writes.back().dstArrayElement + writes.back().descriptorCount == write.slot)
+        {
+            writes.back().descriptorCount++;
+            continue;
+        }
+
+        VkWriteDescriptorSet descriptorWrite = vkutil::init::writeDescriptorImage(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, bindlessTexDesc, nullptr, 0);
+        descriptorWrite.dstArrayElement = write.slot;
+        descriptorWrite.descriptorCount = 1;
+        writes.push_back(descriptorWrite);
+    }
 
-    VkImageAspectFlags aspectMask = isDepth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
-    imageBarrier.subresourceRange = vkutil::init::imageSubresourceRange(aspectMask);
+    // Image infos only stopped moving now
+    u32 info = 0;
+    for (auto& write : writes)
+    {
+        write.pImageInfo = &writeImageInfos[info];
+        info += write.descriptorCount;
+    }
 
-    node.imageBarriers.push_back(imageBarrier);
+    vkUpdateDescriptorSets(backend->device, static_cast<u32>(writes.size()), writes.data(), 0, nullptr);
+    pendingWrites.clear();
 }
@@ -2,7 +2,9 @@
 
 #include <vulkan/vulkan.h>
 
-#include <unordered_set>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <vector>
 
 #include "engine.h"
@@ -11,6 +13,34 @@
 
 class VulkanBackend;
 
+// Slots of a descriptor array. Allocation and freeing are a push/pop on a free list under a short lock. A freed
+// slot is only handed out again once every frame that could still have sampled it has retired.
+struct BindlessSlotAllocator
+{
+    std::mutex mutex;
+    std::vector<u32> freeSlots;
+    u32 nextSlot = 0;
+    u32 capacity = 0;
+
+    struct PendingFree
+    {
+        u32 slot;
+        // Frame the slot was last used in
+        u64 frameNumber;
+    };
+    std::vector<PendingFree> pendingFrees;
+
+    explicit BindlessSlotAllocator(u32 capacity) : capacity(capacity) {}
+
+    // Nullopt once capacity slots are in use
+    [[nodiscard]]
+    auto allocate() -> std::optional<u32>;
+    auto free(u32 slot, u64 frameNumber) -> void;
+    // Slots whose last use is at least framesInFlight frames older than frameNumber go back to the free list.
+    // Returns them so the caller can clean up after them.
+    auto retire(u64 frameNumber, u64 framesInFlight, std::vector<u32>& retired) -> void;
+};
+
 using BindlessTexture = u32;
 struct BindlessResources
 {
@@ -25,15 +55,44 @@ struct BindlessResources
     VkDescriptorSet bindlessTexDesc;
     VkDescriptorSetLayout bindlessTexDescLayout;
 
-    // CPU mirror of what data is in the GPU buffer
+    // Shared by every slot, doesn't clamp the mip count so it fits any texture
+    VkSampler sampler;
+
+    // CPU mirror of what data is in the GPU buffer, a null view for free slots
     std::vector<Texture> textures;
-    BindlessTexture lastUsedIndex;
-    i32 capacity;
-    std::unordered_set<BindlessTexture> freeIndices;  // All free indices that occur before lastUsedIndex
+    BindlessSlotAllocator textureSlots;
+    // Slot each handle currently shows in, the handle itself unless replaceTexture() moved it
+    std::vector<BindlessTexture> redirects;
+
+    // Descriptor writes are queued and submitted together in flushWrites()
+    struct PendingWrite
+    {
+        BindlessTexture slot;
+        VkImageView view;
+    };
+    std::mutex writesMutex;
+    std::vector<PendingWrite> pendingWrites;
+    // Scratch for flushWrites(), kept around so flushing doesn't allocate
+    std::vector<VkDescriptorImageInfo> writeImageInfos;
+    std::vector<VkWriteDescriptorSet> writes;
+    std::vector<u32> retiredSlots;
 
     explicit BindlessResources(VulkanBackend& backend);
 
     auto addTexture(Texture texture) -> BindlessTexture;
     auto getTexture(BindlessTexture handle, BindlessTexture defaultTexture = kError) -> const Texture&;
+    // The slot is reused once the frames in flight are done with it. The texture itself stays owned by the caller.
     auto removeTexture(BindlessTexture handle) -> void;
+    // Shows a different texture under the handles, e.g. the same one with more mips resident. A descriptor may not
+    // change while a frame in flight uses it, so the texture goes into a fresh slot the handles are redirected to
+    // and the slot they showed in before is freed with the frames in flight. All or nothing, false if out of slots.
+    auto replaceTexture(std::span<const BindlessTexture> handles, Texture texture) -> bool;
+    // What the shaders have to index with to see the handle's texture
+    [[nodiscard]]
+    auto resolve(BindlessTexture handle) const -> BindlessTexture;
+
+    // Retires removed slots, once per frame after its fence was waited on
+    auto update(u64 frameNumber) -> void;
+    // Submits the queued descriptor writes, has to happen before the frame's commands are recorded
+    auto flushWrites() -> void;
 };
@@ -1,12 +1,15 @@
 #include "rhi/vulkan/pipelineBuilder.h"
 
 #include "backend.h"
+#include "jobs/threadPool.h"
 #include "rhi/vulkan/utils/inits.h"
 #include "rhi/vulkan/vulkan.h"
 #include "shader.h"
 
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
+#include <map>
 #include <print>
 
 PipelineBuilder::PipelineBuilder(VulkanBackend& backend) : backend(backend) { reset(); }
@@ -23,21 +26,14 @@ auto PipelineBuilder::reset() -> void
         .pColorAttachmentFormats = nullptr};
 
     shaderStages.clear();
+    shaderModules.clear();
+    specializationEntries.clear();
+    specializationData.clear();
     colorAttachments.clear();
     colorBlendAttachments.clear();
 }
 
 
-auto PipelineBuilder::addDescriptorLayouts(std::initializer_list<VkDescriptorSetLayout>&& descriptorSetLayouts)
-    -> PipelineBuilder&
-{
-    layoutInfo.descriptorSetLayouts.insert(layoutInfo.descriptorSetLayouts.end(),
-        std::make_move_iterator(descriptorSetLayouts.begin()),
-        std::make_move_iterator(descriptorSetLayouts.end()));
-
-    return *this;
-}
-
 auto PipelineBuilder::addPushConstants(std::initializer_list<VkPushConstantRange>&& pushConstants) -> PipelineBuilder&
 {
     layoutInfo.pushConstants.insert(layoutInfo.pushConstants.end(),
@@ -72,24 +68,143 @@ auto PipelineBuilder::addShader(ShaderPath path, VkShaderStageFlagBits stage) ->
     determinedBindPoint = newDeterminedBindPoint;
 
     shaderStages.push_back(vkutil::init::shaderStageCreateInfo(stage, (*vertexShader)->module));
+    shaderModules.push_back(*vertexShader);
 
     return *this;
 }
 
+// Every stage's block has to fit in a declared range for that stage, and a declared range can't outgrow the blocks
+// it covers by more than alignment padding. Either way the C++ struct and the GLSL block have drifted apart.
+static auto validatePushConstants(const std::vector<VkPushConstantRange>& declared,
+    const std::vector<const ShaderModule*>& shaderModules) -> bool
+{
+    bool valid = true;
+    for (const ShaderModule* shaderModule : shaderModules)
+    {
+        if (!shaderModule->reflection.pushConstants)
+        {
+            continue;
+        }
+        const VkPushConstantRange& block = *shaderModule->reflection.pushConstants;
+        const bool covered = std::ranges::any_of(declared, [&](const VkPushConstantRange& range)
+        {
+            return (range.stageFlags & block.stageFlags) && range.offset <= block.offset &&
+                   block.offset + block.size <= range.offset + range.size;
+        });
+        if (!covered)
+        {
+            std::println("Push constants of {} span bytes {}..{}, no declared range for its stage covers them",
+                shaderModule->path.filename, block.offset, block.offset + block.size);
+            valid = false;
+        }
+    }
+
+    for (const VkPushConstantRange& range : declared)
+    {
+        u32 blockEnd = 0;
+        for (const ShaderModule* shaderModule : shaderModules)
+        {
+            const auto& block = shaderModule->reflection.pushConstants;
+            if (block && (range.stageFlags & block->stageFlags))
+            {
+                blockEnd = std::max(blockEnd, block->offset + block->size);
+            }
+        }
+        const u32 paddedBlockEnd = (blockEnd + 15) & ~15u;
+        if (blockEnd > 0 && range.offset + range.size > paddedBlockEnd)
+        {
+            std::println("Push constant range {}..{} is larger than the shader blocks it covers, they end at {}",
+                range.offset, range.offset + range.size, blockEnd);
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+auto PipelineBuilder::specializationConstant(u32 constantId, u32 value) -> PipelineBuilder&
+{
+    auto entry = std::ranges::find(specializationEntries, constantId, &VkSpecializationMapEntry::constantID);
+    if (entry != specializationEntries.end())
+    {
+        specializationData[entry->offset / sizeof(u32)] = value;
+        return *this;
+    }
+
+    specializationEntries.push_back(VkSpecializationMapEntry{
+        .constantID = constantId,
+        .offset = static_cast<u32>(specializationData.size() * sizeof(u32)),
+        .size = sizeof(u32),
+    });
+    specializationData.push_back(value);
+
+    return *this;
+}
+
+auto PipelineBuilder::specializationInfo() const -> VkSpecializationInfo
+{
+    return VkSpecializationInfo{
+        .mapEntryCount = static_cast<u32>(specializationEntries.size()),
+        .pMapEntries = specializationEntries.data(),
+        .dataSize = specializationData.size() * sizeof(u32),
+        .pData = specializationData.data(),
+    };
+}
+
 auto PipelineBuilder::buildLayout() -> VkPipelineLayout
 {
-    VkPipelineLayout layout;
+    PipelineLayoutCache& cache = backend.pipelineLayoutCache;
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = vkutil::init::layoutCreateInfo(
-layoutInfo.descriptorSetLayouts.data(), layoutInfo.descriptorSetLayouts.size(), layoutInfo.pushConstants.data(),
-layoutInfo.pushConstants.size());
-    if (const VkResult error = vkCreatePipelineLayout(backend.device, &pipelineLayoutInfo, nullptr, &layout))
+    std::map<u32, std::vector<ShaderReflection::Binding>> sets;
+    std::vector<VkPushConstantRange> reflectedPushConstants;
+    for (const ShaderModule* shaderModule : shaderModules)
     {
-        builderError = PipelineError::PipelineLayoutCreateError;
-        VK_CHECK(error);
+        for (const ShaderReflection::Binding& binding : shaderModule->reflection.bindings)
+        {
+            std::vector<ShaderReflection::Binding>& set = sets[binding.set];
+            if (std::ranges::find(set, binding) == set.end())
+            {
+                set.push_back(binding);
+            }
+        }
+
+        const std::optional<VkPushConstantRange>& block = shaderModule->reflection.pushConstants;
+        if (!block)
+        {
+            continue;
+        }
+        auto same = std::ranges::find_if(reflectedPushConstants, [&](const VkPushConstantRange& range)
+        {
+            return range.offset == block->offset && range.size == block->size;
+        });
+        if (same != reflectedPushConstants.end())
+        {
+            same->stageFlags |= block->stageFlags;
+        }
+        else
+        {
+            reflectedPushConstants.push_back(*block);
+        }
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    const u32 setCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+    for (u32 set = 0; set < setCount; ++set)
+    {
+        auto bindings = sets.find(set);
+        setLayouts.push_back(bindings != sets.end()
+            ? cache.setLayout(backend.device, bindings->second)
+            : cache.defaultSetLayout(backend.device, set));
     }
 
-    return layout;
+    if (layoutInfo.pushConstants.empty())
+    {
+        return cache.pipelineLayout(backend.device, setLayouts, reflectedPushConstants);
+    }
+    if (!validatePushConstants(layoutInfo.pushConstants, shaderModules))
+    {
+        builderError = PipelineError::PushConstantMismatch;
+    }
+    return cache.pipelineLayout(backend.device, setLayouts, layoutInfo.pushConstants);
 }
 
 auto PipelineBuilder::buildGraphicsPipeline(VkPipelineLayout layout) -> VkPipeline
@@ -124,9 +239,25 @@ auto PipelineBuilder::buildGraphicsPipeline(VkPipelineLayout layout) -> VkPipeli
         .pDynamicStates = dynamicStates.data()
     };
 
+    // The builder may have been moved since the formats were added
+    renderInfo.pColorAttachmentFormats = colorAttachments.data();
+
+    const VkSpecializationInfo specializationInfo = this->specializationInfo();
+    for (VkPipelineShaderStageCreateInfo& stage : shaderStages)
+    {
+        stage.pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+    }
+
+    VkPipelineCreationFeedback feedback = {};
+    VkPipelineCreationFeedbackCreateInfo feedbackInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+        .pNext = &renderInfo,
+        .pPipelineCreationFeedback = &feedback,
+    };
+
     VkGraphicsPipelineCreateInfo pipelineInfo = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext = &renderInfo,
+        .pNext = &feedbackInfo,
         .stageCount = static_cast<u32>(shaderStages.size()),
         .pStages = shaderStages.data(),
         .pVertexInputState = &vertexInputInfo,
@@ -140,43 +271,93 @@ auto PipelineBuilder::buildGraphicsPipeline(VkPipelineLayout layout) -> VkPipeli
         .layout = layout
     };
 
-    VkPipeline pipeline;
-    if (const VkResult error = vkCreateGraphicsPipelines(backend.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
-        &pipeline))
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (const VkResult error = vkCreateGraphicsPipelines(backend.device, backend.pipelineCache.cache, 1, &pipelineInfo,
+        nullptr, &pipeline))
     {
         builderError = PipelineError::PipelineCreateError;
         VK_CHECK(error);
     }
+    backend.pipelineCache.record(feedback);
 
     return pipeline;
 }
 
 auto PipelineBuilder::buildComputePipeline(VkPipelineLayout layout) -> VkPipeline
 {
-    VkPipeline pipeline;
-    VkComputePipelineCreateInfo pipelineCreateInfo = vkutil::init::computePipelineCreateInfo(layout, shaderStages[0]);
-    if (const VkResult error = vkCreateComputePipelines(backend.device, VK_NULL_HANDLE, 1, &pipelineCreateInfo,
-        nullptr, &pipeline))
+    VkPipelineCreationFeedback feedback = {};
+    VkPipelineCreationFeedbackCreateInfo feedbackInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+        .pPipelineCreationFeedback = &feedback,
+    };
+
+    const VkSpecializationInfo specializationInfo = this->specializationInfo();
+    VkPipelineShaderStageCreateInfo stage = shaderStages[0];
+    stage.pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkComputePipelineCreateInfo pipelineCreateInfo = vkutil::init::computePipelineCreateInfo(layout, stage);
+    pipelineCreateInfo.pNext = &feedbackInfo;
+    if (const VkResult error = vkCreateComputePipelines(backend.device, backend.pipelineCache.cache, 1,
+        &pipelineCreateInfo, nullptr, &pipeline))
     {
         builderError = PipelineError::PipelineCreateError;
         VK_CHECK(error);
     }
+    backend.pipelineCache.record(feedback);
 
     return pipeline;
 }
 
+static auto pipelineErrorName(PipelineError error) -> const char*
+{
+    switch (error)
+    {
+    case PipelineError::ShaderError: return "shader failed to load";
+    case PipelineError::PipelineLayoutCreateError: return "pipeline layout creation failed";
+    case PipelineError::PushConstantMismatch: return "push constants don't match the shaders";
+    case PipelineError::PipelineCreateError: return "pipeline creation failed";
+    }
+    return "unknown error";
+}
+
 auto PipelineBuilder::build() -> Pipeline
 {
     VkPipelineLayout layout = buildLayout();
+    // A pipeline built from a broken description is a bug in the pass, stop right there like VK_CHECK does. The
+    // shader reloader builds layouts itself and skips pipelines with an error instead.
+    if (builderError)
+    {
+        std::println("Building the pipeline using {} failed: {}",
+            shaderModules.empty() ? "no shaders" : shaderModules.front()->path.filename,
+            pipelineErrorName(*builderError));
+        BREAKPOINT;
+    }
+    const VkPipelineBindPoint bindPoint = determinedBindPoint;
+    auto compiled = std::make_shared<std::shared_future<VkPipeline>>();
+    if (backend.shaderReloader)
+    {
+        backend.shaderReloader->track(*this, layout, compiled);
+    }
+    *compiled = compileAsync(std::move(*this), layout);
     return Pipeline {
-        .pipelineBindPoint = determinedBindPoint,
+        .pipelineBindPoint = bindPoint,
         .pipelineLayout = layout,
-        .pipeline = determinedBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS
-            ? buildGraphicsPipeline(layout)
-            : buildComputePipeline(layout)
+        .compiled = std::move(compiled),
     };
 }
 
+auto PipelineBuilder::compileAsync(PipelineBuilder builder, VkPipelineLayout layout) -> std::shared_future<VkPipeline>
+{
+    return workerPool().submit([builder = std::move(builder), layout]() mutable
+    {
+        ZoneScopedN("Compile pipeline");
+        return builder.determinedBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS
+            ? builder.buildGraphicsPipeline(layout)
+            : builder.buildComputePipeline(layout);
+    }).share();
+}
+
 auto PipelineBuilder::topology(VkPrimitiveTopology topology) -> PipelineBuilder&
 {
     inputAssembly.topology = topology;
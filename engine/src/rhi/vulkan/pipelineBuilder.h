@@ -4,6 +4,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include <future>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -12,14 +14,25 @@ class VulkanBackend;
 struct Pipeline
 {
     VkPipelineBindPoint pipelineBindPoint;
+    // Shared with every pipeline of the same layout, owned by the backend's PipelineLayoutCache
     VkPipelineLayout pipelineLayout;
-    VkPipeline pipeline;
+    // Compiled on the worker pool, see PipelineBuilder::build(). Shared by every copy of the pipeline so
+    // ShaderReloader can swap in a recompiled one.
+    std::shared_ptr<std::shared_future<VkPipeline>> compiled;
+
+    // Blocks until the pipeline is compiled, so only its first use can wait
+    [[nodiscard]]
+    auto pipeline() const -> VkPipeline
+    {
+        return compiled->get();
+    }
 };
 
 enum class PipelineError
 {
     ShaderError,
     PipelineLayoutCreateError,
+    PushConstantMismatch,
     PipelineCreateError,
 };
 
@@ -32,10 +45,14 @@ struct PipelineBuilder
 
     struct LayoutInfo
     {
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
         std::vector<VkPushConstantRange> pushConstants;
     } layoutInfo;
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+    // Owned by the backend's ShaderModuleCache
+    std::vector<const ShaderModule*> shaderModules;
+    // Shared by every stage, one u32 per constant
+    std::vector<VkSpecializationMapEntry> specializationEntries;
+    std::vector<u32> specializationData;
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly;
     VkPipelineRasterizationStateCreateInfo rasterizer;
@@ -50,9 +67,12 @@ struct PipelineBuilder
 
     auto reset() -> void;
 
-    auto addDescriptorLayouts(std::initializer_list<VkDescriptorSetLayout>&& descriptorSetLayouts) -> PipelineBuilder&;
+    // The C++ side of the push constants, checked against the shaders' blocks when building. Without any the ranges
+    // are taken from the shaders as they are.
     auto addPushConstants(std::initializer_list<VkPushConstantRange>&& pushConstants) -> PipelineBuilder&;
     auto addShader(ShaderPath path, VkShaderStageFlagBits stage) -> PipelineBuilder&;
+    // Given to every stage, stages not declaring constantId ignore it. Bools take VK_TRUE/VK_FALSE.
+    auto specializationConstant(u32 constantId, u32 value) -> PipelineBuilder&;
     auto topology(VkPrimitiveTopology topology) -> PipelineBuilder&;
     auto polyMode(VkPolygonMode polyMode) -> PipelineBuilder&;
     auto cullMode(VkCullModeFlags cullMode, VkFrontFace frontFace) -> PipelineBuilder&;
@@ -68,8 +88,17 @@ struct PipelineBuilder
     auto addViewportScissorDynamicStates() -> PipelineBuilder&;
     auto enableDepthBias() -> PipelineBuilder&;
 
+    // Descriptor sets come from the shaders' reflection, merged across stages. Sets no stage uses below the highest
+    // one are filled with the layout registered for them, see PipelineLayoutCache::registerSetLayout().
     auto buildLayout() -> VkPipelineLayout;
+    // Points into the builder, only valid while it isn't modified
+    auto specializationInfo() const -> VkSpecializationInfo;
     auto buildGraphicsPipeline(VkPipelineLayout layout) -> VkPipeline;
     auto buildComputePipeline(VkPipelineLayout layout) -> VkPipeline;
+    // The layout is created right away, the pipeline itself is compiled on the worker pool. Passes set up one after
+    // another then compile in parallel and the first frame only waits for the ones it binds. The builder is moved
+    // into the compile job, it's left empty.
     auto build() -> Pipeline;
+    // VK_NULL_HANDLE in the future if the pipeline couldn't be created
+    static auto compileAsync(PipelineBuilder builder, VkPipelineLayout layout) -> std::shared_future<VkPipeline>;
 };
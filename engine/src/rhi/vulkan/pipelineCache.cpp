@@ -0,0 +1,178 @@
+#include "rhi/vulkan/pipelineCache.h"
+
+#include "rhi/vulkan/vulkan.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <print>
+#include <vector>
+
+// Bump whenever PipelineCacheFileHeader changes
+static constexpr u32 kFileVersion = 1;
+static constexpr u32 kMagic = 0x43504b45; // "EKPC"
+
+// Written in front of the driver's blob. Drivers check their own header's UUID but not necessarily the driver
+// version, and a truncated file is better caught before the driver sees it.
+struct PipelineCacheFileHeader
+{
+    u32 magic;
+    u32 version;
+    u32 vendorId;
+    u32 deviceId;
+    u32 driverVersion;
+    u8 pipelineCacheUuid[VK_UUID_SIZE];
+    u64 dataSize;
+    u64 dataHash;
+};
+
+// FNV-1a
+static auto dataHash(const std::vector<u8>& data) -> u64
+{
+    u64 hash = 0xcbf29ce484222325ull;
+    for (const u8 byte : data)
+    {
+        hash = (hash ^ byte) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static auto fileHeader(const VkPhysicalDeviceProperties& properties) -> PipelineCacheFileHeader
+{
+    PipelineCacheFileHeader header = {
+        .magic = kMagic,
+        .version = kFileVersion,
+        .vendorId = properties.vendorID,
+        .deviceId = properties.deviceID,
+        .driverVersion = properties.driverVersion,
+    };
+    std::memcpy(header.pipelineCacheUuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+// Empty if there is no usable cache on disk
+static auto readCacheFile(const std::string& path, const VkPhysicalDeviceProperties& properties) -> std::vector<u8>
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return {};
+    }
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+
+    PipelineCacheFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    const PipelineCacheFileHeader expected = fileHeader(properties);
+    if (!file || header.magic != expected.magic || header.version != expected.version)
+    {
+        std::println("Ignoring malformed pipeline cache {}", path);
+        return {};
+    }
+    if (header.vendorId != expected.vendorId || header.deviceId != expected.deviceId ||
+        header.driverVersion != expected.driverVersion ||
+        std::memcmp(header.pipelineCacheUuid, expected.pipelineCacheUuid, VK_UUID_SIZE) != 0)
+    {
+        std::println("Pipeline cache {} was written by a different device or driver, starting empty", path);
+        return {};
+    }
+
+    // Checked before allocating, a garbage size would otherwise throw
+    if (fileSize < 0 || header.dataSize > static_cast<u64>(fileSize) - sizeof(header))
+    {
+        std::println("Ignoring truncated pipeline cache {}", path);
+        return {};
+    }
+
+    std::vector<u8> data(header.dataSize);
+    file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file || dataHash(data) != header.dataHash)
+    {
+        std::println("Ignoring truncated pipeline cache {}", path);
+        return {};
+    }
+    return data;
+}
+
+auto PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string path) -> void
+{
+    this->path = std::move(path);
+    this->properties = properties;
+
+    const std::vector<u8> data = readCacheFile(this->path, properties);
+    VkPipelineCacheCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData = data.data(),
+    };
+    if (vkCreatePipelineCache(device, &info, nullptr, &cache) != VK_SUCCESS)
+    {
+        // The driver may still reject what passed the header checks
+        std::println("Driver rejected pipeline cache {}, starting empty", this->path);
+        info.initialDataSize = 0;
+        info.pInitialData = nullptr;
+        VK_CHECK(vkCreatePipelineCache(device, &info, nullptr, &cache));
+        return;
+    }
+    loadedBytes = data.size();
+}
+
+auto PipelineCache::save(VkDevice device) -> bool
+{
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, nullptr));
+    std::vector<u8> data(size);
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, data.data()));
+    data.resize(size);
+
+    PipelineCacheFileHeader header = fileHeader(properties);
+    header.dataSize = data.size();
+    header.dataHash = dataHash(data);
+
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file)
+        {
+            std::println("Failed writing pipeline cache {}", temporaryPath.string());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        return false;
+    }
+
+    std::println("Saved pipeline cache {}: {} bytes, this run {} hits, {} misses, {:.1f} ms creating pipelines", path,
+        data.size(), hits.load(), misses.load(), creationNs.load() / 1e6);
+    return true;
+}
+
+auto PipelineCache::destroy(VkDevice device) -> void
+{
+    vkDestroyPipelineCache(device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+}
+
+auto PipelineCache::record(const VkPipelineCreationFeedback& feedback) -> void
+{
+    if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT))
+    {
+        return;
+    }
+    if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT)
+    {
+        hits++;
+    }
+    else
+    {
+        misses++;
+    }
+    creationNs += feedback.duration;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "engine.h"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <string>
+
+// VkPipelineCache kept on disk between runs. The blob is only handed back to the driver if it was written by the
+// same device and driver version, anything else starts over with an empty cache.
+struct PipelineCache
+{
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    std::string path;
+    VkPhysicalDeviceProperties properties;
+
+    // From VK_EXT_pipeline_creation_feedback, pipelines the driver found in the cache vs compiled
+    std::atomic<u32> hits = 0;
+    std::atomic<u32> misses = 0;
+    std::atomic<u64> creationNs = 0;
+    u64 loadedBytes = 0;
+
+    auto init(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string path) -> void;
+    // Written to a temporary file and renamed, a crash never leaves a torn cache behind
+    auto save(VkDevice device) -> bool;
+    auto destroy(VkDevice device) -> void;
+
+    auto record(const VkPipelineCreationFeedback& feedback) -> void;
+};
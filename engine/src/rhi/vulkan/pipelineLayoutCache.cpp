@@ -0,0 +1,117 @@
+#include "rhi/vulkan/pipelineLayoutCache.h"
+
+#include "rhi/vulkan/descriptors.h"
+#include "rhi/vulkan/vulkan.h"
+
+#include <algorithm>
+
+static auto sortedBindings(std::vector<ShaderReflection::Binding> bindings) -> std::vector<ShaderReflection::Binding>
+{
+    for (auto& binding : bindings)
+    {
+        binding.set = 0;
+    }
+    std::ranges::sort(bindings, {}, &ShaderReflection::Binding::binding);
+    return bindings;
+}
+
+static auto samePushConstants(const std::vector<VkPushConstantRange>& a, const std::vector<VkPushConstantRange>& b)
+    -> bool
+{
+    return std::ranges::equal(a, b, [](const VkPushConstantRange& x, const VkPushConstantRange& y)
+    {
+        return x.stageFlags == y.stageFlags && x.offset == y.offset && x.size == y.size;
+    });
+}
+
+auto PipelineLayoutCache::registerSetLayout(u32 set, std::vector<ShaderReflection::Binding> bindings,
+    VkDescriptorSetLayout layout) -> void
+{
+    setLayouts.push_back(SetLayout{
+        .bindings = sortedBindings(std::move(bindings)),
+        .layout = layout,
+        .defaultForSet = set,
+    });
+}
+
+auto PipelineLayoutCache::setLayout(VkDevice device, std::vector<ShaderReflection::Binding> bindings)
+    -> VkDescriptorSetLayout
+{
+    bindings = sortedBindings(std::move(bindings));
+    for (const SetLayout& cached : setLayouts)
+    {
+        if (cached.bindings == bindings)
+        {
+            return cached.layout;
+        }
+    }
+
+    DescriptorSetLayoutBuilder builder;
+    for (const auto& binding : bindings)
+    {
+        // Runtime arrays only ever come from registered layouts, anything else gets a single descriptor
+        builder.addBinding(binding.binding, binding.type, {}, std::max(binding.count, 1u));
+    }
+    setLayouts.push_back(SetLayout{
+        .bindings = std::move(bindings),
+        .layout = builder.build(device, VK_SHADER_STAGE_ALL),
+    });
+    return setLayouts.back().layout;
+}
+
+auto PipelineLayoutCache::defaultSetLayout(VkDevice device, u32 set) -> VkDescriptorSetLayout
+{
+    for (const SetLayout& cached : setLayouts)
+    {
+        if (cached.defaultForSet == set)
+        {
+            return cached.layout;
+        }
+    }
+    return setLayout(device, {});
+}
+
+auto PipelineLayoutCache::pipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& sets,
+    const std::vector<VkPushConstantRange>& pushConstants) -> VkPipelineLayout
+{
+    for (const PipelineLayout& cached : pipelineLayouts)
+    {
+        if (cached.setLayouts == sets && samePushConstants(cached.pushConstants, pushConstants))
+        {
+            return cached.layout;
+        }
+    }
+
+    const VkPipelineLayoutCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = static_cast<u32>(sets.size()),
+        .pSetLayouts = sets.data(),
+        .pushConstantRangeCount = static_cast<u32>(pushConstants.size()),
+        .pPushConstantRanges = pushConstants.data(),
+    };
+    VkPipelineLayout layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &info, nullptr, &layout));
+    pipelineLayouts.push_back(PipelineLayout{
+        .setLayouts = sets,
+        .pushConstants = pushConstants,
+        .layout = layout,
+    });
+    return layout;
+}
+
+auto PipelineLayoutCache::destroy(VkDevice device) -> void
+{
+    for (const PipelineLayout& cached : pipelineLayouts)
+    {
+        vkDestroyPipelineLayout(device, cached.layout, nullptr);
+    }
+    for (const SetLayout& cached : setLayouts)
+    {
+        if (!cached.defaultForSet)
+        {
+            vkDestroyDescriptorSetLayout(device, cached.layout, nullptr);
+        }
+    }
+    pipelineLayouts.clear();
+    setLayouts.clear();
+}
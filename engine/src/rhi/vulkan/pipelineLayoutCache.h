@@ -0,0 +1,45 @@
+#pragma once
+
+#include "engine.h"
+#include "rhi/vulkan/shader.h"
+
+#include <vulkan/vulkan.h>
+
+#include <optional>
+#include <vector>
+
+// Pipeline layouts derived from shader reflection. Sets with the same bindings share one VkDescriptorSetLayout and
+// pipelines with the same sets and push constant ranges share one VkPipelineLayout, so the cache owns both.
+struct PipelineLayoutCache
+{
+    struct SetLayout
+    {
+        std::vector<ShaderReflection::Binding> bindings;
+        VkDescriptorSetLayout layout;
+        // Only for registered layouts, which stay owned by whoever registered them. See registerSetLayout().
+        std::optional<u32> defaultForSet;
+    };
+    struct PipelineLayout
+    {
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        std::vector<VkPushConstantRange> pushConstants;
+        VkPipelineLayout layout;
+    };
+
+    std::vector<SetLayout> setLayouts;
+    std::vector<PipelineLayout> pipelineLayouts;
+
+    // Layouts created elsewhere, the scene and bindless sets, which need their own flags and are bound with sets
+    // allocated against them. Reflected sets with the same bindings resolve to layout, which also fills set when
+    // a pipeline doesn't use it itself, so the set can be bound for every pass.
+    auto registerSetLayout(u32 set, std::vector<ShaderReflection::Binding> bindings, VkDescriptorSetLayout layout)
+        -> void;
+
+    // Bindings are sorted by binding, their set is ignored
+    auto setLayout(VkDevice device, std::vector<ShaderReflection::Binding> bindings) -> VkDescriptorSetLayout;
+    auto defaultSetLayout(VkDevice device, u32 set) -> VkDescriptorSetLayout;
+    auto pipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& sets,
+        const std::vector<VkPushConstantRange>& pushConstants) -> VkPipelineLayout;
+
+    auto destroy(VkDevice device) -> void;
+};
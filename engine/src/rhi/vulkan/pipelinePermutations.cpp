@@ -0,0 +1,33 @@
+#include "rhi/vulkan/pipelinePermutations.h"
+
+auto PipelinePermutations::prewarm() -> PipelinePermutations&
+{
+    for (u32 features = 0; features < (1u << featureCount); ++features)
+    {
+        get(features);
+    }
+
+    return *this;
+}
+
+auto PipelinePermutations::get(u32 features) -> const Pipeline&
+{
+    features &= (1u << featureCount) - 1;
+    auto cached = pipelines.find(features);
+    if (cached != pipelines.end())
+    {
+        return cached->second;
+    }
+
+    PipelineBuilder permutation = builder;
+    // The modules captured when the builder was set up are destroyed once a hot reload replaces them
+    for (size_t i = 0; i < permutation.shaderStages.size(); ++i)
+    {
+        permutation.shaderStages[i].module = permutation.shaderModules[i]->module;
+    }
+    for (u32 i = 0; i < featureCount; ++i)
+    {
+        permutation.specializationConstant(firstConstantId + i, (features >> i) & 1 ? VK_TRUE : VK_FALSE);
+    }
+    return pipelines.emplace(features, permutation.build()).first->second;
+}
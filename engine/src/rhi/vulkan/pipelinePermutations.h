@@ -0,0 +1,29 @@
+#pragma once
+
+#include "engine.h"
+#include "rhi/vulkan/pipelineBuilder.h"
+
+#include <unordered_map>
+
+// Pipelines specialized from one builder by a feature key. Bit i of the key sets specialization constant
+// firstConstantId + i to VK_TRUE or VK_FALSE, so a disabled feature is compiled out of the shaders instead of
+// branched over at runtime. Specialization doesn't change the layout, every permutation shares the builder's.
+struct PipelinePermutations
+{
+    PipelineBuilder builder;
+    u32 featureCount;
+    u32 firstConstantId;
+
+    std::unordered_map<u32, Pipeline> pipelines;
+
+    PipelinePermutations(const PipelineBuilder& builder, u32 featureCount, u32 firstConstantId = 0)
+        : builder(builder), featureCount(featureCount), firstConstantId(firstConstantId)
+    {
+    }
+
+    // Builds every permutation up front so switching features never waits on a compile. They compile on the worker
+    // pool in parallel.
+    auto prewarm() -> PipelinePermutations&;
+    // Built on first use otherwise
+    auto get(u32 features) -> const Pipeline&;
+};
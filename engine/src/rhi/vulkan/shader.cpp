@@ -1,5 +1,8 @@
 #include "rhi/vulkan/shader.h"
 
+#include "spirv_reflect.h"
+
+#include <algorithm>
 #include <fstream>
 #include <print>
 
@@ -21,6 +24,60 @@ auto readFile(std::string path) -> std::vector<u32>
     return buffer;
 }
 
+static auto reflect(const std::vector<u32>& spirvCode) -> std::optional<ShaderReflection>
+{
+    SpvReflectShaderModule module;
+    if (spvReflectCreateShaderModule(spirvCode.size() * sizeof(u32), spirvCode.data(), &module) !=
+        SPV_REFLECT_RESULT_SUCCESS)
+    {
+        return {};
+    }
+
+    ShaderReflection reflection = {
+        .stage = static_cast<VkShaderStageFlagBits>(module.shader_stage),
+    };
+
+    u32 bindingCount = 0;
+    spvReflectEnumerateDescriptorBindings(&module, &bindingCount, nullptr);
+    std::vector<SpvReflectDescriptorBinding*> bindings(bindingCount);
+    spvReflectEnumerateDescriptorBindings(&module, &bindingCount, bindings.data());
+    for (const SpvReflectDescriptorBinding* binding : bindings)
+    {
+        const bool runtimeArray = binding->type_description->op == SpvOpTypeRuntimeArray;
+        reflection.bindings.push_back(ShaderReflection::Binding{
+            .set = binding->set,
+            .binding = binding->binding,
+            .type = static_cast<VkDescriptorType>(binding->descriptor_type),
+            .count = runtimeArray ? 0 : binding->count,
+        });
+    }
+
+    // GLSL allows a single push constant block per stage
+    u32 blockCount = 0;
+    spvReflectEnumeratePushConstantBlocks(&module, &blockCount, nullptr);
+    std::vector<SpvReflectBlockVariable*> blocks(blockCount);
+    spvReflectEnumeratePushConstantBlocks(&module, &blockCount, blocks.data());
+    if (!blocks.empty() && blocks[0]->member_count > 0)
+    {
+        u32 begin = ~0u;
+        u32 end = 0;
+        for (u32 i = 0; i < blocks[0]->member_count; ++i)
+        {
+            const SpvReflectBlockVariable& member = blocks[0]->members[i];
+            begin = std::min(begin, member.offset);
+            end = std::max(end, member.offset + member.size);
+        }
+        reflection.pushConstants = VkPushConstantRange{
+            .stageFlags = reflection.stage,
+            .offset = begin,
+            .size = end - begin,
+        };
+    }
+
+    spvReflectDestroyShaderModule(&module);
+    return reflection;
+}
+
 auto ShaderModuleCache::loadModule(VkDevice device, ShaderPath path) -> std::optional<ShaderModule*>
 {
     auto moduleFromCache = cache.find(path);
@@ -37,6 +94,15 @@ auto ShaderModuleCache::loadModule(VkDevice device, ShaderPath path) -> std::opt
     module.spirvCode = readFile(path.spirvPath);
     // TODO: add source code here for debugging
 
+    std::optional<ShaderReflection> reflection = reflect(module.spirvCode);
+    if (!reflection)
+    {
+        std::println("Failed reflecting {}", path.filename);
+        cache.erase(path);
+        return {};
+    }
+    module.reflection = std::move(*reflection);
+
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.pNext = nullptr;
@@ -55,3 +121,44 @@ auto ShaderModuleCache::loadModule(VkDevice device, ShaderPath path) -> std::opt
 
     return &module;
 }
+
+auto ShaderModuleCache::find(const std::string& filename) -> ShaderModule*
+{
+    for (auto& [path, module] : cache)
+    {
+        if (path.filename == filename)
+        {
+            return &module;
+        }
+    }
+    return nullptr;
+}
+
+auto ShaderModuleCache::reload(VkDevice device, ShaderModule& module, std::vector<u32> spirvCode)
+    -> std::optional<VkShaderModule>
+{
+    std::optional<ShaderReflection> reflection = reflect(spirvCode);
+    if (!reflection)
+    {
+        std::println("Failed reflecting {}", module.path.filename);
+        return {};
+    }
+
+    const VkShaderModuleCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = spirvCode.size() * sizeof(u32),
+        .pCode = spirvCode.data(),
+    };
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    {
+        std::println("Failed creating a shader module for {}", module.path.filename);
+        return {};
+    }
+
+    const VkShaderModule replaced = module.module;
+    module.spirvCode = std::move(spirvCode);
+    module.reflection = std::move(*reflection);
+    module.module = shaderModule;
+    return replaced;
+}
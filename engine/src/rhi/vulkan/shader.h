@@ -9,7 +9,11 @@
 #include <unordered_map>
 #include <vector>
 
-#define SHADER_SRC_PATH "../src/shaders/"
+// Set by CMake to engine/shaders
+#ifndef SHADER_SRC_DIRECTORY
+#define SHADER_SRC_DIRECTORY "../engine/shaders"
+#endif
+#define SHADER_SRC_PATH SHADER_SRC_DIRECTORY "/"
 #define SHADER_SPIRV_PATH "./shaders/"
 #define SHADER_SPIRV_EXTENSION ".spv"
 
@@ -40,21 +44,49 @@ struct ShaderPath
 };
 #define SHADER_PATH(filename) ShaderPath(SHADER_FILENAME_AND_SPIRV_AND_SRC_PATH(filename))
 
+// What a module declares, from SPIRV-Reflect
+struct ShaderReflection
+{
+    struct Binding
+    {
+        u32 set;
+        u32 binding;
+        VkDescriptorType type;
+        // 0 for runtime sized arrays
+        u32 count;
+
+        bool operator==(const Binding& other) const = default;
+    };
+
+    VkShaderStageFlagBits stage;
+    std::vector<Binding> bindings;
+    // From the first member of the push constant block to the end of the last one, the block's own offset
+    // qualifiers included
+    std::optional<VkPushConstantRange> pushConstants;
+};
+
 struct ShaderModule
 {
     ShaderPath path;
 
     std::vector<u32> spirvCode;
+    ShaderReflection reflection;
 
     VkShaderModule module;
 
     explicit ShaderModule(ShaderPath path) : path(path) {}
 };
 
+auto readFile(std::string path) -> std::vector<u32>;
+
+// Edited shaders are swapped in by ShaderReloader
 struct ShaderModuleCache
 {
-    // TODO: watcher to reload shaders
     std::unordered_map<ShaderPath, ShaderModule, ShaderPath::Hash> cache;
 
     auto loadModule(VkDevice device, ShaderPath path) -> std::optional<ShaderModule*>;
+    auto find(const std::string& filename) -> ShaderModule*;
+    // Replaces the module's code in place and returns the VkShaderModule it had, pipelines may still be compiling
+    // with that one. Nullopt if the new code is unusable, the module is left as it was.
+    auto reload(VkDevice device, ShaderModule& module, std::vector<u32> spirvCode) -> std::optional<VkShaderModule>;
 };
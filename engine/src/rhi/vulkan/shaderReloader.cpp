@@ -0,0 +1,354 @@
+#include "rhi/vulkan/shaderReloader.h"
+
+#include "rhi/vulkan/backend.h"
+#include "rhi/vulkan/shader.h"
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <print>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Set by CMake to the glslc the build compiles shaders with
+#ifndef GLSLC_PATH
+#define GLSLC_PATH "glslc"
+#endif
+
+using IncludeGraph = std::map<std::string, std::vector<std::string>>;
+
+// Files #included by every source in directory
+static auto includeGraph(const std::string& directory) -> IncludeGraph
+{
+    IncludeGraph graph;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (entry.path().extension() != ".glsl")
+        {
+            continue;
+        }
+
+        std::vector<std::string>& includes = graph[entry.path().filename().string()];
+        std::ifstream file(entry.path());
+        for (std::string line; std::getline(file, line);)
+        {
+            const size_t directive = line.find("#include");
+            const size_t open = directive == std::string::npos ? directive : line.find('"', directive);
+            const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close != std::string::npos)
+            {
+                includes.push_back(line.substr(open + 1, close - open - 1));
+            }
+        }
+    }
+    return graph;
+}
+
+static auto includesAny(const std::string& file, const std::set<std::string>& changedFiles, const IncludeGraph& graph,
+    std::set<std::string>& visited) -> bool
+{
+    if (changedFiles.contains(file))
+    {
+        return true;
+    }
+    const auto includes = graph.find(file);
+    if (!visited.insert(file).second || includes == graph.end())
+    {
+        return false;
+    }
+    return std::ranges::any_of(includes->second,
+        [&](const std::string& include) { return includesAny(include, changedFiles, graph, visited); });
+}
+
+// "mesh.frag.glsl" -> "frag", empty for files that are only ever included. Same naming the CMake shader rules use.
+static auto shaderStage(const std::string& filename) -> std::string
+{
+    const std::string name = filename.substr(0, filename.rfind(".glsl"));
+    const size_t dot = name.rfind('.');
+    return dot == std::string::npos ? std::string() : name.substr(dot + 1);
+}
+
+ShaderReloader::ShaderReloader(VulkanBackend& backend) : backend(&backend), sourceDirectory(SHADER_SRC_DIRECTORY)
+{
+    watcher = std::jthread([this](std::stop_token stop) { watch(stop); });
+}
+
+ShaderReloader::~ShaderReloader()
+{
+    watcher.request_stop();
+    vkDeviceWaitIdle(backend->device);
+
+    for (const PendingPipeline& pending : pendingPipelines)
+    {
+        vkDestroyPipeline(backend->device, pending.recompiled.get(), nullptr);
+    }
+    for (const RetiredPipeline& retired : retiredPipelines)
+    {
+        vkDestroyPipeline(backend->device, retired.pipeline, nullptr);
+    }
+    for (const std::shared_future<VkPipeline>& superseded : supersededPipelines)
+    {
+        vkDestroyPipeline(backend->device, superseded.get(), nullptr);
+    }
+    for (const TrackedPipeline& tracked : pipelines)
+    {
+        tracked.compiled->wait();
+    }
+    for (const VkShaderModule module : retiredModules)
+    {
+        vkDestroyShaderModule(backend->device, module, nullptr);
+    }
+}
+
+auto ShaderReloader::track(const PipelineBuilder& builder, VkPipelineLayout layout,
+    std::shared_ptr<std::shared_future<VkPipeline>> compiled) -> void
+{
+    pipelines.push_back(TrackedPipeline{
+        .builder = builder,
+        .layout = layout,
+        .compiled = std::move(compiled),
+    });
+}
+
+auto ShaderReloader::untrack(const Pipeline& pipeline) -> void
+{
+    std::erase_if(pipelines, [&](const TrackedPipeline& tracked) { return tracked.compiled == pipeline.compiled; });
+    // A reload still compiling would be swapped into the destroyed pipeline, drop it instead
+    std::erase_if(pendingPipelines, [&](const PendingPipeline& pending)
+    {
+        if (pending.compiled != pipeline.compiled)
+        {
+            return false;
+        }
+        if (const VkPipeline recompiled = pending.recompiled.get(); recompiled != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(backend->device, recompiled, nullptr);
+        }
+        return true;
+    });
+}
+
+auto ShaderReloader::update(u64 frameNumber) -> void
+{
+    ZoneScoped;
+    using namespace std::chrono_literals;
+
+    const auto ready = [](const std::shared_future<VkPipeline>& future)
+    {
+        return future.wait_for(0s) == std::future_status::ready;
+    };
+
+    // Finished recompiles are used from this frame on, the pipelines they replace may still be in flight
+    std::erase_if(pendingPipelines, [&](const PendingPipeline& pending)
+    {
+        if (!ready(pending.recompiled) || !ready(*pending.compiled))
+        {
+            return false;
+        }
+        if (pending.recompiled.get() != VK_NULL_HANDLE)
+        {
+            retiredPipelines.push_back(RetiredPipeline{.pipeline = pending.compiled->get(), .frameNumber = frameNumber});
+            *pending.compiled = pending.recompiled;
+        }
+        return true;
+    });
+    std::erase_if(retiredPipelines, [&](const RetiredPipeline& retired)
+    {
+        if (retired.frameNumber + VulkanBackend::MaxFramesInFlight > frameNumber)
+        {
+            return false;
+        }
+        vkDestroyPipeline(backend->device, retired.pipeline, nullptr);
+        return true;
+    });
+    // Never bound, no frame in flight can be using them
+    std::erase_if(supersededPipelines, [&](const std::shared_future<VkPipeline>& superseded)
+    {
+        if (!ready(superseded))
+        {
+            return false;
+        }
+        vkDestroyPipeline(backend->device, superseded.get(), nullptr);
+        return true;
+    });
+
+    const bool compiling = !pendingPipelines.empty() || !supersededPipelines.empty() ||
+        std::ranges::any_of(pipelines, [&](const TrackedPipeline& tracked) { return !ready(*tracked.compiled); });
+    if (!compiling)
+    {
+        for (const VkShaderModule module : retiredModules)
+        {
+            vkDestroyShaderModule(backend->device, module, nullptr);
+        }
+        retiredModules.clear();
+    }
+
+    std::vector<CompiledShader> shaders;
+    {
+        std::lock_guard lock(compiledMutex);
+        std::swap(shaders, compiled);
+    }
+    if (shaders.empty())
+    {
+        return;
+    }
+
+    std::vector<const ShaderModule*> reloaded;
+    for (CompiledShader& shader : shaders)
+    {
+        // Shaders no pipeline was built with yet are loaded from disk as usual once one is
+        ShaderModule* module = backend->shaderModuleCache.find(shader.filename);
+        if (module == nullptr)
+        {
+            continue;
+        }
+        const std::optional<VkShaderModule> replaced =
+            backend->shaderModuleCache.reload(backend->device, *module, std::move(shader.spirvCode));
+        if (replaced)
+        {
+            retiredModules.push_back(*replaced);
+            reloaded.push_back(module);
+        }
+    }
+
+    for (const TrackedPipeline& tracked : pipelines)
+    {
+        const bool affected = std::ranges::any_of(tracked.builder.shaderModules,
+            [&](const ShaderModule* module) { return std::ranges::find(reloaded, module) != reloaded.end(); });
+        if (!affected)
+        {
+            continue;
+        }
+
+        PipelineBuilder builder = tracked.builder;
+        builder.builderError = {};
+        for (size_t i = 0; i < builder.shaderStages.size(); ++i)
+        {
+            builder.shaderStages[i].module = builder.shaderModules[i]->module;
+        }
+
+        // Passes keep using the layout they were built with, a pipeline needing another one waits for a restart
+        const VkPipelineLayout layout = builder.buildLayout();
+        if (builder.builderError || layout != tracked.layout)
+        {
+            std::println("Not reloading the pipeline using {}, its pipeline layout changed",
+                builder.shaderModules.front()->path.filename);
+            continue;
+        }
+        // Saved again before the last reload was applied. Whichever finished first would otherwise win, possibly
+        // the older one, so only the newest recompile is kept.
+        std::shared_future<VkPipeline> recompiled = PipelineBuilder::compileAsync(std::move(builder), layout);
+        const auto pending = std::ranges::find_if(pendingPipelines,
+            [&](const PendingPipeline& pending) { return pending.compiled == tracked.compiled; });
+        if (pending != pendingPipelines.end())
+        {
+            supersededPipelines.push_back(std::move(pending->recompiled));
+            pending->recompiled = std::move(recompiled);
+            continue;
+        }
+        pendingPipelines.push_back(PendingPipeline{
+            .compiled = tracked.compiled,
+            .recompiled = std::move(recompiled),
+        });
+    }
+}
+
+#if defined(__linux__)
+auto ShaderReloader::watch(std::stop_token stop) -> void
+{
+    const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // Editors often save by writing a new file and renaming it over the old one
+    if (fd < 0 || inotify_add_watch(fd, sourceDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::println("Failed watching {}, shaders won't be reloaded", sourceDirectory);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return;
+    }
+
+    std::set<std::string> changedFiles;
+    alignas(inotify_event) char events[4096];
+    while (!stop.stop_requested())
+    {
+        // Changes are picked up once no event came in for the timeout, a save touching several files or firing
+        // several events recompiles once
+        pollfd watched = {.fd = fd, .events = POLLIN};
+        if (poll(&watched, 1, 100) > 0)
+        {
+            for (ssize_t size; (size = read(fd, events, sizeof(events))) > 0;)
+            {
+                for (const char* at = events; at < events + size;)
+                {
+                    const auto* event = reinterpret_cast<const inotify_event*>(at);
+                    if (event->len > 0 && std::string_view(event->name).ends_with(".glsl"))
+                    {
+                        changedFiles.insert(event->name);
+                    }
+                    at += sizeof(inotify_event) + event->len;
+                }
+            }
+            continue;
+        }
+
+        if (!changedFiles.empty())
+        {
+            recompile(changedFiles);
+            changedFiles.clear();
+        }
+    }
+    close(fd);
+}
+#else
+auto ShaderReloader::watch(std::stop_token stop) -> void
+{
+    std::println("Shader hot reloading is only supported on Linux");
+}
+#endif
+
+auto ShaderReloader::recompile(const std::set<std::string>& changedFiles) -> void
+{
+    ZoneScoped;
+
+    const IncludeGraph graph = includeGraph(sourceDirectory);
+    for (const auto& [filename, includes] : graph)
+    {
+        const std::string stage = shaderStage(filename);
+        std::set<std::string> visited;
+        if (stage.empty() || !includesAny(filename, changedFiles, graph, visited))
+        {
+            continue;
+        }
+
+        // Written over the build's output, so the next run starts with the edit too
+        const std::string spirvPath = std::string(SHADER_SPIRV_PATH) + filename + SHADER_SPIRV_EXTENSION;
+        const std::string temporaryPath = spirvPath + ".tmp";
+        const std::string command = std::format(R"("{}" -g -I"{}" -fshader-stage={} "{}/{}" -o "{}")", GLSLC_PATH,
+            sourceDirectory, stage, sourceDirectory, filename, temporaryPath);
+        std::println("Recompiling {}", filename);
+        // glslc prints the errors itself
+        if (std::system(command.c_str()) != 0)
+        {
+            std::println("Failed compiling {}, keeping the loaded version", filename);
+            continue;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, spirvPath, error);
+        std::vector<u32> spirvCode = readFile(error ? temporaryPath : spirvPath);
+
+        std::lock_guard lock(compiledMutex);
+        compiled.push_back(CompiledShader{.filename = filename, .spirvCode = std::move(spirvCode)});
+    }
+}
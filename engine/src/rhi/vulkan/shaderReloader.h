@@ -0,0 +1,84 @@
+#pragma once
+
+#include "engine.h"
+#include "rhi/vulkan/pipelineBuilder.h"
+
+#include <vulkan/vulkan.h>
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class VulkanBackend;
+
+// Watches the GLSL sources and recompiles every stage shader an edited file ends up in, #includes followed, with
+// glslc on a background thread. update() swaps the new code into the loaded modules and recompiles the pipelines
+// built from them on the worker pool. The old pipelines stay bound until the new ones are done, a reload never
+// stalls a frame.
+//
+// Watching uses inotify, elsewhere the reloader never sees an edit.
+struct ShaderReloader
+{
+    struct CompiledShader
+    {
+        std::string filename;
+        std::vector<u32> spirvCode;
+    };
+    struct TrackedPipeline
+    {
+        // Copy taken before the original was moved into its compile job
+        PipelineBuilder builder;
+        VkPipelineLayout layout;
+        std::shared_ptr<std::shared_future<VkPipeline>> compiled;
+    };
+    struct PendingPipeline
+    {
+        std::shared_ptr<std::shared_future<VkPipeline>> compiled;
+        std::shared_future<VkPipeline> recompiled;
+    };
+    struct RetiredPipeline
+    {
+        VkPipeline pipeline;
+        u64 frameNumber;
+    };
+
+    VulkanBackend* backend;
+    std::string sourceDirectory;
+
+    // Filled by the watcher thread
+    std::mutex compiledMutex;
+    std::vector<CompiledShader> compiled;
+
+    std::vector<TrackedPipeline> pipelines;
+    std::vector<PendingPipeline> pendingPipelines;
+    std::vector<RetiredPipeline> retiredPipelines;
+    // Recompiles a newer one replaced before they were applied, destroyed once they finish
+    std::vector<std::shared_future<VkPipeline>> supersededPipelines;
+    // Pipeline compile jobs may still use these, destroyed once none is left running
+    std::vector<VkShaderModule> retiredModules;
+
+    // Last so it's stopped and joined before anything it uses is destroyed
+    std::jthread watcher;
+
+    explicit ShaderReloader(VulkanBackend& backend);
+    ~ShaderReloader();
+
+    ShaderReloader(const ShaderReloader&) = delete;
+    auto operator=(const ShaderReloader&) -> ShaderReloader& = delete;
+
+    // Called by PipelineBuilder::build() for every pipeline
+    auto track(const PipelineBuilder& builder, VkPipelineLayout layout,
+        std::shared_ptr<std::shared_future<VkPipeline>> compiled) -> void;
+    // Has to be called before a tracked pipeline is destroyed, see VulkanBackend::destroyPipeline()
+    auto untrack(const Pipeline& pipeline) -> void;
+    // Meant to be called once per frame, after the frame's fence was waited on
+    auto update(u64 frameNumber) -> void;
+
+    // Watcher thread
+    auto watch(std::stop_token stop) -> void;
+    auto recompile(const std::set<std::string>& changedFiles) -> void;
+};
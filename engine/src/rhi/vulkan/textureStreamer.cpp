@@ -0,0 +1,221 @@
+#include "rhi/vulkan/textureStreamer.h"
+
+#include "memory/arenaAllocator.h"
+#include "rhi/vulkan/backend.h"
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static auto residentSize(const Ktx2Image& image, u32 fromMip) -> u64
+{
+    u64 bytes = 0;
+    for (u32 mip = fromMip; mip < image.levels.size(); ++mip)
+    {
+        bytes += image.levels[mip].size();
+    }
+    return bytes;
+}
+
+// Levels from mip down as a standalone image
+static auto mipRange(const Ktx2Image& image, u32 mip) -> Ktx2Image
+{
+    return Ktx2Image{
+        .format = image.format,
+        .width = std::max(image.width >> mip, 1u),
+        .height = std::max(image.height >> mip, 1u),
+        .levels = std::vector(image.levels.begin() + mip, image.levels.end()),
+    };
+}
+
+auto TextureStreamer::add(std::string name, MappedFile file, Ktx2Image image) -> std::optional<Texture>
+{
+    if (auto existing = find(name))
+    {
+        return existing;
+    }
+
+    const u32 lastMip = static_cast<u32>(image.levels.size()) - 1;
+    u32 tailMip = 0;
+    while (tailMip < lastMip && std::max(image.width >> tailMip, image.height >> tailMip) > tailSize)
+    {
+        tailMip++;
+    }
+
+    auto texture = createCompressedTexture(*backend, mipRange(image, tailMip));
+    if (!texture)
+    {
+        return std::nullopt;
+    }
+
+    const u32 index = static_cast<u32>(entries.size());
+    entryByName[name] = index;
+    entryByView[texture->view] = index;
+    residentBytes += residentSize(image, tailMip);
+    entries.push_back(Entry{
+        .name = std::move(name),
+        .file = std::move(file),
+        .source = std::move(image),
+        .texture = *texture,
+        .residentMip = tailMip,
+        .tailMip = tailMip,
+        .requestedMip = tailMip,
+    });
+    return texture;
+}
+
+auto TextureStreamer::find(const std::string& name) const -> std::optional<Texture>
+{
+    if (const auto entry = entryByName.find(name); entry != entryByName.end())
+    {
+        return entries[entry->second].texture;
+    }
+    return std::nullopt;
+}
+
+auto TextureStreamer::track(BindlessTexture handle, const Texture& texture) -> void
+{
+    if (const auto entry = entryByView.find(texture.view); entry != entryByView.end())
+    {
+        entries[entry->second].handles.push_back(handle);
+        entryByHandle[handle] = entry->second;
+    }
+}
+
+auto TextureStreamer::request(BindlessTexture handle, f32 screenPixels, u64 frameNumber) -> void
+{
+    const auto found = entryByHandle.find(handle);
+    if (found == entryByHandle.end())
+    {
+        return;
+    }
+    Entry& entry = entries[found->second];
+
+    // About one texel per pixel
+    const f32 texels = static_cast<f32>(std::max(entry.source.width, entry.source.height));
+    const f32 mip = std::floor(std::log2(texels / std::max(screenPixels, 1.f)));
+    const u32 wanted = static_cast<u32>(std::clamp(mip, 0.f, static_cast<f32>(entry.tailMip)));
+
+    if (entry.lastRequestedFrame != frameNumber)
+    {
+        entry.requestedMip = wanted;
+        entry.lastRequestedFrame = frameNumber;
+    }
+    else
+    {
+        entry.requestedMip = std::min(entry.requestedMip, wanted);
+    }
+}
+
+auto TextureStreamer::setResidency(u32 index, u32 mip) -> bool
+{
+    Entry& entry = entries[index];
+    // Recorded into this frame's commands, an immediate submit would stall the frame on the copy
+    auto texture = createCompressedTextureDeferred(*backend, mipRange(entry.source, mip));
+    if (!texture)
+    {
+        return false;
+    }
+
+    // The slots in use stay as they are until the frames in flight are done, so the new residency gets fresh ones
+    if (!backend->bindlessResources->replaceTexture(entry.handles, *texture))
+    {
+        backend->destroyTextureDeferred(*texture);
+        return false;
+    }
+
+    residentBytes = residentBytes - residentSize(entry.source, entry.residentMip) + residentSize(entry.source, mip);
+    backend->destroyTextureDeferred(entry.texture);
+    entryByView.erase(entry.texture.view);
+    entryByView[texture->view] = index;
+
+    entry.texture = *texture;
+    entry.residentMip = mip;
+    return true;
+}
+
+auto TextureStreamer::makeRoom(u64 bytes, u32 keep) -> bool
+{
+    while (residentBytes + bytes > budgetBytes)
+    {
+        // Least recently requested first. Textures wanted as much as the one being streamed in are left alone
+        // unless they hold more than they asked for, otherwise two of them would keep evicting each other.
+        const u64 keepRequested = entries[keep].lastRequestedFrame;
+        i32 victim = -1;
+        for (u32 i = 0; i < entries.size(); ++i)
+        {
+            const Entry& entry = entries[i];
+            const bool overResident = entry.residentMip < entry.requestedMip;
+            if (i == keep || entry.residentMip >= entry.tailMip ||
+                (entry.lastRequestedFrame >= keepRequested && !overResident))
+            {
+                continue;
+            }
+            if (victim == -1 || entry.lastRequestedFrame < entries[victim].lastRequestedFrame)
+            {
+                victim = static_cast<i32>(i);
+            }
+        }
+        if (victim == -1)
+        {
+            return false;
+        }
+
+        // One mip at a time, the most detailed one holds three quarters of the texture anyway
+        if (!setResidency(victim, entries[victim].residentMip + 1))
+        {
+            return false;
+        }
+        evictions++;
+    }
+    return true;
+}
+
+auto TextureStreamer::update(u64 frameNumber) -> void
+{
+    ZoneScoped;
+
+    ArenaVector<u32> upgrades(ArenaAllocator<u32>(backend->currentFrame().frameArena));
+    for (u32 i = 0; i < entries.size(); ++i)
+    {
+        const Entry& entry = entries[i];
+        if (entry.requestedMip < entry.residentMip && entry.lastRequestedFrame + idleFrames >= frameNumber)
+        {
+            upgrades.push_back(i);
+        }
+    }
+    // Most recently requested first, then the ones furthest from what they asked for
+    std::sort(upgrades.begin(), upgrades.end(), [&](u32 a, u32 b)
+    {
+        const Entry& lhs = entries[a];
+        const Entry& rhs = entries[b];
+        if (lhs.lastRequestedFrame != rhs.lastRequestedFrame)
+        {
+            return lhs.lastRequestedFrame > rhs.lastRequestedFrame;
+        }
+        return lhs.residentMip - lhs.requestedMip > rhs.residentMip - rhs.requestedMip;
+    });
+
+    uploadedBytes = 0;
+    for (const u32 index : upgrades)
+    {
+        const Entry& entry = entries[index];
+        const u64 targetBytes = residentSize(entry.source, entry.requestedMip);
+        if (uploadedBytes > 0 && uploadedBytes + targetBytes > uploadBytesPerFrame)
+        {
+            break;
+        }
+
+        const u64 extraBytes = targetBytes - residentSize(entry.source, entry.residentMip);
+        if (!makeRoom(extraBytes, index))
+        {
+            continue;
+        }
+        if (setResidency(index, entry.requestedMip))
+        {
+            uploadedBytes += targetBytes;
+        }
+    }
+
+    TracyPlot("Streamed texture bytes", static_cast<i64>(residentBytes));
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "engine.h"
+#include "io/mappedFile.h"
+#include "rhi/vulkan/bindless.h"
+#include "rhi/vulkan/utils/ktx2.h"
+#include "rhi/vulkan/utils/texture.h"
+
+class VulkanBackend;
+
+// Keeps mip chains of KTX2 backed textures resident within a fixed memory budget. Textures start out with only
+// their mip tail, the levels up to tailSize, and get more detailed mips as they are requested. When the budget
+// runs out the least recently requested textures drop their most detailed mip first.
+//
+// Changing residency recreates the image with the new mip range and swaps every bindless slot showing it, the old
+// image is destroyed once the frames in flight are done with it.
+struct TextureStreamer
+{
+    struct Entry
+    {
+        std::string name;
+        // Full mip chain, levels point into the mapped file
+        MappedFile file;
+        Ktx2Image source;
+
+        Texture texture;
+        // Most detailed level of source that is resident, the tail level when nothing else is
+        u32 residentMip;
+        u32 tailMip;
+        // Most detailed level requested since the last update()
+        u32 requestedMip;
+        u64 lastRequestedFrame = 0;
+
+        std::vector<BindlessTexture> handles;
+    };
+
+    VulkanBackend* backend;
+
+    u64 budgetBytes;
+    // Mips up to this size along the longer side are always resident
+    u32 tailSize = 128;
+    // Uploads stop for the frame once this much was uploaded, keeps streaming hitches bounded
+    u64 uploadBytesPerFrame = 32 * 1024 * 1024;
+    // A texture not requested for this many frames only keeps what the budget doesn't need back
+    u64 idleFrames = 120;
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, u32> entryByName;
+    std::unordered_map<VkImageView, u32> entryByView;
+    std::unordered_map<BindlessTexture, u32> entryByHandle;
+
+    u64 residentBytes = 0;
+    u64 uploadedBytes = 0;
+    u32 evictions = 0;
+
+    TextureStreamer(VulkanBackend& backend, u64 budgetBytes) : backend(&backend), budgetBytes(budgetBytes) {}
+
+    // Uploads the mip tail only. Nullopt if the format can't be sampled, nothing is kept then.
+    auto add(std::string name, MappedFile file, Ktx2Image image) -> std::optional<Texture>;
+    [[nodiscard]]
+    auto find(const std::string& name) const -> std::optional<Texture>;
+    // Bindless slots showing texture are updated whenever its residency changes. Not streamed textures are ignored.
+    auto track(BindlessTexture handle, const Texture& texture) -> void;
+
+    // Texture in slot handle covers roughly screenPixels pixels along its longer side this frame
+    auto request(BindlessTexture handle, f32 screenPixels, u64 frameNumber) -> void;
+    // Meant to be called once per frame after the requests, right after newFrame()
+    auto update(u64 frameNumber) -> void;
+
+    // Recreates the entry's image with levels from mip down
+    auto setResidency(u32 index, u32 mip) -> bool;
+    // Evicts least recently requested mips until bytes more fit in the budget, never from keep
+    auto makeRoom(u64 bytes, u32 keep) -> bool;
+};
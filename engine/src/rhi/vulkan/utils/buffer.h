@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include "engine.h"
 #include "vk_mem_alloc.h"
 
 using Buffer = VkBuffer;
@@ -12,3 +13,10 @@ struct AllocatedBuffer
     VkBuffer buffer;
     VmaAllocation allocation;
 };
+
+// Host visible and mapped for its whole lifetime
+struct MappedBuffer
+{
+    AllocatedBuffer buffer;
+    u8* data;
+};
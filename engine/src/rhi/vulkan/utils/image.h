@@ -10,6 +10,8 @@ struct AllocatedImage
     VkExtent3D extent;
     VkFormat format;
     VkImageView view;
+    // What the image was created with, 0 when unknown
+    VkImageUsageFlags usage = 0;
 
     VmaAllocation allocation;
 };
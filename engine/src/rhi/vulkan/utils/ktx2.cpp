@@ -0,0 +1,289 @@
+#include "rhi/vulkan/utils/ktx2.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <print>
+
+static constexpr std::array<u8, 12> kIdentifier = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+struct Ktx2Header
+{
+    std::array<u8, 12> identifier;
+    u32 vkFormat;
+    u32 typeSize;
+    u32 pixelWidth;
+    u32 pixelHeight;
+    u32 pixelDepth;
+    u32 layerCount;
+    u32 faceCount;
+    u32 levelCount;
+    u32 supercompressionScheme;
+
+    u32 dfdByteOffset;
+    u32 dfdByteLength;
+    u32 kvdByteOffset;
+    u32 kvdByteLength;
+    u64 sgdByteOffset;
+    u64 sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+
+struct Ktx2Level
+{
+    u64 byteOffset;
+    u64 byteLength;
+    u64 uncompressedByteLength;
+};
+
+struct FormatBlock
+{
+    u32 width;
+    u32 height;
+    u32 bytes;
+    // Data format descriptor colour model, see the Khronos Data Format spec
+    u8 colorModel;
+};
+
+static auto formatBlock(VkFormat format) -> std::optional<FormatBlock>
+{
+    switch (format)
+    {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SRGB:
+            return FormatBlock{1, 1, 1, 1};
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R8G8_SRGB:
+            return FormatBlock{1, 1, 2, 1};
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            return FormatBlock{1, 1, 4, 1};
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            return FormatBlock{4, 4, 8, 128};
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+            return FormatBlock{4, 4, 16, 129};
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            return FormatBlock{4, 4, 16, 130};
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return FormatBlock{4, 4, 8, 131};
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+            return FormatBlock{4, 4, 16, 132};
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+            return FormatBlock{4, 4, 16, 133};
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return FormatBlock{4, 4, 16, 134};
+        default:
+            return std::nullopt;
+    }
+}
+
+static auto levelSize(const FormatBlock& block, u32 width, u32 height) -> u64
+{
+    return static_cast<u64>((width + block.width - 1) / block.width) * ((height + block.height - 1) / block.height) *
+        block.bytes;
+}
+
+auto isKtx2(std::span<const u8> data) -> bool
+{
+    return data.size() >= kIdentifier.size() && std::equal(kIdentifier.begin(), kIdentifier.end(), data.begin());
+}
+
+auto parseKtx2(std::span<const u8> data) -> std::optional<Ktx2Image>
+{
+    Ktx2Header header;
+    if (data.size() < sizeof(header))
+    {
+        std::println("KTX2: file too small");
+        return std::nullopt;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (header.identifier != kIdentifier)
+    {
+        std::println("KTX2: bad identifier");
+        return std::nullopt;
+    }
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 ||
+        header.faceCount != 1)
+    {
+        std::println("KTX2: only 2D textures are supported");
+        return std::nullopt;
+    }
+    if (header.supercompressionScheme != 0)
+    {
+        std::println("KTX2: supercompression scheme {} is not supported", header.supercompressionScheme);
+        return std::nullopt;
+    }
+
+    const VkFormat format = static_cast<VkFormat>(header.vkFormat);
+    const auto block = formatBlock(format);
+    if (!block)
+    {
+        std::println("KTX2: unsupported format {}", header.vkFormat);
+        return std::nullopt;
+    }
+
+    // 0 asks the loader to generate mips, which is exactly what this path avoids. Only the base level is used then.
+    const u32 levelCount = std::max(header.levelCount, 1u);
+    if (levelCount > std::bit_width(std::max(header.pixelWidth, header.pixelHeight)))
+    {
+        std::println("KTX2: {} levels for a {}x{} texture", levelCount, header.pixelWidth, header.pixelHeight);
+        return std::nullopt;
+    }
+    if (data.size() < sizeof(header) + levelCount * sizeof(Ktx2Level))
+    {
+        std::println("KTX2: truncated level index");
+        return std::nullopt;
+    }
+
+    Ktx2Image image = {
+        .format = format,
+        .width = header.pixelWidth,
+        .height = header.pixelHeight,
+    };
+    image.levels.reserve(levelCount);
+    for (u32 i = 0; i < levelCount; ++i)
+    {
+        Ktx2Level level;
+        std::memcpy(&level, data.data() + sizeof(header) + i * sizeof(Ktx2Level), sizeof(level));
+
+        const u64 expectedSize =
+            levelSize(*block, std::max(header.pixelWidth >> i, 1u), std::max(header.pixelHeight >> i, 1u));
+        if (level.byteLength != expectedSize || level.byteOffset > data.size() ||
+            level.byteLength > data.size() - level.byteOffset)
+        {
+            std::println("KTX2: level {} doesn't match the format or is out of bounds", i);
+            return std::nullopt;
+        }
+        image.levels.push_back(data.subspan(level.byteOffset, level.byteLength));
+    }
+    return image;
+}
+
+// Basic data format descriptor, only written for the block compressed formats the import step produces
+static auto dataFormatDescriptor(VkFormat format, const FormatBlock& block) -> std::vector<u32>
+{
+    const u32 sampleCount = format == VK_FORMAT_BC5_UNORM_BLOCK ? 2 : 1;
+    const u32 blockSize = 24 + 16 * sampleCount;
+
+    std::vector<u32> words;
+    words.push_back(4 + blockSize);
+    // Vendor Khronos, basic descriptor type, version 2
+    words.push_back(0);
+    words.push_back(2 | (blockSize << 16));
+    // Colour model, BT.709 primaries, linear transfer, straight alpha
+    words.push_back(block.colorModel | (1 << 8) | (1 << 16));
+    words.push_back((block.width - 1) | ((block.height - 1) << 8));
+    words.push_back(block.bytes);
+    words.push_back(0);
+    for (u32 sample = 0; sample < sampleCount; ++sample)
+    {
+        // Each sample covers one 64 bit half of a BC5 block, the whole block otherwise. Channel ids go red, green.
+        const u32 bitLength = block.bytes * 8 / sampleCount;
+        words.push_back((sample * bitLength) | ((bitLength - 1) << 16) | (sample << 24));
+        words.push_back(0);
+        words.push_back(0);
+        words.push_back(0xFFFFFFFF);
+    }
+    return words;
+}
+
+auto writeKtx2(const std::string& path, const Ktx2Image& image) -> bool
+{
+    const auto block = formatBlock(image.format);
+    if (!block || block->width == 1)
+    {
+        std::println("KTX2: writing format {} is not supported", static_cast<u32>(image.format));
+        return false;
+    }
+
+    const std::vector<u32> dfd = dataFormatDescriptor(image.format, *block);
+    const u32 levelCount = static_cast<u32>(image.levels.size());
+
+    Ktx2Header header = {
+        .identifier = kIdentifier,
+        .vkFormat = static_cast<u32>(image.format),
+        .typeSize = 1,
+        .pixelWidth = image.width,
+        .pixelHeight = image.height,
+        .pixelDepth = 0,
+        .layerCount = 0,
+        .faceCount = 1,
+        .levelCount = levelCount,
+        .supercompressionScheme = 0,
+    };
+    header.dfdByteOffset = sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level);
+    header.dfdByteLength = static_cast<u32>(dfd.size() * sizeof(u32));
+
+    // Smallest mip first in the file, each one aligned to the block size
+    std::vector<Ktx2Level> levels(levelCount);
+    u64 offset = header.dfdByteOffset + header.dfdByteLength;
+    for (i32 i = static_cast<i32>(levelCount) - 1; i >= 0; --i)
+    {
+        offset = (offset + block->bytes - 1) / block->bytes * block->bytes;
+        levels[i] = Ktx2Level{
+            .byteOffset = offset,
+            .byteLength = image.levels[i].size(),
+            .uncompressedByteLength = image.levels[i].size(),
+        };
+        offset += image.levels[i].size();
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(Ktx2Level));
+    file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(u32));
+
+    u64 written = header.dfdByteOffset + header.dfdByteLength;
+    const std::array<char, 16> padding = {};
+    for (i32 i = static_cast<i32>(levelCount) - 1; i >= 0; --i)
+    {
+        file.write(padding.data(), levels[i].byteOffset - written);
+        file.write(reinterpret_cast<const char*>(image.levels[i].data()), image.levels[i].size());
+        written = levels[i].byteOffset + levels[i].byteLength;
+    }
+
+    if (!file)
+    {
+        std::println("Failed writing {}", path);
+        return false;
+    }
+    return true;
+}
+
+auto ktx2Image(const CompressedImage& image) -> Ktx2Image
+{
+    Ktx2Image view = {
+        .width = image.width,
+        .height = image.height,
+    };
+    switch (image.format)
+    {
+        case BlockFormat::BC4:
+            view.format = VK_FORMAT_BC4_UNORM_BLOCK;
+            break;
+        case BlockFormat::BC5:
+            view.format = VK_FORMAT_BC5_UNORM_BLOCK;
+            break;
+        case BlockFormat::BC7:
+            view.format = VK_FORMAT_BC7_UNORM_BLOCK;
+            break;
+    }
+    for (const auto& mip : image.mips)
+    {
+        view.levels.push_back(mip);
+    }
+    return view;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "engine.h"
+
+#include "imageProcessing/blockCompression.h"
+
+#include <vulkan/vulkan.h>
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// 2D KTX2 image with its full mip chain, ready to be copied into a VkImage as it is. Levels don't own their data,
+// they point into whatever the image was parsed from.
+struct Ktx2Image
+{
+    VkFormat format;
+    u32 width;
+    u32 height;
+    // Mip 0 first
+    std::vector<std::span<const u8>> levels;
+};
+
+// Checks the file identifier only
+[[nodiscard]]
+auto isKtx2(std::span<const u8> data) -> bool;
+// Only plain 2D textures in a format the engine knows the block size of are accepted, no supercompression, arrays,
+// cubemaps or 3D textures. Fails if the level data doesn't add up with the format.
+[[nodiscard]]
+auto parseKtx2(std::span<const u8> data) -> std::optional<Ktx2Image>;
+auto writeKtx2(const std::string& path, const Ktx2Image& image) -> bool;
+
+// View of already compressed mips, valid as long as the image is
+[[nodiscard]]
+auto ktx2Image(const CompressedImage& image) -> Ktx2Image;
@@ -1,8 +1,11 @@
 #include "rhi/vulkan/utils/texture.h"
 
 #include "inits.h"
+#include "io/mappedFile.h"
 #include "rhi/vulkan/backend.h"
 
+#include <algorithm>
+#include <cstring>
 #include <math.h>
 #include <print>
 #include <string>
@@ -113,6 +116,119 @@ auto createTexture(VulkanBackend& backend, void* data, u32 size, u32 width, u32
     return texture;
 }
 
+// Copies the mips into a staging buffer and creates the image they go into, the copy itself is left to the caller
+static auto stageCompressedTexture(VulkanBackend& backend, const Ktx2Image& image) -> std::optional<TextureUpload>
+{
+    const VkFormat imageFormat = image.format;
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(backend.gpu, imageFormat, &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    {
+        std::println("Format {} can't be sampled on this device", static_cast<u32>(imageFormat));
+        return std::nullopt;
+    }
+
+    size_t totalSize = 0;
+    for (const auto& level : image.levels)
+    {
+        totalSize += level.size();
+    }
+
+    TextureUpload upload;
+
+    // All mips in one staging buffer, block sizes keep every offset aligned to the texel block
+    auto info = vkutil::init::bufferCreateInfo(totalSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    upload.staging = backend.allocateBuffer(info, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VmaAllocationInfo stagingInfo;
+    vmaGetAllocationInfo(backend.allocator, upload.staging.allocation, &stagingInfo);
+
+    upload.copyRegions.reserve(image.levels.size());
+    VkDeviceSize offset = 0;
+    for (u32 mip = 0; mip < image.levels.size(); ++mip)
+    {
+        memcpy(static_cast<u8*>(stagingInfo.pMappedData) + offset, image.levels[mip].data(), image.levels[mip].size());
+
+        VkBufferImageCopy copyRegion = {};
+        copyRegion.bufferOffset = offset;
+        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyRegion.imageSubresource.mipLevel = mip;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = 1;
+        copyRegion.imageExtent = {std::max(image.width >> mip, 1u), std::max(image.height >> mip, 1u), 1};
+        upload.copyRegions.push_back(copyRegion);
+
+        offset += image.levels[mip].size();
+    }
+
+    Texture& texture = upload.texture;
+    texture.mipCount = static_cast<u32>(image.levels.size());
+    texture.image.extent = {image.width, image.height, 1};
+    texture.image.format = imageFormat;
+
+    VkImageCreateInfo imgCreateInfo = vkutil::init::imageCreateInfo(imageFormat,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, texture.image.extent, texture.mipCount);
+
+    VmaAllocationCreateInfo imgAllocInfo = {};
+    imgAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    vmaCreateImage(
+        backend.allocator, &imgCreateInfo, &imgAllocInfo, &texture.image.image, &texture.image.allocation, nullptr);
+
+    VkImageViewCreateInfo imageViewInfo = vkutil::init::imageViewCreateInfo(
+        imageFormat, texture.image.image, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipCount);
+    vkCreateImageView(backend.device, &imageViewInfo, nullptr, &texture.view);
+
+    return upload;
+}
+
+auto recordTextureUpload(VkCommandBuffer cmd, const TextureUpload& upload) -> void
+{
+    const Texture& texture = upload.texture;
+
+    VkImageMemoryBarrier transferBarrier = vkutil::init::imageMemoryBarrier(VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.image.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, texture.mipCount);
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+        nullptr, 1, &transferBarrier);
+
+    vkCmdCopyBufferToImage(cmd, upload.staging.buffer, texture.image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        upload.copyRegions.size(), upload.copyRegions.data());
+
+    VkImageMemoryBarrier readBarrier = vkutil::init::imageMemoryBarrier(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.image.image, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT, texture.mipCount);
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+        nullptr, 1, &readBarrier);
+}
+
+auto createCompressedTexture(VulkanBackend& backend, const Ktx2Image& image) -> std::optional<Texture>
+{
+    auto upload = stageCompressedTexture(backend, image);
+    if (!upload)
+    {
+        return std::nullopt;
+    }
+
+    backend.immediateSubmit([&](VkCommandBuffer cmd) { recordTextureUpload(cmd, *upload); });
+    vmaDestroyBuffer(backend.allocator, upload->staging.buffer, upload->staging.allocation);
+
+    return upload->texture;
+}
+
+auto createCompressedTextureDeferred(VulkanBackend& backend, const Ktx2Image& image) -> std::optional<Texture>
+{
+    auto upload = stageCompressedTexture(backend, image);
+    if (!upload)
+    {
+        return std::nullopt;
+    }
+
+    const Texture texture = upload->texture;
+    backend.pendingTextureUploads.push_back(std::move(*upload));
+    return texture;
+}
+
 auto whiteTexture(VulkanBackend& backend, u32 dimension) -> Texture
 {
     const u32 textureSize = dimension * dimension * 4;
@@ -196,6 +312,54 @@ auto Textures::loadRaw(void* data, u32 size, u32 width, u32 height, bool generat
     return std::make_tuple(texture, name);
 }
 
+auto Textures::loadCompressed(const Ktx2Image& image, std::string name)
+    -> std::optional<std::tuple<Texture, std::string>>
+{
+    if (const auto tex = textureCache.find(name); tex != textureCache.end())
+    {
+        return std::make_tuple(tex->second, name);
+    }
+
+    auto texture = createCompressedTexture(*backend, image);
+    if (!texture)
+    {
+        return std::nullopt;
+    }
+    textureCache[name] = *texture;
+
+    return std::make_tuple(*texture, name);
+}
+
+auto Textures::loadKtx2(const std::string& path) -> std::optional<std::tuple<Texture, std::string>>
+{
+    if (const auto tex = textureCache.find(path); tex != textureCache.end())
+    {
+        return std::make_tuple(tex->second, path);
+    }
+
+    const auto file = mapFile(path);
+    if (!file)
+    {
+        return std::nullopt;
+    }
+    const auto image = parseKtx2(file->bytes());
+    if (!image)
+    {
+        std::println("Failed loading {}", path);
+        return std::nullopt;
+    }
+    return loadCompressed(*image, path);
+}
+
+auto Textures::find(const std::string& name) const -> std::optional<Texture>
+{
+    if (const auto tex = textureCache.find(name); tex != textureCache.end())
+    {
+        return tex->second;
+    }
+    return std::nullopt;
+}
+
 auto Textures::unload(std::string name) -> void
 {
     if (!textureCache.contains(name))
@@ -2,11 +2,14 @@
 
 #include "engine.h"
 
+#include "rhi/vulkan/utils/buffer.h"
 #include "rhi/vulkan/utils/image.h"
+#include "rhi/vulkan/utils/ktx2.h"
 
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class VulkanBackend;
 
@@ -23,6 +26,22 @@ Texture whiteTexture(VulkanBackend& backend, u32 dimension);
 Texture blackTexture(VulkanBackend& backend, u32 dimension);
 Texture errorTexture(VulkanBackend& backend, u32 dimension);
 
+// Mips copied into a staging buffer, waiting to be copied into the texture's image
+struct TextureUpload
+{
+    AllocatedBuffer staging;
+    Texture texture;
+    std::vector<VkBufferImageCopy> copyRegions;
+};
+
+// Uploads precomputed mips as they are with a single copy, no blits. Nullopt if the device can't sample the format.
+auto createCompressedTexture(VulkanBackend& backend, const Ktx2Image& image) -> std::optional<Texture>;
+// Same, but the copy is recorded at the start of the next frame instead of stalling on an immediate submit. The
+// texture may be handed to bindless right away, nothing samples it before that frame.
+auto createCompressedTextureDeferred(VulkanBackend& backend, const Ktx2Image& image) -> std::optional<Texture>;
+// Transitions the image, copies the mips and leaves it ready for sampling
+auto recordTextureUpload(VkCommandBuffer cmd, const TextureUpload& upload) -> void;
+
 struct Textures
 {
     VulkanBackend* backend;
@@ -33,6 +52,13 @@ struct Textures
     // TODO: more ergonomic mip options
     auto loadRaw(void* data, u32 size, u32 width, u32 height, bool generateMips, bool cache = false,
         std::string name = "") -> std::optional<std::tuple<Texture, std::string>>;
+    // Always cached, the name is required
+    auto loadCompressed(const Ktx2Image& image, std::string name) -> std::optional<std::tuple<Texture, std::string>>;
+    // Maps the file and uploads its mips directly, cached by path
+    auto loadKtx2(const std::string& path) -> std::optional<std::tuple<Texture, std::string>>;
+    // Cached texture by name, see loadRaw()
+    [[nodiscard]]
+    auto find(const std::string& name) const -> std::optional<Texture>;
     auto unload(std::string name) -> void;
     auto unloadRaw(Texture texture) -> void;
 };
\ No newline at end of file
@@ -2,18 +2,30 @@
 
 #include <algorithm>
 #include <atomic>
+#include <deque>
+#include <filesystem>
+#include <future>
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/gtx/transform.hpp>
 #include <print>
 #include <random>
+#include <unordered_set>
 
 #include "GLFW/glfw3.h"
 #include "debugUI.h"
 #include "glm/gtc/type_ptr.hpp"
+#include "imageProcessing/blockCompression.h"
 #include "imageProcessing/displacement.h"
+#include "io/gltfLoader.h"
+#include "io/mappedFile.h"
+#include "io/textureCache.h"
+#include "jobs/threadPool.h"
+#include "memory/arenaAllocator.h"
 #include "rhi/vulkan/backend.h"
 #include "rhi/vulkan/utils/inits.h"
+#include "rhi/vulkan/utils/ktx2.h"
 #include "sceneGraph.h"
 #include "stb_image.h"
 #include "stb_image_write.h"
@@ -109,7 +121,17 @@ void updateFreeCamera(f32 dt, GLFWwindow* window, Camera& camera)
     camera.position += dir * camera.moveSpeed * dt;
 }
 
-void updateLights(f32 dt, std::vector<PointLight>& pointLights)
+auto packPointLight(glm::vec3 pos, f32 range, glm::vec3 color, f32 strength) -> PointLight
+{
+    return PointLight{
+        .pos = pos,
+        .range = range,
+        .colorRG = glm::packHalf2x16(glm::vec2(color.r, color.g)),
+        .colorBAndStrength = glm::packHalf2x16(glm::vec2(color.b, strength)),
+    };
+}
+
+void updateLights(f32 dt, std::vector<PointLight>& pointLights, LightBvh& lightBvh)
 {
     static f32 time = 0.f;
     //static glm::vec3 initial = pointLights[0].pos;
@@ -130,6 +152,7 @@ void updateLights(f32 dt, std::vector<PointLight>& pointLights)
 
         ImGui::SliderFloat("Range multiplier", &rangeMultiplier, 0.f, 50.f);
         ImGui::SliderFloat("Strength multiplier", &strengthMultiplier, 0.f, 50.f);
+        ImGui::Text("Light BVH: %u leaves, rebuilt %u times", lightBvh.leafCount, lightBvh.rebuilds);
 
         ImGui::Separator();
     }
@@ -142,24 +165,26 @@ void updateLights(f32 dt, std::vector<PointLight>& pointLights)
     };
     f32 focalDist = glm::distance(ellipseFocals[0], ellipseFocals[1]);
 
+    // Lights are animated from their starting state, kept apart from the packed lights
     static std::vector<glm::vec3> startPositions;
-    static std::vector<glm::vec4> startRangesAndStrengths;
-    bool startingValuesRecorded = false;
+    static std::vector<f32> startRanges;
+    static std::vector<f32> startStrengths;
     if (startPositions.empty())
     {
         startPositions.reserve(pointLights.size());
-        startRangesAndStrengths.reserve(pointLights.size());
-        startingValuesRecorded = true;
+        startRanges.reserve(pointLights.size());
+        startStrengths.reserve(pointLights.size());
+        for (const PointLight& light : pointLights)
+        {
+            startPositions.push_back(light.pos);
+            startRanges.push_back(light.range);
+            startStrengths.push_back(glm::unpackHalf1x16(static_cast<u16>(light.colorBAndStrength >> 16)));
+        }
     }
 
     for (int i = 0; i < pointLights.size(); i++)
     {
         auto& light = pointLights[i];
-        if (startingValuesRecorded)
-        {
-            startPositions.push_back(light.pos);
-            startRangesAndStrengths.push_back(light.rangeAndStrength);
-        }
 
         // //dists[0] = glm::distance(ellipseFocals[0], glm::vec2(pointLights[0].pos.x, pointLights[0].pos.z));
         // f32 dists[] = {
@@ -200,78 +225,74 @@ void updateLights(f32 dt, std::vector<PointLight>& pointLights)
         //light.pos.x = sin(angle + dt * 0.2) * dist;
         //light.pos.z = cos(angle + dt * 0.2) * dist;
 
-        light.rangeAndStrength = glm::vec4(
-            startRangesAndStrengths[i].x * rangeMultiplier,
-            startRangesAndStrengths[i].y * strengthMultiplier,
-            0.f,
-            0.f
-        );
+        light.range = startRanges[i] * rangeMultiplier;
+        // Color stays as is
+        light.colorBAndStrength = (light.colorBAndStrength & 0xffffu) |
+            (static_cast<u32>(glm::packHalf1x16(startStrengths[i] * strengthMultiplier)) << 16);
     }
+
+    updateLightBvh(lightBvh, pointLights);
 }
 
-struct ModelData
+// CPU estimate of how large every instance is on screen, each texture is asked for at the largest size it is shown
+// at. Assumes the UVs span the texture about once across the instance, which holds well enough for architecture.
+static auto requestTextureMips(VulkanBackend& backend, const std::unordered_map<std::string, Mesh>& meshes,
+    const Camera& camera) -> void
 {
-    glm::vec4 textures;
-    glm::vec4 selected;
-    glm::vec4 metallicRoughnessFactors;
-    glm::mat4 model;
-};
+    ZoneScoped;
 
-auto gatherModelData(Scene& scene) -> std::vector<ModelData>
-{
-    std::vector<ModelData> modelData;
-    modelData.reserve(scene.meshCount);
-    for (auto& mesh : scene.meshes)
+    const f32 pixelsPerUnit = backend.viewport.height / (2.f * std::tan(camera.verticalFov / 2.f));
+    const u64 frameNumber = backend.currentFrameNumber;
+    for (const auto& [name, mesh] : meshes)
     {
-        for (auto& instance : mesh.second.instances)
+        for (const auto& instance : mesh.instances)
         {
-            modelData.push_back({
-                .textures = glm::vec4(
-                    mesh.second.albedoTexture,
-                    mesh.second.normalTexture,
-                    mesh.second.bumpTexture,
-                    mesh.second.metallicRoughnessTexture
-                ),
-                .selected = glm::vec4(instance.selected ? 1.f : 0.f),
-                .metallicRoughnessFactors = instance.metallicRoughnessFactors,
-                .model = instance.modelTransform,
-            });
+            const glm::vec3 center = (instance.aabbMin + instance.aabbMax) * 0.5f;
+            const f32 radius = glm::length(instance.aabbMax - instance.aabbMin) * 0.5f;
+            const f32 distance = std::max(glm::length(center - camera.position) - radius,
+                camera.nearClippingPlaneDist);
+            const f32 screenPixels = 2.f * radius * pixelsPerUnit / distance;
+
+            for (const i16 handle : {mesh.albedoTexture, mesh.metallicRoughnessTexture, mesh.normalTexture,
+                     mesh.bumpTexture})
+            {
+                backend.textureStreamer->request(handle, screenPixels, frameNumber);
+            }
         }
     }
-
-    return modelData;
 }
 
-
 void Scene::update(f32 dt, f32 currentTimeMs, GLFWwindow* window)
 {
     updateSceneGraphTransforms(sceneGraph);
-    // TODO: move to a render pass
+
+    // Headless runs drive the camera themselves
+    if (window)
     {
-        auto modelData = gatherModelData(*this);
-        backend.copyBufferWithStaging(modelData.data(), modelData.size() * sizeof(ModelData), perModelBuffer.buffer);
-    }
+        static bool released = true;
 
-    static bool released = true;
+        if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && released)
+        {
+            released = false;
+            activeCamera = (activeCamera == &mainCamera) ? &debugCamera : &mainCamera;
 
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && released)
-    {
-        released = false;
-        activeCamera = (activeCamera == &mainCamera) ? &debugCamera : &mainCamera;
+            bool isMain = (bool)(activeCamera == &mainCamera);
+            bool isDebug = (bool)(activeCamera == &debugCamera);
+            std::println("active: {:x}, main: {:x}({}), debug: {:x}({})", (u64)activeCamera, (u64)&mainCamera,
+                isMain, (u64)&debugCamera, isDebug);
+        }
 
-        bool isMain = (bool)(activeCamera == &mainCamera);
-        bool isDebug = (bool)(activeCamera == &debugCamera);
-        std::println("active: {:x}, main: {:x}({}), debug: {:x}({})", (u64)activeCamera, (u64)&mainCamera,
-            isMain, (u64)&debugCamera, isDebug);
-    }
+        if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+        {
+            released = true;
+        }
 
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
-    {
-        released = true;
+        updateFreeCamera(dt, window, *activeCamera);
     }
+    updateLights(dt, pointLights, lightBvh);
 
-    updateFreeCamera(dt, window, *activeCamera);
-    updateLights(dt, pointLights);
+    requestTextureMips(backend, meshes, *activeCamera);
+    backend.textureStreamer->update(backend.currentFrameNumber);
 
     //glm::mat4 invProj = glm::inverse(activeCamera->proj());
     //glm::vec4 a = invProj * glm::vec4(0.f, 0.f, -1.f, 1.f);
@@ -294,38 +315,399 @@ void Scene::update(f32 dt, f32 currentTimeMs, GLFWwindow* window)
 
 void Scene::load(const char* path)
 {
-    tinygltf::Model model;
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
+    auto asset = loadGltf(path);
+    if (!asset)
+    {
+        return;
+    }
+    std::println("Successfully loaded {}", path);
+
+    addModel(*asset);
+    createBuffers();
+}
+
+// TEMP: avoid decals in intel sponza for now
+static auto skipMesh(const tinygltf::Mesh& mesh) -> bool
+{
+    return mesh.name.contains("decal");
+}
+
+// Ready to upload mips, `image` points into either the cache entry, the freshly compressed mips or the source
+// bytes when those already are KTX2
+struct ImportedImage
+{
+    MappedFile file;
+    CompressedImage compressed;
+    Ktx2Image image;
+};
+
+// Served from the mapped cache entry like a hit, so the texture can be streamed and the copy dropped
+static auto cacheCompressed(CompressedImage&& compressed, u64 key) -> ImportedImage
+{
+    if (storeCachedTexture(key, compressed))
+    {
+        if (auto cached = loadCachedTexture(key))
+        {
+            return ImportedImage{.file = std::move(cached->file), .image = std::move(cached->image)};
+        }
+    }
+
+    ImportedImage imported;
+    imported.compressed = std::move(compressed);
+    imported.image = ktx2Image(imported.compressed);
+    return imported;
+}
 
-    if (!loader.LoadASCIIFromFile(&model, &err, &warn, path))
+// KTX2 sources and cache hits skip decoding altogether. Misses are decoded, block compressed and written back for
+// the next run. key is textureCacheKey() of encoded.
+static auto importImage(std::span<const u8> encoded, TextureKind kind, u64 key) -> std::optional<ImportedImage>
+{
+    if (isKtx2(encoded))
     {
-        std::println("{}", err);
-        std::println("{}", warn);
+        auto image = parseKtx2(encoded);
+        return image ? std::optional(ImportedImage{.image = std::move(*image)}) : std::nullopt;
     }
-    else
+
+    if (auto cached = loadCachedTexture(key))
     {
-        std::println("Successfully loaded {}", path);
+        return ImportedImage{.file = std::move(cached->file), .image = std::move(cached->image)};
     }
 
-    addModel(model);
-    createBuffers();
+    i32 width;
+    i32 height;
+    i32 components;
+    u8* pixels = stbi_load_from_memory(encoded.data(), static_cast<i32>(encoded.size()), &width, &height, &components,
+        STBI_rgb_alpha);
+    if (pixels == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    CompressedImage compressed = compressTexture(
+        std::span<const u8>(pixels, static_cast<size_t>(width) * height * 4), width, height, kind);
+    stbi_image_free(pixels);
+    return cacheCompressed(std::move(compressed), key);
 }
 
-void Scene::addModel(tinygltf::Model& model, glm::mat4 transform)
+// Height map integrated from an encoded normal map, cached like the imports are. KTX2 normal maps are block
+// compressed already, those aren't integrated. key is bumpMapCacheKey() of the normal map.
+static auto importGeneratedBumpMap(std::span<const u8> encodedNormalMap, u64 key) -> std::optional<ImportedImage>
 {
+    if (auto cached = loadCachedTexture(key))
+    {
+        return ImportedImage{.file = std::move(cached->file), .image = std::move(cached->image)};
+    }
+    if (isKtx2(encodedNormalMap))
+    {
+        return std::nullopt;
+    }
+
+    i32 width;
+    i32 height;
+    i32 components;
+    u8* pixels = stbi_load_from_memory(encodedNormalMap.data(), static_cast<i32>(encodedNormalMap.size()), &width,
+        &height, &components, STBI_rgb_alpha);
+    if (pixels == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    // Already running on a worker, other images keep the rest of the pool busy
+    const std::vector<u8> bumpMap = tangentNormalMapToBumpMap(pixels, width, height);
+    stbi_image_free(pixels);
+    return cacheCompressed(compressTexture(bumpMap, width, height, TextureKind::Height), key);
+}
+
+// Bump maps generated offline by tangentNormalMapToBumpMap(), nullopt if there is none. The file has to stay
+// mapped until the import is uploaded.
+static auto importBumpMap(const std::string& path) -> std::optional<ImportedImage>
+{
+    if (!std::filesystem::exists(path))
+    {
+        return std::nullopt;
+    }
+    auto file = mapFile(path);
+    if (!file)
+    {
+        return std::nullopt;
+    }
+    const u64 key = textureCacheKey(file->bytes(), TextureKind::Height);
+    auto imported = importImage(file->bytes(), TextureKind::Height, key);
+    if (imported && isKtx2(file->bytes()))
+    {
+        // Levels point straight into the source file
+        imported->file = std::move(*file);
+    }
+    return imported;
+}
+
+// Texture's image, KHR_texture_basisu puts KTX2 images in an extension instead of source. -1 if there is none.
+static auto textureSource(const tinygltf::Model& model, i32 textureIndex) -> i32
+{
+    const tinygltf::Texture& texture = model.textures[textureIndex];
+    if (texture.source != -1)
+    {
+        return texture.source;
+    }
+    if (const auto basisu = texture.extensions.find("KHR_texture_basisu"); basisu != texture.extensions.end())
+    {
+        const tinygltf::Value& source = basisu->second.Get("source");
+        return source.IsInt() ? source.GetNumberAsInt() : -1;
+    }
+    return -1;
+}
+
+// Mapped imports are streamed, the rest is uploaded whole
+static auto uploadImported(VulkanBackend& backend, ImportedImage&& imported, const std::string& name)
+    -> std::optional<Texture>
+{
+    if (imported.file.data != nullptr)
+    {
+        return backend.textureStreamer->add(name, std::move(imported.file), std::move(imported.image));
+    }
+    auto loaded = backend.textures->loadCompressed(imported.image, name);
+    return loaded ? std::optional(std::get<0>(*loaded)) : std::nullopt;
+}
+
+struct ImageImport
+{
+    i32 imageIndex;
+    TextureKind kind;
+    u64 key;
+    // Integrates the normal map in imageIndex into a height map instead of importing it
+    bool bumpMapFromNormalMap = false;
+};
+
+// Textures are registered under their content, whatever image or uri they came from
+static auto textureName(u64 key) -> std::string
+{
+    return std::format("texture_{:016x}", key);
+}
+
+// Imports images on the worker pool while uploading the finished ones in order. Only a couple of imported images per
+// worker are alive at any time, each one is freed as soon as it is on the GPU. Results are indexed like imports.
+static auto uploadImages(VulkanBackend& backend, const GltfAsset& asset, const std::vector<ImageImport>& imports)
+    -> std::vector<std::optional<Texture>>
+{
+    ZoneScoped;
+
+    ThreadPool& pool = workerPool();
+    const size_t maxInFlight = pool.threadCount() * 2;
+
+    std::vector<std::optional<Texture>> textures(imports.size());
+    std::deque<std::pair<size_t, std::future<std::optional<ImportedImage>>>> inFlight;
+    auto uploadOldest = [&]()
+    {
+        auto [importIndex, importing] = std::move(inFlight.front());
+        inFlight.pop_front();
+
+        std::optional<ImportedImage> imported = importing.get();
+        const ImageImport& image = imports[importIndex];
+        if (!imported)
+        {
+            std::println("Failed importing image {} {}", image.imageIndex, asset.model.images[image.imageIndex].uri);
+            return;
+        }
+        textures[importIndex] = uploadImported(backend, std::move(*imported), textureName(image.key));
+    };
+
+    for (size_t i = 0; i < imports.size(); ++i)
+    {
+        if (inFlight.size() >= maxInFlight)
+        {
+            uploadOldest();
+        }
+
+        const std::span<const u8> encoded = asset.images[imports[i].imageIndex];
+        const TextureKind kind = imports[i].kind;
+        const u64 key = imports[i].key;
+        if (imports[i].bumpMapFromNormalMap)
+        {
+            inFlight.emplace_back(i, pool.submit([encoded, key]() { return importGeneratedBumpMap(encoded, key); }));
+        }
+        else
+        {
+            inFlight.emplace_back(i, pool.submit([encoded, kind, key]() { return importImage(encoded, kind, key); }));
+        }
+    }
+    while (!inFlight.empty())
+    {
+        uploadOldest();
+    }
+    return textures;
+}
+
+// Generated offline from the normal map by tangentNormalMapToBumpMap(), nullopt if there is none
+static auto loadBumpMap(VulkanBackend& backend, const std::string& normalMapUri) -> std::optional<Texture>
+{
+    const std::string bumpFilename = "generatedBump_" + normalMapUri + ".png";
+    // TODO: allow specifying format
+    if (auto texture = backend.textureStreamer->find(bumpFilename))
+    {
+        return texture;
+    }
+    if (auto texture = backend.textures->find(bumpFilename))
+    {
+        return texture;
+    }
+    if (auto bumpMap = importBumpMap(bumpFilename))
+    {
+        return uploadImported(backend, std::move(*bumpMap), bumpFilename);
+    }
+    return std::nullopt;
+}
+
+// Streamed textures swap their slot's contents as mips come and go
+static auto addBindlessTexture(VulkanBackend& backend, const Texture& texture) -> BindlessTexture
+{
+    const BindlessTexture handle = backend.bindlessResources->addTexture(texture);
+    backend.textureStreamer->track(handle, texture);
+    return handle;
+}
+
+// Slot of the image behind a glTF texture, see ModelTextures
+static auto modelTexture(const tinygltf::Model& model, const std::vector<std::optional<BindlessTexture>>& slots,
+    i32 textureIndex) -> std::optional<BindlessTexture>
+{
+    const i32 imageIndex = textureIndex == -1 ? -1 : textureSource(model, textureIndex);
+    return imageIndex == -1 ? std::nullopt : slots[imageIndex];
+}
+
+void Scene::addModel(GltfAsset& asset, glm::mat4 transform)
+{
+    tinygltf::Model& model = asset.model;
+
+    // Everything the meshes below sample, each image once. The first use decides how it is compressed.
+    std::vector<std::pair<i32, TextureKind>> images;
+    std::vector<bool> imageReferenced(model.images.size(), false);
+    std::vector<bool> usedAsNormalMap(model.images.size(), false);
+    for (const auto& mesh : model.meshes)
+    {
+        if (skipMesh(mesh))
+        {
+            continue;
+        }
+        for (const auto& primitive : mesh.primitives)
+        {
+            if (primitive.material == -1)
+            {
+                continue;
+            }
+            const auto& material = model.materials[primitive.material];
+            const std::pair<i32, TextureKind> textures[] = {
+                {material.pbrMetallicRoughness.baseColorTexture.index, TextureKind::Color},
+                {material.pbrMetallicRoughness.metallicRoughnessTexture.index, TextureKind::Color},
+                {material.normalTexture.index, TextureKind::Normal},
+            };
+            for (const auto [textureIndex, kind] : textures)
+            {
+                const i32 imageIndex = textureIndex == -1 ? -1 : textureSource(model, textureIndex);
+                if (imageIndex == -1)
+                {
+                    continue;
+                }
+                if (!imageReferenced[imageIndex])
+                {
+                    imageReferenced[imageIndex] = true;
+                    images.emplace_back(imageIndex, kind);
+                }
+                usedAsNormalMap[imageIndex] = usedAsNormalMap[imageIndex] || kind == TextureKind::Normal;
+            }
+        }
+    }
+
+    // Identical images embedded or referenced under different uris hash the same, only the first one is imported
+    ThreadPool& pool = workerPool();
+    std::vector<std::future<std::pair<u64, u64>>> hashing;
+    hashing.reserve(images.size());
+    for (const auto [imageIndex, kind] : images)
+    {
+        const std::span<const u8> encoded = asset.images[imageIndex];
+        const bool normalMap = usedAsNormalMap[imageIndex];
+        hashing.push_back(pool.submit([encoded, kind, normalMap]()
+        {
+            return std::pair(textureCacheKey(encoded, kind), normalMap ? bumpMapCacheKey(encoded) : 0);
+        }));
+    }
+
+    // Bump maps made offline are used as they are, the rest is generated from the normal map alongside the imports
+    std::vector<u64> imageKeys(model.images.size(), 0);
+    std::vector<u64> bumpMapKeys(model.images.size(), 0);
+    std::vector<ImageImport> imports;
+    std::unordered_set<u64> importedKeys;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        const auto [imageIndex, kind] = images[i];
+        const auto [key, bumpMapKey] = hashing[i].get();
+        imageKeys[imageIndex] = key;
+        bumpMapKeys[imageIndex] = bumpMapKey;
+        if (!textureSlots.contains(key) && importedKeys.insert(key).second)
+        {
+            imports.push_back(ImageImport{.imageIndex = imageIndex, .kind = kind, .key = key});
+        }
+
+        if (!usedAsNormalMap[imageIndex] || bumpMapSlots.contains(bumpMapKey))
+        {
+            continue;
+        }
+        if (auto bumpMap = loadBumpMap(backend, model.images[imageIndex].uri))
+        {
+            bindlessImages.push_back(addBindlessTexture(backend, *bumpMap));
+            bumpMapSlots[bumpMapKey] = bindlessImages.back();
+        }
+        else if (importedKeys.insert(bumpMapKey).second)
+        {
+            imports.push_back(ImageImport{
+                .imageIndex = imageIndex,
+                .kind = TextureKind::Height,
+                .key = bumpMapKey,
+                .bumpMapFromNormalMap = true,
+            });
+        }
+    }
+
+    const std::vector<std::optional<Texture>> uploaded = uploadImages(backend, asset, imports);
+    for (size_t i = 0; i < imports.size(); ++i)
+    {
+        if (uploaded[i])
+        {
+            bindlessImages.push_back(addBindlessTexture(backend, *uploaded[i]));
+            auto& slots = imports[i].bumpMapFromNormalMap ? bumpMapSlots : textureSlots;
+            slots[imports[i].key] = bindlessImages.back();
+        }
+    }
+
+    ModelTextures textures = {
+        .images = std::vector<std::optional<BindlessTexture>>(model.images.size()),
+        .bumpMaps = std::vector<std::optional<BindlessTexture>>(model.images.size()),
+    };
+    for (const auto [imageIndex, kind] : images)
+    {
+        if (const auto slot = textureSlots.find(imageKeys[imageIndex]); slot != textureSlots.end())
+        {
+            textures.images[imageIndex] = slot->second;
+        }
+        if (usedAsNormalMap[imageIndex])
+        {
+            const auto slot = bumpMapSlots.find(bumpMapKeys[imageIndex]);
+            textures.bumpMaps[imageIndex] = slot != bumpMapSlots.end() ? slot->second : BindlessResources::kWhite;
+        }
+    }
+
     auto* sceneGraphNode = new SceneGraph::Node("model", glm::mat4(1.f), glm::mat4(1.f), 0, sceneGraph.root);
     sceneGraph.root->children.push_back(sceneGraphNode);
 
     for (auto& node : model.nodes)
     {
-        addNodes(model, node, transform, *sceneGraphNode);
+        addNodes(asset, textures, node, transform, *sceneGraphNode);
     }
 }
 
-void Scene::addNodes(tinygltf::Model& model, tinygltf::Node& node, glm::mat4 transform, SceneGraph::Node& parent)
+void Scene::addNodes(GltfAsset& asset, const ModelTextures& textures, tinygltf::Node& node, glm::mat4 transform,
+    SceneGraph::Node& parent)
 {
+    tinygltf::Model& model = asset.model;
+
     glm::mat4 localTransform = glm::mat4(1.0f);
     if (node.matrix.empty())
     {
@@ -350,18 +732,21 @@ void Scene::addNodes(tinygltf::Model& model, tinygltf::Node& node, glm::mat4 tra
 
     if (node.mesh != -1)
     {
-        addMesh(model, model.meshes[node.mesh], transform, *sceneGraphNode);
+        addMesh(asset, textures, model.meshes[node.mesh], transform, *sceneGraphNode);
         //sceneGraphNode->name = model.meshes[node.mesh].name;
     }
 
     for (auto& child : node.children)
     {
-        addNodes(model, model.nodes[child], transform, *sceneGraphNode);
+        addNodes(asset, textures, model.nodes[child], transform, *sceneGraphNode);
     }
 }
 
-void Scene::addMesh(tinygltf::Model& model, tinygltf::Mesh& mesh, glm::mat4 transform, SceneGraph::Node& parent)
+void Scene::addMesh(GltfAsset& asset, const ModelTextures& textures, tinygltf::Mesh& mesh, glm::mat4 transform,
+    SceneGraph::Node& parent)
 {
+    tinygltf::Model& model = asset.model;
+
     // Matches Vertex definition
     const char* position = "POSITION";
     const std::pair<const char*, i32> attributes[] = {
@@ -371,8 +756,7 @@ void Scene::addMesh(tinygltf::Model& model, tinygltf::Mesh& mesh, glm::mat4 tran
         {"TANGENT", 4},
     };
 
-    // TEMP: avoid decals in intel sponza for now
-    if (mesh.name.contains("decal"))
+    if (skipMesh(mesh))
     {
         return;
     }
@@ -441,36 +825,15 @@ void Scene::addMesh(tinygltf::Model& model, tinygltf::Mesh& mesh, glm::mat4 tran
                 continue;
             }
 
-            tinygltf::Accessor accessor = model.accessors[primitive.attributes[std::string(attribute)]];
-            tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-            tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-            f32* data = reinterpret_cast<f32*>(&buffer.data[bufferView.byteOffset + accessor.byteOffset]);
+            const tinygltf::Accessor& accessor = model.accessors[primitive.attributes[std::string(attribute)]];
+            const f32* data = reinterpret_cast<const f32*>(accessorData(asset, accessor));
 
-            for (i32 i = 0; i < accessor.count; i++)
+            const i32 componentCount = tinygltf::GetNumComponentsInType(accessor.type);
+            copyVertexAttribute(vertexData, m.vertexOffset, vertexAttributeOffset, data, accessor.count,
+                componentCount);
+            if (attribute == position)
             {
-                i32 vertexIndex = m.vertexOffset + i;
-                if (vertexData.size() <= vertexIndex)
-                {
-                    vertexData.emplace_back();
-                }
-                Vertex& vertex = vertexData[vertexIndex];
-
-                const i32 componentCount = tinygltf::GetNumComponentsInType(accessor.type);
-                for (i32 j = 0; j < componentCount; j++)
-                {
-                    vertex.raw[vertexAttributeOffset + j] = data[i * componentCount + j];
-                }
-
-                if (attribute == position)
-                {
-                    m.aabbMin.x = std::min(m.aabbMin.x, vertex.pos[0]);
-                    m.aabbMin.y = std::min(m.aabbMin.y, vertex.pos[1]);
-                    m.aabbMin.z = std::min(m.aabbMin.z, vertex.pos[2]);
-
-                    m.aabbMax.x = std::max(m.aabbMax.x, vertex.pos[0]);
-                    m.aabbMax.y = std::max(m.aabbMax.y, vertex.pos[1]);
-                    m.aabbMax.z = std::max(m.aabbMax.z, vertex.pos[2]);
-                }
+                expandVertexBounds(vertexData, m.vertexOffset, accessor.count, m.aabbMin, m.aabbMax);
             }
             // std::println("{} {} {}", vertexData.back().pos[0], vertexData.back().pos[1],
             // vertexData.back().pos[2]);
@@ -504,104 +867,35 @@ void Scene::addMesh(tinygltf::Model& model, tinygltf::Mesh& mesh, glm::mat4 tran
         aabbMax.y = std::max(aabbMax.y, instance.aabbMax.y);
         aabbMax.z = std::max(aabbMax.z, instance.aabbMax.z);
 
-        tinygltf::Accessor indexAccessor = model.accessors[primitive.indices];
-        tinygltf::BufferView& indexBufferView = model.bufferViews[indexAccessor.bufferView];
-        tinygltf::Buffer& indexBuffer = model.buffers[indexBufferView.buffer];
-        const unsigned short* indexData = reinterpret_cast<unsigned short*>(
-            &indexBuffer.data[indexBufferView.byteOffset + indexAccessor.byteOffset]);
-        for (size_t i = 0; i < indexAccessor.count; i++)
-        {
-            indices.push_back(indexData[i] + m.vertexOffset);
-        }
+        const tinygltf::Accessor& indexAccessor = model.accessors[primitive.indices];
+        const u16* indexData = reinterpret_cast<const u16*>(accessorData(asset, indexAccessor));
+        appendIndices(indices, indexData, indexAccessor.count, m.vertexOffset);
 
         m.vertexCount = vertexData.size() - m.vertexOffset;
         m.indexCount = indices.size() - m.indexOffset;
 
         // TODO: Base color factor
-        tinygltf::TextureInfo& albedoTextureInfo = pbr.baseColorTexture;
-        if (albedoTextureInfo.index != -1)
-        {
-            // TODO: metallicRoughnessTexture
-            tinygltf::Texture& albedo = model.textures[albedoTextureInfo.index];
-            // TODO: don't ignore sampler
-            // TODO: don't ignore texCoord index
-            tinygltf::Image& albedoImg = model.images[albedo.source];
-
-            // TODO: remove above
-            auto maybeTexture = backend.textures->loadRaw(albedoImg.image.data(), albedoImg.image.size(),
-                albedoImg.width, albedoImg.height, true, true, albedoImg.uri);
-            bindlessImages.push_back(backend.bindlessResources->addTexture(std::get<0>(*maybeTexture)));
-            m.albedoTexture = bindlessImages.back();
+        // TODO: don't ignore sampler
+        // TODO: don't ignore texCoord index
+        if (auto texture = modelTexture(model, textures.images, pbr.baseColorTexture.index))
+        {
+            m.albedoTexture = *texture;
         }
-
-        tinygltf::TextureInfo& metallicRoughnessTextureInfo = pbr.metallicRoughnessTexture;
-        if (metallicRoughnessTextureInfo.index != -1)
+        if (auto texture = modelTexture(model, textures.images, pbr.metallicRoughnessTexture.index))
         {
-            // TODO: metallicRoughnessTexture
-            tinygltf::Texture& metallicRoughness = model.textures[metallicRoughnessTextureInfo.index];
-            // TODO: don't ignore sampler
-            // TODO: don't ignore texCoord index
-            tinygltf::Image& metallicRoughnessImg = model.images[metallicRoughness.source];
-
-            // TODO: remove above
-            auto maybeTexture = backend.textures->loadRaw(metallicRoughnessImg.image.data(), metallicRoughnessImg.image.size(),
-                metallicRoughnessImg.width, metallicRoughnessImg.height, true, true, metallicRoughnessImg.uri);
-            bindlessImages.push_back(backend.bindlessResources->addTexture(std::get<0>(*maybeTexture)));
-            m.metallicRoughnessTexture = bindlessImages.back();
+            m.metallicRoughnessTexture = *texture;
         }
         //m.metallicRoughnessTexture = BindlessResources::kWhite;
 
-        tinygltf::NormalTextureInfo& normalTextureInfo = material.normalTexture;
-        if (normalTextureInfo.index != -1)
+        const i32 normalTextureIndex = material.normalTexture.index;
+        if (auto texture = modelTexture(model, textures.images, normalTextureIndex))
         {
-            tinygltf::Texture& normal = model.textures[normalTextureInfo.index];
-            // TODO: don't ignore texCoord index
-            // TODO: don't ignore sampler
-            tinygltf::Image& normalImg = model.images[normal.source];
-
-            // TODO: remove above
-            auto maybeTexture = backend.textures->loadRaw(normalImg.image.data(), normalImg.image.size(),
-                normalImg.width, normalImg.height, true, true, normalImg.uri);
-            bindlessImages.push_back(backend.bindlessResources->addTexture(std::get<0>(*maybeTexture)));
-            m.normalTexture = bindlessImages.back();
-
-            std::string bumpFilename = "generatedBump_" + normalImg.uri + ".png";
-            // TODO: allow specifying format
-
-            i32 bumpWidth = normalImg.width;
-            i32 bumpHeight = normalImg.height;
-            i32 components;
-            u8* loadRes = stbi_load(bumpFilename.c_str(), &bumpWidth, &bumpHeight, &components, STBI_rgb_alpha);
-            if (loadRes == nullptr)
-            {
-                //bumpWidth = normalImg.width;
-                //bumpHeight = normalImg.height;
-
-                //std::println("Generating bump map: {}... ", bumpFilename);
-                //std::vector<u8> bumpMapData = tangentNormalMapToBumpMap(normalImg.image.data(), normalImg.width,
-                //    normalImg.height);
-
-                //stbi_write_png(bumpFilename.c_str(), bumpHeight, bumpWidth, 4, bumpMapData.data(), 0);
-                //maybeTexture = backend.textures->loadRaw(bumpMapData.data(), bumpMapData.size(), bumpWidth,
-                //    bumpHeight, true, true, bumpFilename);
-                bumpFilename = "empty_bump";
-                maybeTexture = std::tuple<Texture, std::string>(whiteTexture(backend, 2.f), bumpFilename);
-            }
-            else
-            {
-                maybeTexture = backend.textures->loadRaw(loadRes, bumpWidth * bumpHeight * 4 * 1, bumpWidth,
-                    bumpHeight, true, true, bumpFilename);
-            }
-
-            if (maybeTexture)
-            {
-                bindlessImages.push_back(backend.bindlessResources->addTexture(std::get<0>(*maybeTexture)));
-                m.bumpTexture = bindlessImages.back();
-            }
-            else
-            {
-                m.bumpTexture = BindlessResources::kWhite;
-            }
+            m.normalTexture = *texture;
+        }
+        if (normalTextureIndex != -1)
+        {
+            m.bumpTexture =
+                modelTexture(model, textures.bumpMaps, normalTextureIndex).value_or(BindlessResources::kWhite);
         }
     }
 }
@@ -630,24 +924,15 @@ void Scene::createBuffers()
     backend.copyBufferWithStaging(vertexData.data(), vertexBufferSize, vertexBuffer.buffer);
     backend.copyBufferWithStaging(indices.data(), indexBufferSize, indexBuffer.buffer);
 
-    auto modelData = gatherModelData(*this);
-    const u32 perModelBufferSize = modelData.size() * sizeof(decltype(modelData)::value_type);
-    info = vkutil::init::bufferCreateInfo(perModelBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                                                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                                                  VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
-    perModelBuffer = backend.allocateBuffer(info, VMA_MEMORY_USAGE_GPU_ONLY,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    backend.copyBufferWithStaging(modelData.data(), modelData.size() * sizeof(ModelData), perModelBuffer.buffer);
-
-    info = vkutil::init::bufferCreateInfo(sizeof(VkDrawIndexedIndirectCommand) * modelData.size(),
+    // Model data is written every frame by sceneUploadPass()
+    info = vkutil::init::bufferCreateInfo(sizeof(VkDrawIndexedIndirectCommand) * meshCount,
         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
     indirectCommands = backend.allocateBuffer(info, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
         VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
     // TODO: do actual instancing
     std::vector<VkDrawIndexedIndirectCommand> cmds;
-    cmds.reserve(modelData.size());
+    cmds.reserve(meshCount);
     u32 i = 0;
     for (auto& mesh : meshes)
     {
@@ -668,54 +953,34 @@ void Scene::createBuffers()
 }
 
 result::result<Scene, assetError> loadScene(VulkanBackend& backend, std::string name, std::string path,
-    u32 lightCount)
+    u32 lightCount, std::optional<u32> lightSeed)
 {
     Scene scene = Scene(name, backend);
 
-    tinygltf::Model model;
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
-
     std::println("Loading {}", path);
-    if (path.ends_with(".gltf"))
-    {
-        if (!loader.LoadASCIIFromFile(&model, &err, &warn, path))
-        {
-            std::println("{}", err);
-            std::println("{}", warn);
-            return result::fail(assetError{});
-        }
-    }
-    else if (path.ends_with(".glb"))
+    auto asset = loadGltf(path);
+    if (!asset)
     {
-        if (!loader.LoadBinaryFromFile(&model, &err, &warn, path))
-        {
-            std::println("{}", err);
-            std::println("{}", warn);
-            return result::fail(assetError{});
-        }
+        return result::fail(assetError{});
     }
 
     std::println("Successfully loaded {}", path);
-    scene.addModel(model);
+    scene.addModel(*asset);
+    // Everything is on the GPU or copied into the scene, drop the mappings
+    asset.reset();
     scene.createBuffers();
 
     std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(lightSeed ? *lightSeed : rd());
     std::uniform_real_distribution<f32> uniformDistribution(0, 1);
     scene.pointLights.reserve(lightCount);
 
-    scene.pointLights.push_back(PointLight {
-        //.pos = glm::vec4(0, 30, 0, 1.f),
-        //.color = glm::vec4(1.f, 0.6f, 0.2f, 1.f),
-        //.range = glm::vec4(50.f),
-        .pos = glm::vec4(22.7 * 0.005, 98.65 / 4.f * 0.005, 115.17 * 0.005, 1.f),
-        //.pos = glm::vec4(520.f, 40.f, 0.f, 1.f),
-        .color = glm::vec4(1.f, 0.95f, 0.8f, 1.f) * 10.f,
-        //.range = glm::vec4(150.f),
-        .rangeAndStrength = glm::vec4(1.0f),
-    });
+    scene.pointLights.push_back(packPointLight(
+        glm::vec3(22.7 * 0.005, 98.65 / 4.f * 0.005, 115.17 * 0.005),
+        1.f,
+        glm::vec3(1.f, 0.95f, 0.8f) * 10.f,
+        1.f
+    ));
 
     glm::vec3 exclusionAabb[2] = {
         glm::vec3(-900.f, 80.f, -200.f) * 0.005f,
@@ -747,16 +1012,16 @@ result::result<Scene, assetError> loadScene(VulkanBackend& backend, std::string
         } while (insideExclusion(pos));
         // std::println("\t OK {} {} {}", pos.x, pos.y, pos.z);
 
-        scene.pointLights.push_back(PointLight{
-            .pos = glm::vec4(pos, 1.f),
-            .color = glm::vec4(
-                uniformDistribution(gen) * 0.6 + 0.4,
+        scene.pointLights.push_back(packPointLight(
+            pos,
+            (uniformDistribution(gen) * 40 + 20) * 0.025f, // [20; 200]
+            glm::vec3(
                 uniformDistribution(gen) * 0.6 + 0.4,
                 uniformDistribution(gen) * 0.6 + 0.4,
-                1.f
+                uniformDistribution(gen) * 0.6 + 0.4
             ) * 10.f,
-            .rangeAndStrength = glm::vec4((uniformDistribution(gen) * 40 + 20) * 0.025f, 1.f, 0.f, 0.f) // [20; 200]
-        });
+            1.f
+        ));
     }
 
     return scene;
@@ -2,10 +2,13 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "camera.h"
+#include "lightBvh.h"
 #include "mesh.h"
 #include "result.hpp"
 #include "rhi/vulkan/bindless.h"
@@ -15,18 +18,33 @@
 
 class GLFWwindow;
 class VulkanBackend;
+struct GltfAsset;
 
 enum class assetError
 {
 };
 
+// Bindless slots of one glTF model's images, both indexed like its images. Nullopt where an image isn't sampled
+// or failed to import, bump maps are only there for normal maps.
+struct ModelTextures
+{
+    std::vector<std::optional<BindlessTexture>> images;
+    std::vector<std::optional<BindlessTexture>> bumpMaps;
+};
+
+// Matches PointLight in lights.glsl. Color and strength are half floats, see packPointLight().
 struct PointLight
 {
-    // TODO: pack
-    glm::vec4 pos;
-    glm::vec4 color;
-    glm::vec4 rangeAndStrength;
+    glm::vec3 pos;
+    f32 range;
+    // R | G << 16
+    u32 colorRG;
+    // B | strength << 16
+    u32 colorBAndStrength;
 };
+static_assert(sizeof(PointLight) == 24);
+
+auto packPointLight(glm::vec3 pos, f32 range, glm::vec3 color, f32 strength) -> PointLight;
 
 struct Scene
 {
@@ -38,6 +56,7 @@ struct Scene
 
     // TEMP: this should live in some gameplay systems
     std::vector<PointLight> pointLights;
+    LightBvh lightBvh;
 
     VulkanBackend& backend;
 
@@ -51,14 +70,15 @@ struct Scene
     std::vector<Vertex> vertexData;
     std::vector<u32> indices;
 
-    // TEMP: move to a texture pool
-    std::vector<tinygltf::Image> images;
     glm::vec3 lightDir = glm::vec3(0.6, -1.0, 0.175);
 
     std::vector<BindlessTexture> bindlessImages;
+    // Slot of every image uploaded so far keyed by textureCacheKey(), an image used by several materials or models
+    // is decoded, uploaded and given a slot once. Bump maps are keyed by bumpMapCacheKey() of their normal map.
+    std::unordered_map<u64, BindlessTexture> textureSlots;
+    std::unordered_map<u64, BindlessTexture> bumpMapSlots;
     AllocatedBuffer vertexBuffer;
     AllocatedBuffer indexBuffer;
-    AllocatedBuffer perModelBuffer;
     AllocatedBuffer indirectCommands;
 
     // TEMP:
@@ -78,40 +98,44 @@ struct Scene
         debugCamera = other.debugCamera;
         activeCamera = &mainCamera;
         pointLights = other.pointLights;
+        lightBvh = other.lightBvh;
         aabbMin = other.aabbMin;
         aabbMax = other.aabbMax;
         meshes = other.meshes;
         vertexData = other.vertexData;
         indices = other.indices;
-        images = other.images;
         lightDir = other.lightDir;
         bindlessImages = other.bindlessImages;
+        textureSlots = other.textureSlots;
+        bumpMapSlots = other.bumpMapSlots;
         vertexBuffer = other.vertexBuffer;
         indexBuffer = other.indexBuffer;
-        perModelBuffer = other.perModelBuffer;
         indirectCommands = other.indirectCommands;
         meshCount = other.meshCount;
         sceneGraph = other.sceneGraph;
     }
 
+    // Moves the CPU side geometry instead of copying it, that would double the import's peak memory. Also keeps
+    // scene graph nodes' instance pointers valid.
     Scene(Scene&& other) : Scene(other.name, other.backend)
     {
         name = other.name;
         mainCamera = other.mainCamera;
         debugCamera = other.debugCamera;
         activeCamera = &mainCamera;
-        pointLights = other.pointLights;
+        pointLights = std::move(other.pointLights);
+        lightBvh = std::move(other.lightBvh);
         aabbMin = other.aabbMin;
         aabbMax = other.aabbMax;
-        meshes = other.meshes;
-        vertexData = other.vertexData;
-        indices = other.indices;
-        images = other.images;
+        meshes = std::move(other.meshes);
+        vertexData = std::move(other.vertexData);
+        indices = std::move(other.indices);
         lightDir = other.lightDir;
-        bindlessImages = other.bindlessImages;
+        bindlessImages = std::move(other.bindlessImages);
+        textureSlots = std::move(other.textureSlots);
+        bumpMapSlots = std::move(other.bumpMapSlots);
         vertexBuffer = other.vertexBuffer;
         indexBuffer = other.indexBuffer;
-        perModelBuffer = other.perModelBuffer;
         indirectCommands = other.indirectCommands;
         meshCount = other.meshCount;
         sceneGraph = other.sceneGraph;
@@ -125,16 +149,17 @@ struct Scene
         activeCamera = &mainCamera;
         meshes = other.meshes;
         pointLights = other.pointLights;
+        lightBvh = other.lightBvh;
         aabbMin = other.aabbMin;
         aabbMax = other.aabbMax;
         vertexData = other.vertexData;
         indices = other.indices;
-        images = other.images;
         lightDir = other.lightDir;
         bindlessImages = other.bindlessImages;
+        textureSlots = other.textureSlots;
+        bumpMapSlots = other.bumpMapSlots;
         vertexBuffer = other.vertexBuffer;
         indexBuffer = other.indexBuffer;
-        perModelBuffer = other.perModelBuffer;
         indirectCommands = other.indirectCommands;
         meshCount = other.meshCount;
         sceneGraph = other.sceneGraph;
@@ -147,18 +172,19 @@ struct Scene
         mainCamera = other.mainCamera;
         debugCamera = other.debugCamera;
         activeCamera = &mainCamera;
-        meshes = other.meshes;
-        pointLights = other.pointLights;
+        meshes = std::move(other.meshes);
+        pointLights = std::move(other.pointLights);
+        lightBvh = std::move(other.lightBvh);
         aabbMin = other.aabbMin;
         aabbMax = other.aabbMax;
-        vertexData = other.vertexData;
-        indices = other.indices;
-        images = other.images;
+        vertexData = std::move(other.vertexData);
+        indices = std::move(other.indices);
         lightDir = other.lightDir;
-        bindlessImages = other.bindlessImages;
+        bindlessImages = std::move(other.bindlessImages);
+        textureSlots = std::move(other.textureSlots);
+        bumpMapSlots = std::move(other.bumpMapSlots);
         vertexBuffer = other.vertexBuffer;
         indexBuffer = other.indexBuffer;
-        perModelBuffer = other.perModelBuffer;
         indirectCommands = other.indirectCommands;
         meshCount = other.meshCount;
         sceneGraph = other.sceneGraph;
@@ -167,12 +193,15 @@ struct Scene
 
     void update(f32 dt, f32 currentTimeMs, GLFWwindow* window);
     void load(const char* path);
-    void addModel(tinygltf::Model& model, glm::mat4 transform = glm::mat4(1.f));
-    void addNodes(tinygltf::Model& model, tinygltf::Node& node, glm::mat4 transform, SceneGraph::Node& parent);
-    void addMesh(tinygltf::Model& model, tinygltf::Mesh& mesh, glm::mat4 transform, SceneGraph::Node& parent);
+    void addModel(GltfAsset& asset, glm::mat4 transform = glm::mat4(1.f));
+    void addNodes(GltfAsset& asset, const ModelTextures& textures, tinygltf::Node& node, glm::mat4 transform,
+        SceneGraph::Node& parent);
+    void addMesh(GltfAsset& asset, const ModelTextures& textures, tinygltf::Mesh& mesh, glm::mat4 transform,
+        SceneGraph::Node& parent);
     void createBuffers();
 };
 
+// Lights are placed at random, a fixed lightSeed places them the same way every run
 result::result<Scene, assetError> loadScene(VulkanBackend& backend, std::string name, std::string path,
-    u32 lightCount);
+    u32 lightCount, std::optional<u32> lightSeed = std::nullopt);
 Scene emptyScene(VulkanBackend& backend);
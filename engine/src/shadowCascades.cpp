@@ -0,0 +1,111 @@
+#include "shadowCascades.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include <cmath>
+
+auto frustumCornersInWorldSpace(glm::mat4 invViewProj) -> std::array<glm::vec3, 8>
+{
+    std::array frustumCorners = {
+        glm::vec3(-1.0f, 1.0f, 0.0f),
+        glm::vec3(1.0f, 1.0f, 0.0f),
+        glm::vec3(1.0f, -1.0f, 0.0f),
+        glm::vec3(-1.0f, -1.0f, 0.0f),
+        glm::vec3(-1.0f, 1.0f, 1.0f),
+        glm::vec3(1.0f, 1.0f, 1.0f),
+        glm::vec3(1.0f, -1.0f, 1.0f),
+        glm::vec3(-1.0f, -1.0f, 1.0f),
+    };
+
+    for (u32 i = 0; i < 8; i++)
+    {
+        const auto invCorner = invViewProj * glm::vec4(frustumCorners[i], 1.0f);
+        frustumCorners[i] = invCorner / invCorner.w;
+    }
+
+    return frustumCorners;
+}
+
+void csmLightViewProjMats(glm::mat4* viewProjMats, glm::vec4* cascadeDistances, i32 cascadeCount, glm::mat4 view,
+    glm::mat4 proj, glm::vec3 lightDirr, f32 nearClip, f32 farClip, f32 cascadeSplitLambda, f32 resolution)
+{
+    // f32 cascadeSplitLambda = 0.8f;
+    f32 cascadeSplits[cascadeCount];
+
+    f32 clipRange = farClip - nearClip;
+
+    f32 minZ = nearClip;
+    f32 maxZ = nearClip + clipRange;
+
+    f32 range = maxZ - minZ;
+    f32 ratio = maxZ / minZ;
+
+    // Calculate split depths based on view camera frustum
+    // Based on method presented in https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
+    for (u32 i = 0; i < cascadeCount; i++)
+    {
+        f32 p = (i + 1) / static_cast<f32>(cascadeCount);
+        f32 log = minZ * std::pow(ratio, p);
+        f32 uniform = minZ + range * p;
+        f32 d = cascadeSplitLambda * (log - uniform) + uniform;
+        // cascadeDistances[i] = (d - nearClip) / clipRange;
+        cascadeSplits[i] = (d - nearClip) / clipRange;
+    }
+
+    f32 lastSplitDist = 0.f;
+    glm::mat4 invViewProj = glm::inverse(proj * view);
+    for (i32 i = 0; i < cascadeCount; i++)
+    {
+        std::array<glm::vec3, 8> frustumCorners = frustumCornersInWorldSpace(invViewProj);
+
+        f32 splitDist = cascadeSplits[i];
+        for (u32 j = 0; j < 4; j++)
+        {
+            glm::vec3 dist = frustumCorners[j + 4] - frustumCorners[j];
+            frustumCorners[j + 4] = frustumCorners[j] + (dist * splitDist);
+            frustumCorners[j] = frustumCorners[j] + (dist * lastSplitDist);
+        }
+        lastSplitDist = cascadeSplits[i];
+
+        glm::vec3 frustumCenter = glm::vec3(0.0f);
+        for (u32 j = 0; j < 8; j++)
+        {
+            frustumCenter += frustumCorners[j];
+        }
+        frustumCenter /= 8.0f;
+
+        f32 radius = 0.0f;
+        for (u32 j = 0; j < 8; j++)
+        {
+            f32 distance = glm::length(frustumCorners[j] - frustumCenter);
+            radius = glm::max(radius, distance);
+        }
+        //radius = std::ceil(radius / 2.0f) * 2.0f;
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        glm::vec3 lightDir = normalize(lightDirr); // NOTE: convert lightDir into light pos
+
+        glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - (lightDir * radius), frustumCenter,
+            glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 lightOrthoMatrix = glm::ortho(-radius, radius, -radius, radius,
+            -radius * 2, radius * 2);
+        viewProjMats[i] = lightOrthoMatrix * lightViewMatrix;
+
+        glm::vec4 lightSpaceOrigin = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        lightSpaceOrigin = viewProjMats[i] * lightSpaceOrigin;
+        lightSpaceOrigin = lightSpaceOrigin * (resolution / 2.0f); // Range [-resolution/2; resolution/2]
+
+        glm::vec4 roundedOrigin = glm::round(lightSpaceOrigin);
+        glm::vec4 roundOffset = roundedOrigin - lightSpaceOrigin;
+        roundOffset = roundOffset * (2.0f / resolution);
+        roundOffset.z = 0.0f;
+        roundOffset.w = 0.0f;
+
+        glm::mat4 shadowProj = viewProjMats[i];
+        shadowProj[3] += roundOffset;
+        viewProjMats[i] = shadowProj;
+
+        cascadeDistances[i] = glm::vec4((nearClip + splitDist * clipRange) * -1.0f);
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "engine.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+
+[[nodiscard]]
+auto frustumCornersInWorldSpace(glm::mat4 invViewProj) -> std::array<glm::vec3, 8>;
+
+// Fits an orthographic light projection around each cascade's slice of the view frustum. Origins are snapped to
+// shadow map texels to avoid shimmering when the camera moves.
+void csmLightViewProjMats(glm::mat4* viewProjMats, glm::vec4* cascadeDistances, i32 cascadeCount, glm::mat4 view,
+    glm::mat4 proj, glm::vec3 lightDirr, f32 nearClip, f32 farClip, f32 cascadeSplitLambda, f32 resolution);
@@ -0,0 +1,176 @@
+#include "worldRenderer.h"
+
+#include "debugUI.h"
+#include "renderGraphStats.h"
+#include "scene.h"
+
+#include "GLFW/glfw3.h"
+#include "imgui.h"
+#include "imgui_impl_glfw.h"
+#include "imgui_impl_vulkan.h"
+
+#include <algorithm>
+
+CompiledRenderGraph& WorldRenderer::compileRenderGraph(Scene& scene)
+{
+    // NOTE: the graph is declared from scratch every frame, so passes are free to change their setup
+    // (resolution, toggled effects, etc.). Compilation is skipped when the structure hash matches the
+    // cached graph, see compile().
+    resetRenderGraph(graph);
+
+    const auto sceneData = sceneUploadPass(sceneDataUploader, backend, graph, scene);
+    const auto [culledDraws] = cpuFrustumCullingPass(culling, backend, graph);
+    const auto [depthMap] = zPrePass(prePass, backend, graph, sceneData, culledDraws);
+    const auto [shadowMap, cascadeData] = csmPass(shadows, backend, graph, sceneData, 4);
+    auto lightData = clusteredLightCullingPass(lightCulling, backend, graph, sceneData, depthMap, scene);
+    // auto [pointLightShadowAtlas] = pointLightShadowPass(pointLightShadows, backend, graph, lightList, lightIndexList, lightGrid);
+    auto [colorOutput, normal, positions, reflections] = opaqueForwardPass(opaque, backend, graph, sceneData, culledDraws, depthMap, cascadeData, shadowMap, lightData);
+    auto output = ssrPass(ss, blur, backend, graph, colorOutput, normal, positions, reflections);
+    output = atmospherePass(atmosphere, backend, graph, depthMap, output);
+
+    auto _ = bloomPass(bloom, blur, backend, graph, output);
+    //output = reinhardTonemapPass(tonemapper, backend, graph, output);
+    //smaaPass(antiAliaser, backend, graph, output);
+
+    return compile(backend, graph, renderGraphCache);
+}
+
+void WorldRenderer::render(Frame& frame, Scene& scene, f64 dt)
+{
+    if (backend.headless)
+    {
+        ImGui::GetIO().DeltaTime = std::max(static_cast<f32>(dt), 0.0001f);
+    }
+    else
+    {
+        glfwPollEvents();
+
+        ImGui_ImplVulkan_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+    }
+    ImGui::NewFrame();
+
+    ImGui::SetNextWindowBgAlpha(0.0f);
+    ImGui::DockSpaceOverViewport(0, nullptr, ImGuiDockNodeFlags_PassthruCentralNode);
+
+    scene.update(dt, 0.f, backend.window);
+
+    addDebugUI(debugUI, backend.currentFrame().frameArena, GRAPHICS, [this]()
+    {
+        if (ImGui::TreeNode("Render graph"))
+        {
+            ImGui::Text("Passes: %zu", graph.nodes.size());
+            ImGui::Text("Resources: %zu (%zu versions)", graph.resources.size(), graph.handleResources.size());
+            ImGui::Text("Pass arena: %zu/%zu bytes", graph.arena.bytesAllocated, graph.arena.capacity());
+            ImGui::Text("Structure hash: %016lx",
+                renderGraphCache.compiled ? renderGraphCache.compiled->structureHash : 0);
+            ImGui::Text("Cache hits/misses: %lu/%lu", renderGraphCache.hits, renderGraphCache.misses);
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Memory"))
+        {
+            const auto& frameArena = backend.currentFrame().frameArena;
+            ImGui::Text("Frame arena: %zu/%zu bytes", frameArena.bytesAllocated, frameArena.capacity());
+            ImGui::Text("Heap allocations last frame: %lu", backend.stats.frameHeapAllocations);
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Texture streaming"))
+        {
+            auto& streamer = *backend.textureStreamer;
+            constexpr f64 mb = 1024.0 * 1024.0;
+            ImGui::Text("Resident: %.1f/%.1f MB", streamer.residentBytes / mb, streamer.budgetBytes / mb);
+            ImGui::Text("Uploaded last frame: %.1f MB", streamer.uploadedBytes / mb);
+            ImGui::Text("Textures: %zu, evictions: %u", streamer.entries.size(), streamer.evictions);
+            i32 budgetMb = static_cast<i32>(streamer.budgetBytes / (1024 * 1024));
+            if (ImGui::SliderInt("Budget MB", &budgetMb, 16, 4096))
+            {
+                streamer.budgetBytes = static_cast<u64>(budgetMb) * 1024 * 1024;
+            }
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Pipeline cache"))
+        {
+            const auto& cache = backend.pipelineCache;
+            ImGui::Text("Loaded: %lu bytes", cache.loadedBytes);
+            ImGui::Text("Hits: %u, misses: %u", cache.hits.load(), cache.misses.load());
+            ImGui::Text("Creation: %.1f ms", cache.creationNs.load() / 1e6);
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Pass stats"))
+        {
+            constexpr ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                ImGuiTableFlags_SizingFixedFit;
+            if (ImGui::BeginTable("Pass stats", 9, flags))
+            {
+                ImGui::TableSetupColumn("Pass");
+                ImGui::TableSetupColumn("GPU ms");
+                ImGui::TableSetupColumn("GPU max ms");
+                ImGui::TableSetupColumn("CPU ms");
+                ImGui::TableSetupColumn("Draws");
+                // Input assembly primitives, every pass draws triangle lists
+                ImGui::TableSetupColumn("Triangles");
+                ImGui::TableSetupColumn("Clipped primitives");
+                ImGui::TableSetupColumn("Invocations (VS/FS/CS)");
+                ImGui::TableSetupColumn("Barriers");
+                ImGui::TableHeadersRow();
+
+                f64 totalGpuMs = 0.0;
+                f64 totalCpuMs = 0.0;
+                for (const auto& pass : backend.renderGraphStats.passes)
+                {
+                    const auto average = averageSample(pass);
+                    const auto max = maxSample(pass);
+                    totalGpuMs += average.gpuMs;
+                    totalCpuMs += average.cpuMs;
+
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(pass.name);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", average.gpuMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", max.gpuMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", average.cpuMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%u", average.drawCalls);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%lu", average.primitives);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%lu", average.clippedPrimitives);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%lu/%lu/%lu", average.vertexInvocations, average.fragmentInvocations,
+                        average.computeInvocations);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%u", average.barriers);
+                }
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted("Total");
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", totalGpuMs);
+                ImGui::TableNextColumn();
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", totalCpuMs);
+                ImGui::EndTable();
+            }
+            ImGui::Text("Averaged over the last %u frames", PassStats::WindowSize);
+            ImGui::TreePop();
+        }
+    });
+    drawDebugUI(debugUI, backend, scene, dt);
+    // Keep the vectors around, so that re-adding the same callbacks next frame doesn't allocate
+    for (auto& [_, fns] : debugUI.fns)
+    {
+        fns.clear();
+    }
+
+    auto& compiledRenderGraph = compileRenderGraph(scene);
+
+    // NOTE: for now let's just directly pass in the graph and let the
+    // backend figure out what it wants to do. Generally we should transform
+    // compiledRenderGraph into a command buffer or a list of secondary
+    // command buffers. I.e.: cmds = backend.recordCommandBuffers(compiledRenderGraph); backend.submit(cmds);
+    backend.render(frame, compiledRenderGraph, scene);
+}
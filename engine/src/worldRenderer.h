@@ -0,0 +1,45 @@
+#pragma once
+
+#include "passes/atmosphere.h"
+#include "passes/bloom.h"
+#include "passes/blur.h"
+#include "passes/culling.h"
+#include "passes/forward.h"
+#include "passes/lightCulling.h"
+#include "passes/sceneUpload.h"
+#include "passes/screenSpace.h"
+#include "passes/shadows.h"
+#include "passes/zPrePass.h"
+#include "renderGraph.h"
+#include "rhi/vulkan/backend.h"
+
+#include <optional>
+
+struct Scene;
+
+struct WorldRenderer
+{
+    VulkanBackend& backend;
+
+    RenderGraph graph;
+    RenderGraphCache renderGraphCache;
+
+    std::optional<SceneDataUploader> sceneDataUploader;
+    std::optional<GeometryCulling> culling;
+    std::optional<ZPrePassRenderer> prePass;
+    std::optional<ShadowRenderer> shadows;
+    std::optional<ForwardOpaqueRenderer> opaque;
+    std::optional<LightCulling> lightCulling;
+
+    // Postpro fx
+    std::optional<AtmosphereRenderer> atmosphere;
+
+    std::optional<ScreenSpaceRenderer> ss;
+    std::optional<BlurRenderer> blur;
+    std::optional<BloomRenderer> bloom;
+
+    explicit WorldRenderer(VulkanBackend& backend) : backend(backend), graph{.backend = backend} {}
+
+    CompiledRenderGraph& compileRenderGraph(Scene& scene);
+    void render(Frame& frame, Scene& scene, f64 dt);
+};